@@ -0,0 +1,112 @@
+/* alloc_tracker.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+/**
+ * @Brief  Allocation counters of the global operator new and delete
+ *
+ *         Built with ALLOC_TRACKING, the library replaces the global
+ *         operator new and delete, and every thread counts its own
+ *         allocations, the bytes allocated, the bytes still live and the
+ *         time spent in the allocator. Every block records the thread that
+ *         allocated it, so a block freed on another thread still lowers
+ *         the live bytes of the allocating thread. Without ALLOC_TRACKING the operators
+ *         are not replaced and every count stays 0, so tracking costs
+ *         nothing. Peak RSS is read from the kernel in both builds.
+ */
+namespace alloc_tracker {
+  /**
+   * @Brief  Allocations of a thread over a scope
+   */
+  struct AllocStats {
+    /**
+     * @Brief  Number of calls to operator new
+     */
+    size_t allocations = 0;
+
+    /**
+     * @Brief  Bytes requested from operator new
+     */
+    size_t bytes_allocated = 0;
+
+    /**
+     * @Brief  Most bytes allocated in the scope and not yet freed
+     *         at the same time
+     */
+    size_t peak_live_bytes = 0;
+
+    /**
+     * @Brief  Time spent in operator new and delete
+     */
+    double alloc_time = 0.0;  // ms
+  };
+
+  /**
+   * @Brief  Count the allocations of the current thread from
+   *         its construction
+   *
+   *         Scopes can be nested. Memory freed in the scope but allocated
+   *         before it lowers the live bytes, and so does memory of the
+   *         thread freed by other threads, like answers handed to a writer
+   *         thread. Allocations of other threads are not counted.
+   */
+  class AllocScope {
+   public:
+    AllocScope();
+    ~AllocScope();
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+    /**
+     * @Brief  Get the allocations of the thread so far in the scope
+     */
+    AllocStats stats() const;
+
+   private:
+    size_t start_allocations_;
+    size_t start_bytes_;
+    long long start_live_bytes_;
+    long long outer_peak_bytes_;
+    std::chrono::nanoseconds start_alloc_time_;
+  };
+
+  /**
+   * @Brief  Whether the library was built with ALLOC_TRACKING
+   */
+  bool enabled();
+
+  /**
+   * @Brief  Get the peak resident memory of the process
+   *
+   * @Returns  The high water mark of the resident set in bytes,
+   *           0 if the system does not report it
+   */
+  size_t peak_rss();
+
+  /**
+   * @Brief  Get the resident memory of the process that no other
+   *         process shares
+   *
+   *         A forked process shares the pages of its parent until it
+   *         writes them, so this is the memory the process costs
+   *
+   * @Returns  The private resident memory in bytes,
+   *           0 if the system does not report it
+   */
+  size_t private_memory();
+
+  /**
+   * @Brief  Reset the peak resident memory to the current resident memory
+   *
+   * @Returns  False if the system cannot reset it, so peak_rss keeps
+   *           the peak since the process started
+   */
+  bool reset_peak_rss();
+}  // namespace alloc_tracker
@@ -0,0 +1,255 @@
+/* batch_pipeline.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "alloc_tracker.h"
+#include "bounded_queue.h"
+#include "path_solver.h"
+
+/**
+ * @Brief  Tunable parameters for the batch pipeline
+ */
+namespace pipelineParam {
+  /**
+   * @Brief  Capacity of the queue between two stages
+   */
+  constexpr size_t QUEUE_CAPACITY = 256;
+
+  /**
+   * @Brief  Most queries between reading and writing
+   *
+   *         Answers are written in input order, so a slow query holds
+   *         back the answers after it. Reading waits while this many
+   *         queries are unwritten, which keeps memory flat for any input.
+   */
+  constexpr size_t MAX_IN_FLIGHT = 1024;
+
+  /**
+   * @Brief  Seconds between progress reports
+   */
+  constexpr double REPORT_INTERVAL = 1.0;  // s
+}  // namespace pipelineParam
+
+/**
+ * @Brief  Setting of the batch pipeline
+ */
+struct BatchConfig {
+  /**
+   * @Brief  Number of solver threads, 0 uses every hardware thread
+   */
+  int num_of_workers = 0;
+
+  /**
+   * @Brief  Capacity of the queue between two stages
+   */
+  size_t queue_capacity = pipelineParam::QUEUE_CAPACITY;
+
+  /**
+   * @Brief  Most queries between reading and writing
+   */
+  size_t max_in_flight = pipelineParam::MAX_IN_FLIGHT;
+
+  /**
+   * @Brief  Check every route with the route evaluator
+   */
+  bool validate = false;
+
+  /**
+   * @Brief  The setting of every search
+   */
+  PathSolverConfig solver_config;
+
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle;
+};
+
+/**
+ * @Brief  Items and busy time of a pipeline stage
+ */
+struct StageStats {
+  std::string name;
+  size_t items = 0;
+  double busy_time = 0.0;  // s
+  int num_of_threads = 0;
+};
+
+/**
+ * @Brief  Depth of the queue in front of a pipeline stage
+ */
+struct QueueStats {
+  std::string name;
+  size_t depth = 0;
+  size_t max_depth = 0;
+  size_t capacity = 0;
+};
+
+/**
+ * @Brief  Snapshot of the pipeline
+ */
+struct PipelineStats {
+  std::vector<StageStats> stages;
+  std::vector<QueueStats> queues;
+  size_t invalid_routes = 0;
+  double elapsed_time = 0.0;  // s
+
+  /**
+   * @Brief  Allocations of the solved queries summed, with the largest
+   *         peak live bytes of a query
+   */
+  alloc_tracker::AllocStats allocation;
+
+  /**
+   * @Brief  Peak resident memory of the process
+   */
+  size_t peak_rss = 0;  // bytes
+};
+
+/**
+ * @Brief  A query moving through the pipeline
+ */
+struct BatchItem {
+  /**
+   * @Brief  Position of the query in the input
+   */
+  size_t sequence = 0;
+
+  std::string start_charger;
+  std::string goal_charger;
+
+  /**
+   * @Brief  Why the query has no route, empty if it has one
+   */
+  std::string error;
+
+  /**
+   * @Brief  The route in the answer string format
+   */
+  std::string answer;
+
+  /**
+   * @Brief  Allocations of the search, all 0 without ALLOC_TRACKING
+   */
+  alloc_tracker::AllocStats allocation;
+};
+
+/**
+ * @Brief  A staged pipeline that answers a stream of queries
+ *
+ *         The stages are connected by bounded lock-free queues:
+ *           read    parse "start goal" lines and resolve the names
+ *           solve   search the route on a pool of threads
+ *           check   evaluate every route if validation is enabled
+ *           write   write the answers in input order
+ *         A full queue makes the stage in front of it wait, so a slow
+ *         stage slows down reading instead of filling memory.
+ */
+class BatchPipeline {
+ public:
+  /**
+   * @Brief  Constructor
+   *
+   * @Param config The setting of the pipeline
+   */
+  explicit BatchPipeline(const BatchConfig& config = BatchConfig());
+
+  BatchPipeline(const BatchPipeline&) = delete;
+  BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+  /**
+   * @Brief  Answer every query of the input
+   *
+   *         Every input line is answered by one output line, the route
+   *         or "Error: " with the reason. Blank lines and lines starting
+   *         with # are skipped.
+   *
+   * @Param input The stream of "start goal" lines
+   * @Param output The stream of answers
+   * @Param report Where progress is reported every REPORT_INTERVAL,
+   *               nullptr for no report
+   * @Param alloc_log Where the allocations of every query are written
+   *                  in input order, nullptr for no log
+   */
+  void run(std::istream& input, std::ostream& output,
+           std::ostream* report = nullptr,
+           std::ostream* alloc_log = nullptr);
+
+  /**
+   * @Brief  Get a snapshot of the stages and queues
+   *
+   *         Safe to call from another thread while the pipeline runs
+   *
+   * @Returns  Throughput of every stage and depth of every queue
+   */
+  PipelineStats stats() const;
+
+  /**
+   * @Brief  Print a snapshot as one line per stage and queue
+   */
+  static void print_stats(const PipelineStats& stats, std::ostream& report);
+
+ private:
+  /**
+   * @Brief  Counters of a stage shared by its threads
+   */
+  struct StageCounter {
+    std::atomic<size_t> items;
+    std::atomic<long long> busy_time;  // ns
+    int num_of_threads;
+  };
+
+  void read_stage(std::istream& input);
+  void solve_stage();
+  void check_stage();
+  void write_stage(std::ostream& output, std::ostream* report,
+                   std::ostream* alloc_log);
+
+  /**
+   * @Brief  Add a finished item and its time to a stage
+   */
+  static void count(StageCounter& counter,
+                    std::chrono::steady_clock::time_point start_time);
+
+  BatchConfig config_;
+
+  BoundedQueue<BatchItem> parsed_queue_;
+  BoundedQueue<BatchItem> solved_queue_;
+  BoundedQueue<BatchItem> checked_queue_;
+
+  StageCounter read_counter_;
+  StageCounter solve_counter_;
+  StageCounter check_counter_;
+  StageCounter write_counter_;
+
+  /**
+   * @Brief  Number of answers written so far
+   */
+  std::atomic<size_t> written_count_;
+
+  /**
+   * @Brief  Solver threads that have not finished yet
+   */
+  std::atomic<int> active_workers_;
+
+  std::atomic<size_t> invalid_routes_;
+
+  /**
+   * @Brief  Allocations of the solved queries
+   */
+  std::atomic<size_t> allocations_;
+  std::atomic<size_t> bytes_allocated_;
+  std::atomic<size_t> peak_live_bytes_;
+  std::atomic<long long> alloc_time_;  // ns
+
+  std::chrono::steady_clock::time_point start_time_;
+};
@@ -0,0 +1,116 @@
+/* beam_solver.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "path.h"
+#include "path_solver.h"
+
+/**
+ * @Brief  Tunable parameter for Beam Solver class
+ */
+namespace beamSolverParam {
+  /**
+   * @Brief  Default number of paths kept in every layer
+   *
+   *         Increase this value obtain more optimal
+   *         solution with longer computation time
+   */
+  constexpr int DEFAULT_BEAM_WIDTH = 50;
+
+  /**
+   * @Brief  Default memory limit for the paths of the search
+   */
+  constexpr size_t DEFAULT_MEMORY_LIMIT = 8 << 20;  // bytes
+}  // namespace beamSolverParam
+
+/**
+ * @Brief  A fast approximate solver for the path charging problem
+ *
+ *         Paths are searched layer by layer, one more charging
+ *         station in every layer. Only the beam width best paths
+ *         of a layer by heuristic cost are expanded, so computation
+ *         time and memory do not depend on how hard the query is.
+ */
+class BeamSolver {
+ public:
+   /**
+    * @Brief  Constructor
+    *
+    * @Param start_charger The name of the initial charging station
+    * @Param goal_charger The name of the goal charging station
+    * @Param vehicle The battery and speed setting of the car
+    * @Param beam_width The maximum number of paths kept in every layer
+    * @Param memory_limit The hard limit of memory for paths in bytes
+    */
+  BeamSolver(const std::string& start_charger,
+             const std::string& goal_charger,
+             const VehicleProfile& vehicle = VehicleProfile(),
+             int beam_width = beamSolverParam::DEFAULT_BEAM_WIDTH,
+             size_t memory_limit = beamSolverParam::DEFAULT_MEMORY_LIMIT);
+
+  /**
+   * @Brief  Search for the best path within the beam
+   *
+   * @Returns  The best path found, or an empty string
+   *           if no path was found within the beam
+   */
+  std::string solve();
+
+  /**
+   * @Brief  Get the most memory used by paths of the search
+   *
+   * @Returns  The estimated peak memory in bytes
+   */
+  size_t peak_memory() const;
+
+ private:
+  /**
+   * @Brief  Number of paths a layer can keep within the memory limit
+   *
+   *         The current layer and the next layer share the limit
+   *
+   * @Param path_size The estimated memory of a path in the next layer
+   *
+   * @Returns  The beam width for the next layer
+   */
+  int layer_width(size_t path_size) const;
+
+  /**
+   * @Brief  The initial charging station
+   */
+  std::string start_charger_;
+
+  /**
+   * @Brief  The goal charging station
+   */
+  std::string goal_charger_;
+
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle_;
+
+  /**
+   * @Brief  The maximum number of paths kept in every layer
+   */
+  int beam_width_;
+
+  /**
+   * @Brief  The hard limit of memory for paths
+   */
+  size_t memory_limit_;  // bytes
+
+  /**
+   * @Brief  The most memory used by paths so far
+   */
+  size_t peak_memory_ = 0;  // bytes
+};
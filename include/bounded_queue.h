@@ -0,0 +1,213 @@
+/* bounded_queue.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/**
+ * @Brief  A bounded lock-free queue for many producers
+ *         and many consumers
+ *
+ *         Every cell carries a sequence number that tells whether
+ *         it is ready to be written or read at the current position,
+ *         so producers and consumers only race on one atomic counter.
+ *         A full queue makes producers wait, which is the backpressure
+ *         between pipeline stages.
+ */
+template <typename T>
+class BoundedQueue {
+ public:
+  /**
+   * @Brief  Constructor
+   *
+   * @Param capacity The maximum number of items, rounded up to a power of 2
+   */
+  explicit BoundedQueue(size_t capacity):
+    capacity_{1},
+    enqueue_pos_{0},
+    dequeue_pos_{0},
+    max_depth_{0},
+    closed_{false} {
+    while (capacity_ < capacity) {
+      capacity_ *= 2;
+    }
+    mask_ = capacity_ - 1;
+
+    cells_.reset(new Cell[capacity_]);
+    for (size_t i=0; i < capacity_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+   * @Brief  Add an item if the queue is not full
+   *
+   * @Returns  False if the queue is full
+   */
+  bool try_push(T& item) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      long diff = static_cast<long>(sequence) - static_cast<long>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->item = std::move(item);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    this->update_max_depth();
+    return true;
+  }
+
+  /**
+   * @Brief  Take the oldest item if the queue is not empty
+   *
+   * @Returns  False if the queue is empty
+   */
+  bool try_pop(T& item) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos & mask_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      long diff = static_cast<long>(sequence) - static_cast<long>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    item = std::move(cell->item);
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @Brief  Add an item, waiting while the queue is full
+   */
+  void push(T item) {
+    for (int tries=0; !this->try_push(item); ++tries) {
+      backoff(tries);
+    }
+  }
+
+  /**
+   * @Brief  Take the oldest item, waiting while the queue is empty
+   *
+   * @Returns  False if the queue is closed and empty
+   */
+  bool pop(T& item) {
+    for (int tries=0; !this->try_pop(item); ++tries) {
+      if (closed_.load(std::memory_order_acquire)) {
+        // Items pushed before closing are still taken
+        return this->try_pop(item);
+      }
+      backoff(tries);
+    }
+    return true;
+  }
+
+  /**
+   * @Brief  Wait before trying again, first by yielding and then
+   *         by sleeping, so waiting stages leave the cores to busy ones
+   *
+   * @Param tries The number of failed tries so far
+   */
+  static void backoff(int tries) {
+    if (tries < 64) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  /**
+   * @Brief  Tell the consumers that no more items come
+   */
+  void close() {
+    closed_.store(true, std::memory_order_release);
+  }
+
+  /**
+   * @Brief  Get the number of items in the queue
+   *
+   *         Approximate while producers and consumers run
+   */
+  size_t size() const {
+    size_t enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+    size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+    return (enqueue_pos > dequeue_pos) ? enqueue_pos - dequeue_pos : 0;
+  }
+
+  /**
+   * @Brief  Get the most items that were in the queue
+   */
+  size_t max_depth() const {
+    return max_depth_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @Brief  Get the maximum number of items
+   */
+  size_t capacity() const {
+    return capacity_;
+  }
+
+ private:
+  /**
+   * @Brief  A slot of the ring buffer
+   */
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  void update_max_depth() {
+    size_t depth = this->size();
+    size_t max_depth = max_depth_.load(std::memory_order_relaxed);
+    while (depth > max_depth &&
+           !max_depth_.compare_exchange_weak(
+             max_depth, depth, std::memory_order_relaxed)) {
+    }
+  }
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t capacity_;
+  size_t mask_;
+
+  /**
+   * @Brief  Next positions to write and read, on separate cache lines
+   *         so producers and consumers do not slow each other down
+   */
+  alignas(64) std::atomic<size_t> enqueue_pos_;
+  alignas(64) std::atomic<size_t> dequeue_pos_;
+
+  std::atomic<size_t> max_depth_;
+  std::atomic<bool> closed_;
+};
@@ -0,0 +1,136 @@
+/* charging_curve.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <vector>
+
+/**
+ * @Brief  Tunable parameters for charging curves
+ */
+namespace chargingCurveParam {
+  /**
+   * @Brief  Number of steps of the state of charge in the
+   *         cumulative time table
+   */
+  constexpr int TABLE_SIZE = 1024;
+
+  /**
+   * @Brief  Lowest power of a curve as a fraction of the charge rate
+   *
+   *         Bounds the size of the inverse table
+   */
+  constexpr double MIN_POWER = 0.05;
+
+  /**
+   * @Brief  Number of steps of the charge level a charging plan
+   *         can stop at besides the exact distances to later chargers
+   *
+   *         More steps find a plan closer to the best one,
+   *         but the plan takes longer to find
+   */
+  constexpr int PLAN_LEVELS = 32;
+}  // namespace chargingCurveParam
+
+/**
+ * @Brief  The charging power of a car over its state of charge
+ *
+ *         Real chargers taper, so charging an almost full battery is
+ *         slower than charging an empty one. The power is a
+ *         piecewise-linear function of the state of charge, as a fraction
+ *         of the charge rate of the charging station. The time to charge
+ *         from empty is stored at evenly spaced states of charge, and the
+ *         table cell at every evenly spaced time, so the time between two
+ *         charges and the charge after a time are both O(1).
+ */
+class ChargingCurve {
+ public:
+  /**
+   * @Brief  Constructor
+   *
+   * @Param socs The states of charge of the points between 0 and 1,
+   *             in increasing order
+   * @Param powers The power at every point as a fraction of the
+   *               charge rate, between MIN_POWER and 1
+   */
+  ChargingCurve(const std::vector<double>& socs,
+                const std::vector<double>& powers);
+
+  /**
+   * @Brief  Get the power at a state of charge
+   *
+   * @Param soc The state of charge between 0 and 1
+   *
+   * @Returns  The power as a fraction of the charge rate
+   */
+  double power(double soc) const;
+
+  /**
+   * @Brief  Time to charge from empty to a charge at charge rate 1
+   *
+   *         The time between two charges is the difference
+   *         of their charge times divided by the charge rate
+   *
+   * @Param charge The charge in km
+   * @Param full_charge The full charge of the car in km
+   *
+   * @Returns  The time in hours at 1 km/hr
+   */
+  double charge_time(double charge, double full_charge) const;
+
+  /**
+   * @Brief  Time to charge between two charges
+   *
+   * @Param from The charge before charging in km
+   * @Param to The charge after charging in km
+   * @Param full_charge The full charge of the car in km
+   * @Param rate The charge rate of the charging station in km/hr
+   *
+   * @Returns  The charging time in hours
+   */
+  double charge_time(double from, double to,
+                     double full_charge, double rate) const;
+
+  /**
+   * @Brief  Charge after charging for a time
+   *
+   * @Param from The charge before charging in km
+   * @Param time The charging time in hours
+   * @Param full_charge The full charge of the car in km
+   * @Param rate The charge rate of the charging station in km/hr
+   *
+   * @Returns  The charge in km, at most full charge
+   */
+  double charge_after(double from, double time,
+                      double full_charge, double rate) const;
+
+ private:
+  /**
+   * @Brief  The points of the piecewise-linear power
+   */
+  std::vector<double> socs_;
+  std::vector<double> powers_;
+
+  /**
+   * @Brief  Time to charge from empty to every step of the
+   *         state of charge, for full charge 1 and charge rate 1
+   *
+   *         TABLE_SIZE + 1 values, linearly interpolated between steps
+   */
+  std::vector<double> times_;
+
+  /**
+   * @Brief  The step of times_ at every evenly spaced time
+   *
+   *         A time step is never longer than a step of times_,
+   *         so the step of any time is at most one step further
+   */
+  std::vector<int> steps_;
+
+  /**
+   * @Brief  The time between two values of steps_
+   */
+  double time_step_;
+};
@@ -0,0 +1,133 @@
+/* heuristic_cache.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "utility.h"
+
+/**
+ * @Brief  Tunable parameters for the goal table cache
+ */
+namespace heuristicParam {
+  /**
+   * @Brief  Default number of goal tables kept in the cache
+   */
+  constexpr size_t DEFAULT_CAPACITY = 64;
+}  // namespace heuristicParam
+
+/**
+ * @Brief  Hit and miss counts of the goal table cache
+ */
+struct GoalTableStats {
+  size_t hits = 0;
+  size_t misses = 0;
+
+  /**
+   * @Brief  Goal tables in the cache and the most it keeps
+   */
+  size_t size = 0;
+  size_t capacity = 0;
+
+  /**
+   * @Brief  Fraction of lookups served from the cache
+   *
+   * @Returns  The hit rate, 0 if there was no lookup
+   */
+  double hit_rate() const;
+};
+
+/**
+ * @Brief  Distance from every charging station to a goal,
+ *         with the fastest charge rate on the way
+ */
+struct GoalTable {
+  /**
+   * @Brief  Shortest distance to the goal over legs within full charge,
+   *         indexed by station id
+   *
+   *         Out of service stations and stations that cannot
+   *         reach the goal get infinity
+   */
+  std::vector<double> goal_dists;  // km
+
+  /**
+   * @Brief  Fastest charge rate of the stations that can reach the goal,
+   *         over the day for stations with a time profile
+   */
+  double max_rate = 0.0;  // km/hr
+
+  /**
+   * @Brief  Constant velocity of the car
+   */
+  double speed = 0.0;  // km/hr
+
+  /**
+   * @Brief  Lower bound of the remaining time from a station to the goal
+   *
+   *         The car drives the shortest distance and charges what it
+   *         lacks at the fastest rate, so the bound never exceeds
+   *         the remaining time of the best route
+   *
+   * @Param id The id of the charging station
+   * @Param charge Charge left when arriving at the station in km
+   *
+   * @Returns  The remaining time in hours, infinity if the
+   *           station cannot reach the goal
+   */
+  double remaining_time(int id, double charge) const;
+};
+
+namespace heuristic {
+  /**
+   * @Brief  Build the goal table of a goal
+   *
+   *         A backward Dijkstra of distance from the goal over the
+   *         stations within full charge of each other
+   *
+   * @Param goal_id The id of the goal charging station
+   * @Param vehicle The battery and speed setting of the car
+   *
+   * @Returns  The goal table
+   */
+  GoalTable build_goal_table(int goal_id, const VehicleProfile& vehicle);
+
+  /**
+   * @Brief  Get the goal table from the cache, or build it on a miss
+   *
+   *         Tables are keyed by goal, battery range, speed and the
+   *         database state version, so a table is never used after
+   *         a charging station changed. The least recently used table
+   *         is dropped when the cache is full.
+   *
+   * @Param goal_id The id of the goal charging station
+   * @Param vehicle The battery and speed setting of the car
+   *
+   * @Returns  The shared goal table
+   */
+  std::shared_ptr<const GoalTable> goal_table(
+      int goal_id, const VehicleProfile& vehicle);
+
+  /**
+   * @Brief  Change the number of goal tables kept in the cache
+   *
+   * @Param capacity The maximum number of goal tables
+   */
+  void set_capacity(size_t capacity);
+
+  /**
+   * @Brief  Drop every goal table and reset the counts
+   */
+  void clear();
+
+  /**
+   * @Brief  Get the hit and miss counts of the cache
+   *
+   * @Returns  The counts since the last clear
+   */
+  GoalTableStats stats();
+}  // namespace heuristic
@@ -0,0 +1,430 @@
+/* parallel_solver.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "path.h"
+#include "path_solver.h"
+
+/**
+ * @Brief  Tunable parameter for Parallel Solver class
+ */
+namespace parallelSolverParam {
+  /**
+   * @Brief  Capacity of the inbox of every search thread
+   *
+   *         Nodes that do not fit wait in the outbox of the sender,
+   *         so a full inbox never blocks a thread
+   */
+  constexpr size_t INBOX_CAPACITY = 1024;
+
+  /**
+   * @Brief  Default fraction of its cost a node can be above the cheapest
+   *         node of the other threads and still be searched
+   *
+   *         Threads search at the same time only within this window.
+   *         A wider window keeps more threads busy, but the search
+   *         drifts from the order of the sequential search, expands
+   *         more paths and restarts at other times, which changes
+   *         the cost of the result. Over 300 pairs at least 1,500 km
+   *         apart with 4 threads, 1e-3 expands 4% more paths than 1e-4
+   *         and costs up to 1.4% more, and 1e-2 expands 5.7 times
+   *         as many paths through restarts.
+   */
+  constexpr double COST_WINDOW = 1e-4;
+}  // namespace parallelSolverParam
+
+/**
+ * @Brief  A queued node of the parallel search
+ *
+ *         The node is sent between threads, so it carries the whole
+ *         chain of charging stations instead of a parent index
+ */
+struct ParallelNode {
+  /**
+   * @Brief  Heuristic cost that orders the open lists
+   */
+  int64_t cost;  // us
+
+  /**
+   * @Brief  Time cost so far plus the driving time left at full speed,
+   *         which no path through the node can beat
+   */
+  int64_t bound;  // us
+
+  /**
+   * @Brief  The search restart the node belongs to
+   */
+  int generation;
+
+  /**
+   * @Brief  The ids of the charging stations from the start
+   */
+  std::vector<int> ids;
+
+  /**
+   * @Brief  The cheapest node is on top of a heap
+   */
+  bool operator<(const ParallelNode& other) const {
+    return cost > other.cost;
+  }
+};
+
+/**
+ * @Brief  An experimental parallel solver for a single query of the
+ *         path charging problem
+ *
+ *         The work is split like hash distributed A*: every charging
+ *         station is owned by one thread, and a node is searched by the
+ *         owner of its last charging station. Every thread has its own
+ *         open list and an inbox for nodes generated by the other threads.
+ *         The cost of the best finished path is shared as an atomic value,
+ *         so every thread drops nodes that cannot beat it without taking
+ *         a lock.
+ *
+ *         The search follows the rules of PathSolver. Finished paths are
+ *         counted as candidates up to the number of candidates of the
+ *         setting, and the search restarts with a larger goal weight when
+ *         the queued nodes exceed the maximum queue size. Threads only
+ *         search nodes within COST_WINDOW of the cheapest node of all
+ *         threads, and a candidate is only counted when no thread holds
+ *         a cheaper node, so the result has the cost of the sequential
+ *         search up to the small drift of the window.
+ *
+ *         The window keeps the threads in the global order, so they
+ *         mostly wait for each other and the solver is not a speedup
+ *         over PathSolver. Letting every thread expand its own cheapest
+ *         node instead ran far ahead of the candidate order, with
+ *         4 threads expanding up to 360 times as many paths for a route
+ *         19% worse. On a single core, over 30 pairs at least 3,000 km
+ *         apart, the p50 was 8.3 ms for PathSolver, 8.5 ms with 1 thread
+ *         and 13.9 ms with 4 threads. Scaling on several cores has not
+ *         been measured, so the solver only runs when asked for.
+ */
+class ParallelSolver {
+ public:
+   /**
+    * @Brief  Constructor
+    *
+    * @Param start_charger The name of the initial charging station
+    * @Param goal_charger The name of the goal charging station
+    * @Param vehicle The battery and speed setting of the car
+    * @Param num_of_threads The number of search threads,
+    *                       0 uses every hardware thread
+    */
+  ParallelSolver(const std::string& start_charger,
+                 const std::string& goal_charger,
+                 const VehicleProfile& vehicle = VehicleProfile(),
+                 int num_of_threads = 0);
+
+  ParallelSolver(const ParallelSolver&) = delete;
+  ParallelSolver& operator=(const ParallelSolver&) = delete;
+
+  /**
+   * @Brief  Change the tunable parameters of the search
+   *
+   * @Param config The runtime setting of the parameters
+   */
+  void set_config(const PathSolverConfig& config);
+
+  /**
+   * @Brief  Change how far above the cheapest node of the other
+   *         threads a node can still be searched
+   *
+   *         Throws std::invalid_argument for a negative window
+   *
+   * @Param cost_window The fraction of the cost of the node
+   */
+  void set_cost_window(double cost_window);
+
+  /**
+   * @Brief  Search for valid paths and choose the best one to return
+   *
+   * @Returns  The best path found
+   */
+  std::string solve();
+
+  /**
+   * @Brief  Search for valid paths and return the best one
+   *         as a structured route
+   *
+   * @Returns  The best route with the status of the search
+   */
+  RouteResult solve_route();
+
+  /**
+   * @Brief  Get the number of paths expanded by all threads
+   *
+   * @Returns  The number of expanded paths of the last search
+   */
+  size_t nodes_expanded() const;
+
+  /**
+   * @Brief  Get the number of search threads
+   */
+  int num_of_threads() const;
+
+ private:
+  /**
+   * @Brief  The open list, inbox and outboxes of a search thread
+   */
+  struct Worker {
+    explicit Worker(int num_of_threads);
+
+    /**
+     * @Brief  A heap of the nodes to search, the cheapest on top
+     */
+    std::vector<ParallelNode> open_list;
+
+    /**
+     * @Brief  Nodes sent to this thread by the other threads
+     */
+    BoundedQueue<ParallelNode> inbox;
+
+    /**
+     * @Brief  Nodes waiting to be sent to each thread
+     */
+    std::vector<std::vector<ParallelNode>> outboxes;
+
+    /**
+     * @Brief  The cost of the cheapest node held by the thread, or sent
+     *         by it and not yet covered by the inbox of the owner, read
+     *         by the other threads before they search a node
+     */
+    alignas(64) std::atomic<int64_t> min_cost;
+
+    /**
+     * @Brief  The cost of the cheapest node sent to the inbox since
+     *         the thread last emptied it
+     */
+    alignas(64) std::atomic<int64_t> inbox_min_cost;
+
+    /**
+     * @Brief  The search restart the open list belongs to
+     */
+    int generation = 0;
+
+    size_t nodes_expanded = 0;
+  };
+
+  /**
+   * @Brief  Destroy and free a Worker from new_worker
+   */
+  struct WorkerDeleter {
+    void operator()(Worker* worker) const;
+  };
+
+  /**
+   * @Brief  Allocate a Worker on its own cache lines
+   *
+   *         Plain new does not have to keep the alignment of the
+   *         atomics of a Worker before C++17, so the memory is
+   *         allocated with posix_memalign
+   *
+   * @Param num_of_threads The number of search threads
+   *
+   * @Returns  The Worker, freed by WorkerDeleter
+   */
+  static std::unique_ptr<Worker, WorkerDeleter> new_worker(
+      int num_of_threads);
+
+  /**
+   * @Brief  Run the search loop of a thread until the search ends
+   *
+   * @Param index The index of the thread
+   */
+  void search(int index);
+
+  /**
+   * @Brief  Pop and search the cheapest node of a thread
+   *
+   * @Returns  False if the thread has no node, or its cheapest node
+   *           has to wait for cheaper nodes of the other threads
+   */
+  bool search_next(Worker& worker, int index);
+
+  /**
+   * @Brief  Whether no other thread holds or is sent a node
+   *         cheaper than a cost
+   *
+   * @Param index The index of the asking thread
+   * @Param cost The cost to compare with
+   */
+  bool is_cheapest(int index, int64_t cost) const;
+
+  /**
+   * @Brief  Count a finished path as a candidate and keep it
+   *         if it is the best one
+   *
+   *         Only the thread owning the goal gets finished paths
+   *
+   * @Param path The finished path
+   * @Param generation The search restart of the path
+   */
+  void finish_candidate(Path& path, int generation);
+
+  /**
+   * @Brief  Generate the children of a path and send them to their owners
+   */
+  void expand(Worker& worker, Path& parent, const ParallelNode& node);
+
+  /**
+   * @Brief  Send a node to the thread owning its last charging station
+   */
+  void send(Worker& worker, ParallelNode node);
+
+  /**
+   * @Brief  Move the waiting nodes of the outboxes into the inboxes
+   *         as far as they fit
+   */
+  void flush(Worker& worker);
+
+  /**
+   * @Brief  Move the nodes of the inbox into the open list, and
+   *         publish the cost of the cheapest node the thread holds
+   */
+  void receive(Worker& worker);
+
+  /**
+   * @Brief  Move the nodes in the inbox now into the open list
+   */
+  void drain_inbox(Worker& worker);
+
+  /**
+   * @Brief  The cost of the cheapest node in the open list
+   *         or the outboxes of a thread
+   */
+  int64_t held_min_cost(const Worker& worker) const;
+
+  /**
+   * @Brief  Drop the nodes of a thread from before the last restart
+   */
+  void sync_generation(Worker& worker);
+
+  /**
+   * @Brief  Restart the search from the start charging station
+   *         with a larger goal weight
+   *
+   * @Param worker The thread that found the search too large
+   * @Param generation The search restart that is too large
+   */
+  void restart(Worker& worker, int generation);
+
+  /**
+   * @Brief  Lower the shared best cost if the cost is smaller
+   *
+   * @Returns  True if the cost is the new best cost
+   */
+  bool update_best_cost(int64_t cost);
+
+  /**
+   * @Brief  The thread that owns a charging station
+   */
+  int owner(int charger_id) const;
+
+  /**
+   * @Brief  Rebuild the Path of a node
+   */
+  std::shared_ptr<Path> build_path(const std::vector<int>& ids) const;
+
+  /**
+   * @Brief  Create the node of the start charging station
+   */
+  ParallelNode start_node(int generation) const;
+
+  /**
+   * @Brief  The initial charging station
+   */
+  std::string start_charger_;
+
+  /**
+   * @Brief  The goal charging station
+   */
+  std::string goal_charger_;
+
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle_;
+
+  /**
+   * @Brief  The runtime setting of the tunable parameters
+   */
+  PathSolverConfig config_;
+
+  double cost_window_ = parallelSolverParam::COST_WINDOW;
+
+  int num_of_threads_;
+  int start_id_;
+  int goal_id_;
+
+  /**
+   * @Brief  Distance to goal of every charging station over legs within
+   *         full charge, nullptr if the search uses the distance to goal
+   */
+  std::shared_ptr<const GoalTable> goal_table_;
+
+  /**
+   * @Brief  Distance to goal of every charging station
+   */
+  std::vector<double> goal_dists_;  // km
+
+  std::vector<std::unique_ptr<Worker, WorkerDeleter>> workers_;
+
+  /**
+   * @Brief  The cost of the best finished path, shared by every thread
+   *         for pruning
+   */
+  alignas(64) std::atomic<int64_t> best_cost_;  // us
+
+  /**
+   * @Brief  The best finished path, guarded by best_path_mutex_
+   *         as it only changes with a new best cost
+   */
+  Path best_path_;
+  std::mutex best_path_mutex_;
+
+  /**
+   * @Brief  The number of restarts, every node carries the
+   *         restart it belongs to
+   */
+  alignas(64) std::atomic<int> generation_;
+
+  /**
+   * @Brief  Nodes that are queued, waiting in an inbox or outbox,
+   *         or being searched
+   *
+   *         The search is over when the count drops to 0
+   */
+  std::atomic<long> pending_nodes_;
+
+  /**
+   * @Brief  Nodes queued since the last restart, which is the queue
+   *         size PathSolver compares with the maximum queue size
+   */
+  std::atomic<long> queued_nodes_;
+
+  /**
+   * @Brief  Candidates are only counted by the thread owning the goal
+   */
+  int candidate_count_ = 0;
+
+  std::atomic<bool> done_;
+
+  /**
+   * @Brief  Whether the search ended by the restart limit
+   */
+  bool reset_limit_ = false;
+
+  size_t nodes_expanded_ = 0;
+};
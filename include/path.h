@@ -6,10 +6,12 @@
 
 #pragma once
 #include <limits>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "route_result.h"
 #include "utility.h"
 
 /**
@@ -23,6 +25,91 @@ namespace pathParam {
   constexpr double DEFAULT_GOAL_WEIGHT = 1.0;
 }  // namespace pathParam
 
+/**
+ * @Brief  The part of the time cost that every
+ *         child of a Path shares
+ *
+ *         Adding a charger only changes the charging amount at the
+ *         chargers without a faster charger ahead that are within
+ *         full charge of the current charger, listed in path order
+ */
+struct ChildCostBase {
+  /**
+   * @Brief  Time cost of the Path
+   */
+  double time;  // hr
+
+  /**
+   * @Brief  Time to arrive at the current charger and remaining charge
+   *         there with the greedy charging plan, when another charger
+   *         follows
+   */
+  double greedy_time;  // hr
+  double greedy_charge;  // km
+
+  /**
+   * @Brief  Maximum charge and constant velocity of the car
+   */
+  double full_charge;  // km
+  double speed;  // km/hr
+
+  /**
+   * @Brief  Distance from each changed charger to the current charger
+   */
+  std::vector<double> dists_to_end;  // km
+
+  /**
+   * @Brief  Remaining charge when arriving at each changed charger
+   */
+  std::vector<double> arrival_charges;  // km
+
+  /**
+   * @Brief  Charging amount at each changed charger in the Path
+   */
+  std::vector<double> charge_amounts;  // km
+
+  /**
+   * @Brief  Charge rate of each changed charger
+   */
+  std::vector<double> rates;  // km/hr
+
+  /**
+   * @Brief  With charging curves, the cheapest arrivals at the
+   *         current charger, in increasing order of charge and time
+   *
+   *         Empty if every charger charges at a constant rate
+   */
+  std::vector<double> arrival_levels;  // km
+  std::vector<double> arrival_times;  // hr
+
+  /**
+   * @Brief  Charging curve and charge rate of the current charger
+   *
+   *         curve is nullptr if the charger charges at a constant rate
+   */
+  const ChargingCurve* curve = nullptr;
+  double rate = 0.0;  // km/hr
+
+  /**
+   * @Brief  Time cost of the Path with one more charger
+   *
+   * @Param dist The distance from the current charger to the new charger
+   *
+   * @Returns  The time cost of the child in hours
+   */
+  double child_time(double dist) const;
+
+  /**
+   * @Brief  Greedy time cost of the Path with one more charger,
+   *         like Path::greedy_time_cost of the child
+   *
+   * @Param dist The distance from the current charger to the new charger
+   *
+   * @Returns  The greedy time cost of the child in hours
+   */
+  double greedy_child_time(double dist) const;
+};
+
 /**
  * @Brief  Data structure to hold
  *         a path of charging station and charging history
@@ -34,9 +121,12 @@ class Path {
     *
     * @Param start_charger The name of the initial charging station
     * @Param goal_charger The name of the goal charging station
+    *                     (Empty for a path without a goal)
+    * @Param vehicle The battery and speed setting of the car
     */
   Path(const std::string& start_charger,
-       const std::string& goal_charger);
+       const std::string& goal_charger,
+       const VehicleProfile& vehicle = VehicleProfile());
 
   /**
    * @Brief  Add a new charging station to the path
@@ -46,6 +136,33 @@ class Path {
    */
   void add_charger(std::string& next_charger);
 
+  /**
+   * @Brief  Add a new charging station with a known distance
+   *         from the current charging station
+   *
+   * @Param next_charger
+   * @Param dist The distance from the current charging station in km
+   */
+  void add_charger(const std::string& next_charger, double dist);
+
+  /**
+   * @Brief  Add a charging station that can already be in the path
+   *
+   *         A trip through several waypoints can pass a charging
+   *         station again on a later leg
+   *
+   * @Param next_charger
+   * @Param dist The distance from the current charging station in km
+   */
+  void add_stop(const std::string& next_charger, double dist);
+
+  /**
+   * @Brief  Part of the time cost shared by every child of the Path
+   *
+   * @Returns  The shared part of the time cost of a child
+   */
+  ChildCostBase child_cost_base();
+
   /**
    * @Brief  Cost calculation based on the Path
    *
@@ -56,6 +173,20 @@ class Path {
    */
   double time_cost();
 
+  /**
+   * @Brief  Cost calculation with the greedy charging plan
+   *         that orders the search
+   *
+   *         Each charger only compares its charge rate with the next
+   *         charger. It charges just enough before a faster charger or
+   *         at the end of the Path, and fills up before a slower one.
+   *         The plan is never faster than the exact plan of time_cost.
+   *         With charging curves or time-dependent rates it is time_cost.
+   *
+   * @Returns  Time cost in hours
+   */
+  double greedy_time_cost();
+
   /**
    * @Brief  Convert the Path into the answer string format
    *
@@ -63,6 +194,15 @@ class Path {
    */
   std::string to_string();
 
+  /**
+   * @Brief  Convert the Path into a structured route
+   *
+   * @Param status How the search for the Path ended
+   *
+   * @Returns  The route with charger ids, charging times and legs
+   */
+  RouteResult to_route_result(RouteStatus status = RouteStatus::SUCCESS);
+
   /**
    * @Brief  Whether a charging station has been visited
    *
@@ -80,10 +220,43 @@ class Path {
    */
   std::string current_charger();
 
+  /**
+   * @Brief  Get the visited charging stations in order
+   *
+   * @Returns  The charging stations in the Path
+   */
+  const std::vector<std::string>& chargers() const;
+
+  /**
+   * @Brief  Fraction of the intermediate charging stations shared
+   *         between this Path and another Path
+   *
+   *         Start and goal charging stations are not counted. The shared
+   *         count is divided by the intermediate count of the shorter
+   *         Path, so the ratio is the same in both directions.
+   *
+   * @Param other The Path to compare with
+   *
+   * @Returns  The shared fraction between 0 and 1
+   */
+  double shared_ratio(const Path& other) const;
+
+  /**
+   * @Brief  Remaining charge when arriving at the latest charger
+   *         with the optimized charging amount
+   *
+   * @Returns  The remaining charge in km
+   */
+  double current_charge();
+
   /**
    * @Brief Heuristic time cost based on already visited
    *        charging station and the estimated distance to goal
    *
+   *        The visited part uses the greedy charging plan, so the
+   *        search expands paths in the same order as with the greedy
+   *        charge pass, and only the finished paths get the exact plan
+   *
    * @Param goal_weight A penalty value for estimated distance to goal
    *
    *                    Higher weights will result in higher cost with
@@ -94,6 +267,13 @@ class Path {
   double heuristic_cost(
       double goal_weight = pathParam::DEFAULT_GOAL_WEIGHT);
 
+  /**
+   * @Brief  Estimate the memory held by the Path
+   *
+   * @Returns  The estimated size in bytes including heap storage
+   */
+  size_t memory_size() const;
+
   /**
    * @Brief  Get number of visited charging station in the Path
    *
@@ -101,6 +281,30 @@ class Path {
    */
   int num_of_chargers();
 
+  /**
+   * @Brief  Use time-dependent charge rates and wait times
+   *         from the database starting at a departure time
+   *
+   *         Charging at a charging station starts after the wait time at
+   *         the arrival time, with the charge rate at the start of charging
+   *
+   * @Param departure_time The time of day leaving the start charger in hours
+   */
+  void set_departure_time(double departure_time);
+
+  /**
+   * @Brief  Reload the charge rate and charging curve of every visited
+   *         charging station from the database after a change
+   */
+  void refresh_rates();
+
+  /**
+   * @Brief  Get the vehicle setting of the Path
+   *
+   * @Returns  The battery and speed setting of the car
+   */
+  const VehicleProfile& vehicle() const;
+
   /**
    * @Brief  True if the goal charging station is in the Path
    */
@@ -110,9 +314,100 @@ class Path {
   /**
    * @Brief  Distribute charging amount to each charging station
    *         in Path that optimize the total charging time
+   *
+   *         A charger with a faster charger within full charge ahead
+   *         charges just enough to get there, any other charger fills
+   *         up, or charges just enough to get to the current charger.
+   *         This plan is exact for a fixed order of chargers.
    */
   void optimize_charge();
 
+  /**
+   * @Brief  Distribute charging amount at constant charge rates
+   *
+   * @Param next_faster The nearest faster charger ahead of every charger
+   */
+  void distribute_charge(const std::vector<int>& next_faster);
+
+  /**
+   * @Brief  Distribute charging amount with charging curves
+   *
+   *         With tapering power the cheapest charge is no longer all or
+   *         nothing, so a plan is searched stage by stage. The car leaves
+   *         every charger with a charge from evenly spaced levels, the
+   *         exact distance to a later charger, or the charge it arrived
+   *         with. Only leaving charges that are cheaper than every higher
+   *         one are kept, so every stage stays small.
+   *
+   * @Param rates The charge rate of every charger
+   * @Param base Filled with the cheapest arrivals at the current charger,
+   *             nullptr if only the plan is needed
+   */
+  void optimize_curve_charge(const std::vector<double>& rates,
+                             ChildCostBase* base = nullptr);
+
+  /**
+   * @Brief  Time to charge at a charger in the Path
+   *
+   * @Param index The index of the charger in chargers_
+   * @Param arrival_charge The remaining charge when arriving
+   *
+   * @Returns  The charging time of the planned amount in hours
+   */
+  double charge_time(int index, double arrival_charge) const;
+
+  /**
+   * @Brief  Time to charge at a charger in the Path at a charge rate
+   *
+   * @Param index The index of the charger in chargers_
+   * @Param arrival_charge The remaining charge when arriving
+   * @Param rate The charge rate of the charger
+   *
+   * @Returns  The charging time of the planned amount in hours
+   */
+  double charge_time(int index, double arrival_charge, double rate) const;
+
+  /**
+   * @Brief  Charging curve of a charger in the Path
+   *
+   * @Returns  nullptr if the charger charges at a constant rate
+   */
+  const ChargingCurve* charge_curve(int index) const;
+
+  /**
+   * @Brief  Store the charging curve of the latest charger
+   */
+  void push_charge_curve();
+
+  /**
+   * @Brief  Add a charger to the search for faster chargers ahead
+   *
+   *         Chargers still waiting for a faster charger are kept on a
+   *         stack with decreasing charge rates, so every charger is
+   *         pushed and popped once
+   *
+   * @Param index The index of the charger in chargers_
+   */
+  void push_faster_charger(int index);
+
+  /**
+   * @Brief  Find the faster charger ahead of every charger again
+   *         after the charge rates changed
+   */
+  void update_faster_chargers();
+
+  /**
+   * @Brief  Cost calculation with time-dependent charge rates
+   *         and wait times
+   *
+   *         The charging plan is refined once with the charge rates
+   *         at the estimated arrival times. The profile rates are only
+   *         used for the cost, charge_rates_ keeps the database rates.
+   *
+   * @Returns  Time cost in hours including wait times
+   */
+  double time_dependent_cost();
+
   /**
    * @Brief  The initial charging station
    */
@@ -123,6 +418,21 @@ class Path {
    */
   std::string goal_charger_;
 
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle_;
+
+  /**
+   * @Brief  Whether charge rates and wait times depend on the time of day
+   */
+  bool time_dependent_ = false;
+
+  /**
+   * @Brief  The time of day leaving the start charger
+   */
+  double departure_time_ = 0.0;  // hr
+
   /**
    * @Brief  Visited charging stations
    */
@@ -150,6 +460,14 @@ class Path {
    */
   std::vector<double> charge_rates_;
 
+  /**
+   * @Brief  The charging curve of each charging station in Path
+   *
+   *         Empty while every charger charges at a constant rate,
+   *         otherwise charge_curves_ shares the same index as chargers_
+   */
+  std::vector<std::shared_ptr<const ChargingCurve>> charge_curves_;
+
   /**
    * @Brief  The distance between charging station in Path
    *
@@ -157,4 +475,24 @@ class Path {
    *         chargers_[i] and chargers_[i+1]
    */
   std::vector<double> dists_;
+
+  /**
+   * @Brief  Distance from the start charger to each charger in Path
+   *
+   *         accumulate_dists_ shares the same index as chargers_
+   */
+  std::vector<double> accumulate_dists_;  // km
+
+  /**
+   * @Brief  Index of the nearest faster charger ahead of each charger,
+   *         -1 if there is none before the current charger
+   *
+   *         next_faster_ shares the same index as chargers_
+   */
+  std::vector<int> next_faster_;
+
+  /**
+   * @Brief  Chargers without a faster charger ahead
+   */
+  std::vector<int> faster_stack_;
 };
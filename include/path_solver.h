@@ -5,6 +5,7 @@
  */
 
 #pragma once
+#include <cstdint>
 #include <functional>
 #include <limits>
 #include <memory>
@@ -14,10 +15,57 @@
 #include <utility>
 #include <vector>
 
+#include "heuristic_cache.h"
 #include "path.h"
 
 using PathAndCost = std::pair<double, std::shared_ptr<Path>>;
 
+/**
+ * @Brief  A node of the search that only refers to its parent
+ *
+ *         The Path of a node is rebuilt along the parent chain when the
+ *         node is expanded, and the visited charging stations are the
+ *         charging stations of the chain. A queued node takes 12 bytes
+ *         instead of a whole Path.
+ */
+struct SearchNode {
+  /**
+   * @Brief  Index of the parent in the node arena, -1 for the start
+   */
+  int32_t parent;
+
+  int32_t charger_id;
+
+  /**
+   * @Brief  Number of charging stations from the start to the node
+   */
+  int32_t depth;
+};
+
+/**
+ * @Brief  A queued node with its heuristic cost in fixed point
+ *
+ *         Integer costs with the node index as tie breaker make the
+ *         order of equal keys exact. The key is still rounded from the
+ *         double cost, and the distances and charge times behind it come
+ *         from floating point math. The library is built without fused
+ *         multiply-add contraction, but a math library with different
+ *         trigonometric rounding can still move a key by one unit and
+ *         change the search order on another platform.
+ */
+struct QueueEntry {
+  int64_t cost;  // us
+  int32_t node;
+
+  /**
+   * @Brief  The cheapest and then the oldest node is on top
+   *         of a priority queue
+   */
+  bool operator<(const QueueEntry& other) const {
+    return cost > other.cost || (cost == other.cost && node > other.node);
+  }
+};
+
 /**
  * @Brief  Tunable parameter for Path Solver class
  */
@@ -54,8 +102,102 @@ namespace pathSolverParam {
    *         a different weight
    */
   constexpr int MAX_RESET = 20;
+
+  /**
+   * @Brief  Default maximum fraction of intermediate charging
+   *         stations an alternative path can share with
+   *         a better ranked path
+   */
+  constexpr double MAX_SHARED_RATIO = 0.5;
+
+  /**
+   * @Brief  Number of candidate path searched for each
+   *         alternative path
+   *
+   *         Different enough paths are rarer than good ones,
+   *         so alternatives search more candidates than solve()
+   */
+  constexpr int ALTERNATIVE_CANDIDATE = 30;
+
+  /**
+   * @Brief  Maximum explored paths kept when re-planning
+   *         from an intermediate charging station
+   *
+   *         Only the most promising paths are kept, so the reused
+   *         search frontier cannot trigger a queue reset
+   */
+  constexpr int MAX_FRONTIER_REUSE = 100;
+
+  /**
+   * @Brief  Whether the search is guided by a lower bound of the
+   *         remaining time from a backward search from the goal
+   *
+   *         The bound is about 10% below the real cost at the start,
+   *         so long searches reset as often as with the distance to goal.
+   *         Over the pinned workload it finds cheaper routes for 23
+   *         queries and costlier ones for 27, up to 3.1% more, so it
+   *         is off by default.
+   */
+  constexpr bool USE_GOAL_TABLE = false;
+
+  /**
+   * @Brief  Fixed point units of the queued heuristic cost in an hour
+   */
+  constexpr double COST_UNITS_PER_HOUR = 3.6e9;  // us
 }  // namespace pathSolverParam
 
+/**
+ * @Brief  Runtime setting of the tunable parameters of Path Solver
+ *
+ *         The default setting uses the values in pathSolverParam
+ *         and pathParam
+ */
+struct PathSolverConfig {
+  /**
+   * @Brief  Number of generated valid candidate path
+   */
+  int num_of_candidate = pathSolverParam::NUM_OF_CANDIDATE;
+
+  /**
+   * @Brief  Penalty to the goal weight when path search restart
+   */
+  double goal_weight_step = pathSolverParam::GOAL_WEIGHT_STEP;
+
+  /**
+   * @Brief  Maximum ongoing path search before restart
+   */
+  int max_queue_size = pathSolverParam::MAX_QUEUE_SIZE;
+
+  /**
+   * @Brief  Maximum time reset search and restart
+   */
+  int max_reset = pathSolverParam::MAX_RESET;
+
+  /**
+   * @Brief  Initial weight to penalize large distance to goal
+   */
+  double default_goal_weight = pathParam::DEFAULT_GOAL_WEIGHT;
+
+  /**
+   * @Brief  Guide the search with a lower bound of the remaining time
+   *         from a backward search from the goal instead of the
+   *         distance to goal
+   *
+   *         The goal tables are shared through the heuristic cache,
+   *         so later queries to the same goal skip the backward search
+   */
+  bool use_goal_table = pathSolverParam::USE_GOAL_TABLE;
+
+  /**
+   * @Brief  Get a tuned setting for a latency tier
+   *
+   * @Param name The name of the preset (default, balanced, fast)
+   *
+   * @Returns  The setting of the preset
+   */
+  static PathSolverConfig preset(const std::string& name);
+};
+
 /**
  * @Brief  A class for solving the path charging problem
  */
@@ -66,9 +208,11 @@ class PathSolver {
     *
     * @Param start_charger The name of the initial charging station
     * @Param goal_charger The name of the goal charging station
+    * @Param vehicle The battery and speed setting of the car
     */
   PathSolver(const std::string& start_charger,
-             const std::string& goal_charger);
+             const std::string& goal_charger,
+             const VehicleProfile& vehicle = VehicleProfile());
 
   /**
    * @Brief  Expanding parent Path by finding
@@ -81,6 +225,25 @@ class PathSolver {
    */
   std::vector<std::string> find_neighbors(Path& parent);
 
+  /**
+   * @Brief  Change the tunable parameters and restart the search
+   *
+   * @Param config The runtime setting of the parameters
+   */
+  void set_config(const PathSolverConfig& config);
+
+  /**
+   * @Brief  Search with time-dependent charge rates and wait times
+   *
+   *         Every path is evaluated with the charge rate and wait time
+   *         at its arrival time at each charging station. Wait time
+   *         profiles keep first-in-first-out order, so leaving later
+   *         never arrives earlier and the expansion order stays valid.
+   *
+   * @Param departure_time The time of day leaving the start charger in hours
+   */
+  void set_departure_time(double departure_time);
+
   /**
    * @Brief  Search for valid paths and choose the best one to return
    *
@@ -88,6 +251,103 @@ class PathSolver {
    */
   std::string solve();
 
+  /**
+   * @Brief  Search for valid paths and return the best one
+   *         as a structured route
+   *
+   *         When the queue runs out before enough candidates are
+   *         compared, the best candidate found is still returned
+   *
+   * @Returns  The best route with the status of the search
+   */
+  RouteResult solve_route();
+
+  /**
+   * @Brief  Search for the best path and meaningfully different
+   *         alternatives in a single search
+   *
+   *         Finished candidates are collected from the same queue
+   *         used by solve(). A candidate is accepted when it shares at most
+   *         max_shared_ratio of its intermediate charging stations with
+   *         every path ranked before it.
+   *
+   *         This is not a k-shortest paths search like Yen's algorithm.
+   *         Only the candidates the A* search happens to finish are ranked
+   *         and filtered greedily, so a k-th best path that the search never
+   *         finishes is missed, and fewer than k paths can be returned.
+   *
+   * @Param k The maximum number of paths to return
+   * @Param max_shared_ratio The maximum shared fraction of
+   *                         intermediate charging stations
+   *
+   * @Returns  Up to k paths ranked by total time cost
+   */
+  std::vector<Path> solve_alternatives(
+      int k, double max_shared_ratio = pathSolverParam::MAX_SHARED_RATIO);
+
+  /**
+   * @Brief  Repair the solution after charging stations changed
+   *         availability or charge rate in the database
+   *
+   *         The ongoing search is reused. Queued paths through out of
+   *         service charging stations are dropped, queued paths through
+   *         charging stations with a new charge rate are re-scored, and
+   *         the previous best path is kept up to its first out of service
+   *         charging station before the search continues. Every expanded
+   *         path within range of a charging station back in service is
+   *         extended to it again, so a route through it is not missed.
+   *
+   * @Returns  The best path after the change
+   */
+  std::string replan();
+
+  /**
+   * @Brief  Use a previously planned route as the initial best path
+   *
+   *         The part of the route from the start charging station
+   *         to the goal becomes the best path to beat, and the search
+   *         is focused around it
+   *
+   * @Param route The charging stations of the previous route
+   *
+   * @Returns  False if the route does not lead from the start charger
+   *           to the goal with the current vehicle
+   */
+  bool warm_start(const std::vector<std::string>& route);
+
+  /**
+   * @Brief  Re-plan from an intermediate charging station
+   *         with the current charge of the car
+   *
+   *         Queued paths through the charging station are kept
+   *         from that charging station on, so the explored search
+   *         frontier is reused, and the previous best path is used
+   *         as warm start.
+   *
+   * @Param charger The name of the current charging station
+   * @Param charge The remaining charge of the car in km
+   *
+   * @Returns  The best path from the current charging station to the goal
+   */
+  std::string replan_from(const std::string& charger, double charge);
+
+  /**
+   * @Brief  Get the number of paths expanded by the search
+   *
+   *         Every path popped from the queue that has not reached
+   *         the goal counts, also across resets and re-planning
+   *
+   * @Returns  The number of expanded paths
+   */
+  size_t nodes_expanded() const;
+
+  /**
+   * @Brief  Get the most memory used by the node arena and the queue
+   *
+   * @Returns  The peak memory in bytes
+   */
+  size_t peak_memory() const;
+
  private:
   /**
    * @Brief  Reset the path candidate queue to only contain
@@ -95,12 +355,149 @@ class PathSolver {
    */
   void reset_queue();
 
+  /**
+   * @Brief  Continue the search until the next path reaches the goal
+   *
+   * @Returns  The next finished path, or nullptr if the queue is empty
+   */
+  std::shared_ptr<Path> next_candidate();
+
+  /**
+   * @Brief  Heuristic cost of a path with the current goal weight
+   *
+   *         Uses the goal table when it is enabled, otherwise
+   *         the distance to goal of Path::heuristic_cost
+   *
+   * @Param path The path to score
+   *
+   * @Returns  The heuristic cost in hours
+   */
+  double heuristic_cost(Path& path);
+
+  /**
+   * @Brief  Get the goal table of the current database state
+   *         from the heuristic cache if it is enabled
+   */
+  void update_goal_table();
+
+  /**
+   * @Brief  Push the valid children of a path to the queue
+   *
+   *         All neighbors of the current charger are scored together
+   *         in one pass over the neighbor distance, distance to goal
+   *         and visited arrays, and only valid children are queued
+   *         as nodes
+   *
+   * @Param parent The parent path for expanding
+   * @Param parent_node The node of the parent path
+   */
+  void expand(Path& parent, int parent_node);
+
+  /**
+   * @Brief  Add a node to the arena
+   *
+   * @Param parent The index of the parent node, -1 for the start
+   * @Param charger_id The id of the charging station of the node
+   *
+   * @Returns  The index of the node
+   */
+  int add_node(int parent, int charger_id);
+
+  /**
+   * @Brief  Queue a node with its heuristic cost
+   *
+   *         Nodes with a cost that is not finite are not queued
+   *
+   * @Param node The index of the node
+   * @Param cost The heuristic cost in hours
+   */
+  void push_node(int node, double cost);
+
+  /**
+   * @Brief  Add the nodes of a path to the arena and queue
+   *         the last one with its heuristic cost
+   *
+   * @Param path The path to queue
+   */
+  void push_path(Path& path);
+
+  /**
+   * @Brief  Get the charging stations of a node along its parent chain
+   *
+   * @Param node The index of the node
+   *
+   * @Returns  The ids of the charging stations from the start
+   */
+  std::vector<int> chain_ids(int node) const;
+
+  /**
+   * @Brief  Rebuild the Path of a node
+   *
+   * @Param node The index of the node
+   *
+   * @Returns  The path from the start charging station to the node
+   */
+  std::shared_ptr<Path> build_path(int node);
+
+  /**
+   * @Brief  Take every queued path out of the queue
+   *
+   *         The node arena is cleared, so the paths are
+   *         queued again with push_path
+   *
+   * @Returns  The queued paths from the cheapest
+   */
+  std::vector<std::shared_ptr<Path>> take_queued_paths();
+
+  /**
+   * @Brief  Distance to goal of every neighbor of a charging station
+   *
+   *         The distances share the index of the neighbor table and
+   *         are computed once per charging station for the search
+   *
+   * @Param id The id of the charging station
+   *
+   * @Returns  The distances to goal in km
+   */
+  const std::vector<double>& neighbor_goal_dists(int id);
+
+  /**
+   * @Brief  Create a path that only contains the start charging station
+   *
+   * @Returns  The path with the vehicle and departure time of the solver
+   */
+  std::shared_ptr<Path> init_path();
+
+  /**
+   * @Brief  Build a path from the start charging station
+   *         along a list of charging stations
+   *
+   * @Param chargers The charging stations of the path
+   * @Param first The index of the start charging station in chargers
+   *
+   * @Returns  The path, or nullptr if the path is not valid
+   */
+  std::shared_ptr<Path> make_path(
+      const std::vector<std::string>& chargers, int first);
+
   /**
    * @Brief  A priorit queue that contains possible unfinished path candidate
    *
    *         The priority is based on the heuristic cost of the path
    */
-  std::priority_queue<PathAndCost> path_queue_;
+  std::priority_queue<QueueEntry> path_queue_;
+
+  /**
+   * @Brief  Every node created since the last queue reset
+   *
+   *         Expanded nodes stay as parents of queued nodes
+   */
+  std::vector<SearchNode> nodes_;
+
+  /**
+   * @Brief  The most memory used by the node arena and the queue
+   */
+  size_t peak_memory_ = 0;  // bytes
 
   /**
    * @Brief  The initial charging station
@@ -112,6 +509,11 @@ class PathSolver {
    */
   std::string goal_charger_;
 
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle_;
+
   /**
    * @Brief The finished path that has the least cost so far
    */
@@ -135,8 +537,61 @@ class PathSolver {
    */
   double goal_weight_ = pathParam::DEFAULT_GOAL_WEIGHT;
 
+  /**
+   * @Brief  The runtime setting of the tunable parameters
+   */
+  PathSolverConfig config_;
+
   /**
    * @Brief  The number of reset
    */
   int reset_count_ = 0;
+
+  /**
+   * @Brief  The number of expanded paths
+   */
+  size_t nodes_expanded_ = 0;
+
+  /**
+   * @Brief  The database state version the search is based on
+   */
+  unsigned long state_version_ = 0;
+
+  /**
+   * @Brief  The id of the goal charging station
+   */
+  int goal_id_;
+
+  /**
+   * @Brief  Distance to goal of the neighbors of each charging station
+   *
+   *         Indexed by charging station id, empty until expanded
+   */
+  std::vector<std::vector<double>> goal_dists_;
+
+  /**
+   * @Brief  Distance to goal of every charging station over legs within
+   *         full charge, nullptr if the search uses the distance to goal
+   *
+   *         Fetched from the heuristic cache once when the search
+   *         starts, and again only by replan
+   */
+  std::shared_ptr<const GoalTable> goal_table_;
+
+  /**
+   * @Brief  Scratch arrays for expanding a path
+   */
+  std::vector<int> visited_ids_;
+  std::vector<double> child_costs_;
+  std::vector<char> child_valid_;
+
+  /**
+   * @Brief  Whether charge rates and wait times depend on the time of day
+   */
+  bool time_dependent_ = false;
+
+  /**
+   * @Brief  The time of day leaving the start charger
+   */
+  double departure_time_ = 0.0;  // hr
 };
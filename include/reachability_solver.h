@@ -0,0 +1,173 @@
+/* reachability_solver.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "path.h"
+#include "path_solver.h"
+
+/**
+ * @Brief  A charging station that can be reached within the time budget
+ */
+struct ReachableCharger {
+  /**
+   * @Brief  The name of the charging station
+   */
+  std::string name;
+
+  /**
+   * @Brief  Earliest arrival time from the start charger
+   */
+  double arrival_time;  // hr
+
+  /**
+   * @Brief  Remaining charge when arriving at the charging station
+   */
+  double arrival_charge;  // km
+
+  /**
+   * @Brief  The charging stations of the fastest path
+   *         from the start charger
+   */
+  std::vector<std::string> chargers;
+};
+
+/**
+ * @Brief  A class for finding every charging station reachable
+ *         from a start charger within a time budget
+ *
+ *         The search is a Dijkstra-like expansion ordered by the
+ *         time cost of Path, so driving and charging follow the same
+ *         rules as PathSolver. The search stops as soon as the cheapest
+ *         path in the queue exceeds the time budget.
+ *
+ *         The charging plan of a Path is optimized over the whole path,
+ *         so a slower path to a charging station can still lead to an
+ *         earlier arrival further on, when it passes a faster charger
+ *         the car can charge more at. Every charging station therefore
+ *         keeps every path that is not dominated, that is no other path
+ *         can leave the station with any charge earlier. The first path
+ *         settled at a station has its earliest arrival. Paths are
+ *         compared without their visited stations, and with charging
+ *         curves only at the planning levels of ChildCostBase.
+ */
+class ReachabilitySolver {
+ public:
+   /**
+    * @Brief  Constructor
+    *
+    * @Param start_charger The name of the initial charging station
+    * @Param time_budget The maximum driving and charging time in hours
+    * @Param vehicle The battery and speed setting of the car
+    */
+  ReachabilitySolver(const std::string& start_charger,
+                     double time_budget,
+                     const VehicleProfile& vehicle = VehicleProfile());
+
+  /**
+   * @Brief  Search for every reachable charging station and report
+   *         each one as soon as its earliest arrival is known
+   *
+   *         Charging stations are reported in order of arrival time
+   *
+   * @Param on_reached Callback for each reachable charging station
+   */
+  void solve(const std::function<void(const ReachableCharger&)>& on_reached);
+
+  /**
+   * @Brief  Search for every reachable charging station
+   *
+   * @Returns  Reachable charging stations in order of arrival time
+   */
+  std::vector<ReachableCharger> solve();
+
+  /**
+   * @Brief  Search until every target charging station is reached
+   *
+   *         One search from the start charger answers many targets,
+   *         and it stops as soon as the last target is reached
+   *
+   * @Param targets The names of the target charging stations
+   *
+   * @Returns  Reached targets in order of arrival time
+   */
+  std::vector<ReachableCharger> solve_targets(
+    const std::vector<std::string>& targets);
+
+ private:
+  /**
+   * @Brief  Settle charging stations in order of arrival time
+   *
+   * @Param on_reached Callback for each reachable charging station,
+   *                   the search stops when it returns false
+   */
+  void search(const std::function<bool(const ReachableCharger&)>& on_reached);
+
+  /**
+   * @Brief  Queue a path unless another path to its charging station
+   *         dominates it, and drop the paths it dominates
+   *
+   * @Param path_ptr The path to queue
+   * @Param cost The time cost of the path in hours
+   */
+  void push_label(const std::shared_ptr<Path>& path_ptr, double cost);
+
+  /**
+   * @Brief  A path to a charging station with its cost of leaving
+   *         the station with any charge
+   */
+  struct Label {
+    std::shared_ptr<Path> path;
+    ChildCostBase base;
+    bool dominated;
+  };
+
+  /**
+   * @Brief  Every queued path
+   */
+  std::vector<Label> labels_;
+
+  /**
+   * @Brief  A priority queue that contains labels to be settled
+   *
+   *         The priority is based on the time cost of the path
+   */
+  std::priority_queue<std::pair<double, int>> label_queue_;
+
+  /**
+   * @Brief  The initial charging station
+   */
+  std::string start_charger_;
+
+  /**
+   * @Brief  The maximum driving and charging time
+   */
+  double time_budget_;  // hr
+
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle_;
+
+  /**
+   * @Brief  The labels of each charging station that are not dominated
+   */
+  std::unordered_map<std::string, std::vector<int>> charger_labels_;
+
+  /**
+   * @Brief  Charging stations whose earliest arrival
+   *         has been reported
+   */
+  std::unordered_set<std::string> settled_;
+};
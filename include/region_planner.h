@@ -0,0 +1,242 @@
+/* region_planner.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <sys/types.h>
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "path.h"
+#include "route_result.h"
+#include "utility.h"
+
+/**
+ * @Brief  Tunable parameters for region planning
+ */
+namespace regionParam {
+  /**
+   * @Brief  Stations closer than this to the edge of a region
+   *         can be boundary stations
+   */
+  constexpr double BOUNDARY_WIDTH = 150;  // km
+
+  /**
+   * @Brief  Maximum boundary stations on each side of a region
+   *
+   *         Stations are picked evenly along the edge
+   */
+  constexpr int MAX_BOUNDARY_STATIONS = 8;
+}  // namespace regionParam
+
+/**
+ * @Brief  A route segment between two stations
+ *         as stations in order and its time cost
+ */
+struct RouteSegment {
+  std::vector<std::string> chargers;
+  double cost;  // hr
+};
+
+/**
+ * @Brief  A region of the network with its boundary stations
+ */
+struct Region {
+  /**
+   * @Brief  Names of the stations in the region
+   */
+  std::vector<std::string> chargers;
+
+  /**
+   * @Brief  Stations that connect to the neighboring regions
+   */
+  std::vector<std::string> boundary_chargers;
+
+  /**
+   * @Brief  Western and eastern edge of the region
+   */
+  double min_lon;
+  double max_lon;
+};
+
+/**
+ * @Brief  The stations and memory of a region worker
+ */
+struct RegionWorkerStats {
+  /**
+   * @Brief  Stations loaded by the worker
+   */
+  int num_of_chargers;
+
+  /**
+   * @Brief  Resident memory of the worker not shared with the coordinator
+   */
+  size_t private_memory;  // bytes
+};
+
+/**
+ * @Brief  Split the stations into bands of longitude
+ *         with the same number of stations
+ *
+ * @Param num_of_regions The number of bands
+ *
+ * @Returns  The regions from west to east
+ */
+std::vector<Region> partition_regions(int num_of_regions);
+
+/**
+ * @Brief  A planner that splits the network into regions
+ *         served by one worker process each
+ *
+ *         A worker loads only the stations of its region, with its
+ *         boundary stations, from a shard of network lines, and answers
+ *         route requests with ReachabilitySolver, which expands Path like
+ *         PathSolver but drops every path another path to the same station
+ *         dominates, so a search in a narrow region never runs away. It
+ *         also precomputes the routes between its boundary stations.
+ *         The coordinator stitches a
+ *         cross-region query over the boundary stations with Dijkstra,
+ *         then the whole route is evaluated again with Path.
+ *
+ *         Workers talk to the coordinator with text lines over pipes,
+ *         so local processes stand in for remote workers.
+ */
+class RegionPlanner {
+ public:
+   /**
+    * @Brief  Constructor, starts one worker process for every region
+    *
+    * @Param num_of_regions The number of regions
+    * @Param vehicle The battery and speed setting of the car
+    */
+  RegionPlanner(int num_of_regions,
+                const VehicleProfile& vehicle = VehicleProfile());
+
+  /**
+   * @Brief  Destructor, stops the worker processes
+   */
+  ~RegionPlanner();
+
+  RegionPlanner(const RegionPlanner&) = delete;
+  RegionPlanner& operator=(const RegionPlanner&) = delete;
+
+  /**
+   * @Brief  Search for a route between any two stations
+   *
+   * @Param start_charger The name of the initial charging station
+   * @Param goal_charger The name of the goal charging station
+   *
+   * @Returns  The route with the status of the search
+   */
+  RouteResult solve_route(const std::string& start_charger,
+                          const std::string& goal_charger);
+
+  /**
+   * @Brief  Search for a route between any two stations
+   *
+   * @Returns  The route in the answer string format
+   */
+  std::string solve(const std::string& start_charger,
+                    const std::string& goal_charger);
+
+  /**
+   * @Brief  Get the regions of the planner
+   *
+   * @Returns  The regions from west to east
+   */
+  const std::vector<Region>& regions() const;
+
+  /**
+   * @Brief  Get the stations and memory of every worker
+   *
+   * @Returns  The stats of the workers from west to east
+   */
+  std::vector<RegionWorkerStats> worker_stats();
+
+ private:
+  /**
+   * @Brief  The pipes and process of a worker
+   */
+  struct Worker {
+    pid_t pid;
+    FILE* request;
+    FILE* reply;
+  };
+
+  /**
+   * @Brief  Serve route requests of one region until asked to quit
+   *
+   * @Param region The region of the worker
+   * @Param shard The stations of the region as network lines
+   * @Param request Requests from the coordinator
+   * @Param reply Replies to the coordinator
+   */
+  void run_worker(const Region& region, const std::string& shard,
+                  FILE* request, FILE* reply);
+
+  /**
+   * @Brief  Stop the started worker processes and wait for them to exit
+   */
+  void stop_workers();
+
+  /**
+   * @Brief  Get the region of a station
+   *
+   *         Throws std::invalid_argument if the station is unknown
+   *
+   * @Param name The name of the charging station
+   *
+   * @Returns  The index of the region
+   */
+  int region_id(const std::string& name) const;
+
+  /**
+   * @Brief  Ask a worker for the route between two stations
+   *         of its region
+   *
+   *         Requests are answered in order, so requests to different
+   *         workers are sent before reading replies to run in parallel
+   *
+   * @Param region_id The region of both stations
+   * @Param start_charger The name of the initial charging station
+   * @Param goal_charger The name of the goal charging station
+   * @Param init_charge Charge when leaving the start station in km
+   */
+  void send_route_request(int region_id,
+                          const std::string& start_charger,
+                          const std::string& goal_charger,
+                          double init_charge);
+
+  /**
+   * @Brief  The regions from west to east
+   */
+  std::vector<Region> regions_;
+
+  /**
+   * @Brief  The worker of each region
+   */
+  std::vector<Worker> workers_;
+
+  /**
+   * @Brief  Region of every station
+   */
+  std::unordered_map<std::string, int> region_ids_;
+
+  /**
+   * @Brief  Routes between boundary stations, within regions from
+   *         the workers and across regions computed directly
+   *
+   *         Leaving a boundary station the car has no charge left
+   */
+  std::unordered_map<std::string, std::vector<RouteSegment>> boundary_routes_;
+
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle_;
+};
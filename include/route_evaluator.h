@@ -0,0 +1,64 @@
+/* route_evaluator.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+#include "utility.h"
+
+/**
+ * @Brief  Tunable parameters for route evaluation
+ */
+namespace evaluatorParam {
+  /**
+   * @Brief  Tolerance on the remaining charge
+   *
+   *         Charge times are rounded to 1e-5 hour in the
+   *         answer string, which is off by a few meters
+   */
+  constexpr double CHARGE_TOLERANCE = 1e-2;  // km
+}  // namespace evaluatorParam
+
+/**
+ * @Brief  Result of checking a route in the answer string format
+ */
+struct RouteEvaluation {
+  /**
+   * @Brief  True if the car never runs out of charge
+   */
+  bool valid = false;
+
+  /**
+   * @Brief  Total driving and charging time
+   */
+  double cost = 0.0;  // hr
+
+  /**
+   * @Brief  The charging stations of the route
+   */
+  std::vector<std::string> chargers;
+
+  /**
+   * @Brief  The reason the route is not valid
+   */
+  std::string error;
+};
+
+namespace evaluator {
+  /**
+   * @Brief  Check a route in the answer string format in process,
+   *         following the rules of the checker program
+   *
+   * @Param solution The answer string
+   * @Param vehicle The battery and speed setting of the car
+   *
+   * @Returns  The validity and total time of the route
+   */
+  RouteEvaluation evaluate_route(
+      const std::string& solution,
+      const VehicleProfile& vehicle = VehicleProfile());
+}  // namespace evaluator
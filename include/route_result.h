@@ -0,0 +1,94 @@
+/* route_result.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @Brief  How the search for a route ended
+ */
+enum class RouteStatus {
+  /**
+   * @Brief  The route is the best of the compared candidates
+   */
+  SUCCESS,
+
+  /**
+   * @Brief  The search stopped at the reset limit, so the route
+   *         is valid but fewer candidates were compared
+   */
+  RESET_LIMIT,
+
+  /**
+   * @Brief  No route reaches the goal
+   */
+  NO_ROUTE
+};
+
+/**
+ * @Brief  A route with its charging plan in a structured form
+ *
+ *         charger_ids and charge_times share the same index,
+ *         and leg_dists[i] is the distance between
+ *         charger_ids[i] and charger_ids[i+1]
+ */
+struct RouteResult {
+  /**
+   * @Brief  How the search ended
+   */
+  RouteStatus status = RouteStatus::NO_ROUTE;
+
+  /**
+   * @Brief  The database ids of the charging stations in order
+   */
+  std::vector<int> charger_ids;
+
+  /**
+   * @Brief  Charging time at each charging station
+   *
+   *         The goal always has no charging time
+   */
+  std::vector<double> charge_times;  // hr
+
+  /**
+   * @Brief  Distance of each leg between charging stations
+   */
+  std::vector<double> leg_dists;  // km
+
+  /**
+   * @Brief  Total driving and charging time
+   */
+  double cost = 0.0;  // hr
+};
+
+namespace route {
+  /**
+   * @Brief  Write a route in the answer string format into a buffer
+   *         without any allocation
+   *
+   *         Like snprintf, the output is cut to fit the buffer and
+   *         always ends with a null character if size is not 0
+   *
+   * @Param result The route to write
+   * @Param buffer The buffer supplied by the caller
+   * @Param size The size of the buffer in bytes
+   *
+   * @Returns  The length of the full answer string without the
+   *           null character
+   */
+  size_t format(const RouteResult& result, char* buffer, size_t size);
+
+  /**
+   * @Brief  Convert a route into the answer string format
+   *
+   * @Param result The route to convert
+   *
+   * @Returns  The answer string, empty if there is no route
+   */
+  std::string to_string(const RouteResult& result);
+}  // namespace route
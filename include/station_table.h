@@ -0,0 +1,134 @@
+/* station_table.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * @Brief  The built-in charging stations in a table generated
+ *         at build time from src/network.cpp
+ *
+ *         The names and numbers are literals and the lookup is a minimal
+ *         perfect hash, so the table costs nothing at static
+ *         initialization and a lookup never allocates. The library builds
+ *         the built-in network from the table, and src/network.cpp is
+ *         only linked by the tools that read its rows. The hash of a name
+ *         picks a bucket, and mixed with the seed stored for the bucket
+ *         it picks the slot of the name, so every name is found with
+ *         one pass over its characters and one comparison.
+ */
+namespace station_table {
+  /**
+   * @Brief  Hash a name
+   *
+   *         Eight characters at a time, shared with the generator,
+   *         which picks the seeds of the buckets. The characters are
+   *         read in the byte order of the machine, so the table is
+   *         generated for the machine that builds it.
+   *
+   * @Param name The characters of the name
+   * @Param length The number of characters
+   *
+   * @Returns  The 64-bit hash, its high half picks the bucket
+   */
+  inline uint64_t hash(const char* name, size_t length) {
+    uint64_t value = 14695981039346656037ull ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+      uint64_t word;
+      std::memcpy(&word, name + i, 8);
+      value = (value ^ word) * 0x9e3779b97f4a7c15ull;
+      value ^= value >> 29;
+    }
+
+    uint64_t tail = 0;
+    for (int shift=0; i < length; ++i, shift += 8) {
+      tail |= static_cast<uint64_t>(static_cast<unsigned char>(name[i]))
+        << shift;
+    }
+    value = (value ^ tail) * 0x9e3779b97f4a7c15ull;
+    return value ^ (value >> 29);
+  }
+
+  /**
+   * @Brief  Mix the hash of a name with the seed of its bucket
+   *
+   *         The murmur finalizer, so that every seed moves
+   *         the names of a bucket to unrelated slots
+   *
+   * @Param value The hash of the name
+   * @Param seed The seed of the bucket
+   *
+   * @Returns  The hash that picks the slot
+   */
+  inline uint32_t displace(uint64_t value, uint32_t seed) {
+    value ^= seed * 0x9e3779b97f4a7c15ull;
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return static_cast<uint32_t>(value);
+  }
+
+  /**
+   * @Brief  Get the id of a built-in charging station
+   *
+   * @Param name The characters of the name
+   * @Param length The number of characters
+   *
+   * @Returns  The index of the station in the built-in network,
+   *           -1 if there is no station of the name
+   */
+  int find(const char* name, size_t length);
+
+  /**
+   * @Brief  Get the id of a built-in charging station
+   *
+   * @Returns  The index of the station in the built-in network,
+   *           -1 if there is no station of the name
+   */
+  int find(const std::string& name);
+
+  /**
+   * @Brief  Get the name of a built-in charging station
+   *
+   * @Param id The index of the station in the built-in network
+   *
+   * @Returns  The name as a string literal, nullptr for a bad id
+   */
+  const char* name(int id);
+
+  /**
+   * @Brief  A built-in charging station with the numbers
+   *         of src/network.cpp
+   */
+  struct Station {
+    const char* name;
+    double lat;
+    double lon;
+    double rate;  // km/hr
+  };
+
+  /**
+   * @Brief  Get a built-in charging station
+   *
+   *         Throws std::invalid_argument for a bad id
+   *
+   * @Param id The index of the station in the built-in network
+   *
+   * @Returns  The station from the literals of the table
+   */
+  Station station(int id);
+
+  /**
+   * @Brief  Get the number of built-in charging stations
+   */
+  int size();
+}  // namespace station_table
@@ -0,0 +1,84 @@
+/* time_profile.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <vector>
+
+/**
+ * @Brief  A periodic piecewise-linear function over a day
+ *
+ *         Values are stored at evenly spaced times of the day,
+ *         so evaluating the function at any time is O(1)
+ */
+class TimeProfile {
+ public:
+  /**
+   * @Brief  Constructor
+   *
+   * @Param values The values at evenly spaced times starting at
+   *               midnight (One value for a constant profile)
+   */
+  explicit TimeProfile(const std::vector<double>& values);
+
+  /**
+   * @Brief  Evaluate the profile
+   *
+   * @Param time The time in hours (Any time, wrapped into a day)
+   *
+   * @Returns  The linearly interpolated value
+   */
+  double value(double time) const;
+
+  /**
+   * @Brief  Whether the profile keeps first-in-first-out order
+   *         when used as a wait time
+   *
+   *         Arriving later never leaves earlier, which holds when
+   *         the wait time never drops faster than time passes
+   *
+   * @Returns  True if every slope is at least -1
+   */
+  bool is_fifo() const;
+
+  /**
+   * @Brief  Lowest value of the profile
+   *
+   *         Values are linear between the evenly spaced times,
+   *         so the lowest value is one of them
+   */
+  double min_value() const;
+
+  /**
+   * @Brief  Highest value of the profile
+   */
+  double max_value() const;
+
+ private:
+  /**
+   * @Brief  The values at evenly spaced times of the day
+   */
+  std::vector<float> values_;
+
+  /**
+   * @Brief  The time between two values
+   */
+  double step_;  // hr
+};
+
+/**
+ * @Brief  Time-dependent charging setting of a charging station
+ */
+struct StationTimeProfile {
+  /**
+   * @Brief  Charge rate over the day
+   */
+  TimeProfile rate;  // km/hr
+
+  /**
+   * @Brief  Queue wait time before charging over the day
+   */
+  TimeProfile wait;  // hr
+};
@@ -0,0 +1,152 @@
+/* trace.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @Brief  Record a search event when built with SEARCH_TRACE
+ *
+ *         Without SEARCH_TRACE the arguments are not evaluated,
+ *         so tracing costs nothing
+ */
+#ifdef SEARCH_TRACE
+#define TRACE_SEARCH(kind, charger_id, goal_weight, queue_size) \
+  trace::record(kind, charger_id, goal_weight, queue_size)
+#else
+#define TRACE_SEARCH(kind, charger_id, goal_weight, queue_size)
+#endif
+
+/**
+ * @Brief  Tunable parameters for search tracing
+ */
+namespace traceParam {
+  /**
+   * @Brief  Default number of events kept by the ring buffer
+   *
+   *         Older events are overwritten when the buffer is full
+   */
+  constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+}  // namespace traceParam
+
+/**
+ * @Brief  The kind of a search event
+ */
+enum class TraceKind {
+  /**
+   * @Brief  A path was popped and its children were pushed
+   */
+  EXPAND,
+
+  /**
+   * @Brief  The queue was reset with a larger goal weight
+   */
+  RESET,
+
+  /**
+   * @Brief  A path reached the goal
+   */
+  CANDIDATE
+};
+
+/**
+ * @Brief  One event of the search
+ */
+struct TraceEvent {
+  /**
+   * @Brief  Time since tracing started
+   */
+  double timestamp;  // us
+
+  /**
+   * @Brief  Database id of the current charger of the path
+   */
+  int charger_id;
+
+  /**
+   * @Brief  The kind of the event
+   */
+  TraceKind kind;
+
+  /**
+   * @Brief  The goal weight of the search at the event
+   */
+  double goal_weight;
+
+  /**
+   * @Brief  Number of paths in the queue at the event
+   */
+  size_t queue_size;
+};
+
+namespace trace {
+  /**
+   * @Brief  Start recording events of the current thread
+   *
+   *         The ring buffer is allocated here,
+   *         so recording never allocates
+   *
+   * @Param capacity The number of events kept
+   */
+  void start(size_t capacity = traceParam::DEFAULT_CAPACITY);
+
+  /**
+   * @Brief  Stop recording events of the current thread
+   *
+   *         Recorded events are kept until the next start
+   */
+  void stop();
+
+  /**
+   * @Brief  Whether the current thread is recording
+   */
+  bool enabled();
+
+  /**
+   * @Brief  Record an event of the current thread if recording
+   *
+   *         Every thread has its own ring buffer,
+   *         so recording needs no lock
+   *
+   * @Param kind The kind of the event
+   * @Param charger_id Database id of the current charger
+   * @Param goal_weight The goal weight of the search
+   * @Param queue_size Number of paths in the queue
+   */
+  void record(TraceKind kind, int charger_id,
+              double goal_weight, size_t queue_size);
+
+  /**
+   * @Brief  Get the recorded events of the current thread
+   *
+   * @Returns  Events from the oldest to the latest
+   */
+  std::vector<TraceEvent> events();
+
+  /**
+   * @Brief  Convert events into Chrome trace event JSON
+   *
+   *         Every event is an instant event, and the goal weight and
+   *         the queue size are counter tracks
+   *
+   * @Param events The recorded events
+   *
+   * @Returns  JSON for chrome://tracing or Perfetto
+   */
+  std::string to_chrome_json(const std::vector<TraceEvent>& events);
+
+  /**
+   * @Brief  Convert events into a GeoJSON heat layer with
+   *         the number of expansions at each charging station
+   *
+   * @Param events The recorded events
+   *
+   * @Returns  A GeoJSON feature collection of points
+   */
+  std::string to_geojson(const std::vector<TraceEvent>& events);
+}  // namespace trace
@@ -0,0 +1,162 @@
+/* trip_planner.h
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+
+#include "path.h"
+#include "route_result.h"
+#include "utility.h"
+
+/**
+ * @Brief  Tunable parameters for trip planning
+ */
+namespace tripParam {
+  /**
+   * @Brief  Most waypoints whose visit order is chosen exactly
+   *
+   *         The exact order takes O(2^n n^2) time and O(2^n n) memory,
+   *         more waypoints are ordered by nearest neighbor and 2-opt
+   */
+  constexpr int MAX_EXACT_WAYPOINTS = 12;
+}  // namespace tripParam
+
+/**
+ * @Brief  A planner for a trip from a start charger through several
+ *         waypoints in any order to a goal charger
+ *
+ *         The time of the fastest leg between every two stops is found
+ *         once, with one one-to-many search by ReachabilitySolver from
+ *         every stop, and the searches run on parallel threads. The visit
+ *         order with the shortest total leg time is found by Held-Karp
+ *         dynamic programming for up to MAX_EXACT_WAYPOINTS waypoints,
+ *         and by nearest neighbor improved with 2-opt for more. The legs
+ *         are then joined into one Path, so the charging plan of the whole
+ *         trip is optimized again and charge is carried across the legs.
+ */
+class TripPlanner {
+ public:
+   /**
+    * @Brief  Constructor
+    *
+    * @Param start_charger The name of the initial charging station
+    * @Param waypoints The names of the charging stations to visit
+    *                  in any order
+    * @Param goal_charger The name of the goal charging station
+    * @Param vehicle The battery and speed setting of the car
+    * @Param num_of_threads The number of search threads,
+    *                       0 uses every hardware thread
+    */
+  TripPlanner(const std::string& start_charger,
+              const std::vector<std::string>& waypoints,
+              const std::string& goal_charger,
+              const VehicleProfile& vehicle = VehicleProfile(),
+              int num_of_threads = 0);
+
+  /**
+   * @Brief  Search for the fastest trip through every waypoint
+   *
+   * @Returns  The trip as one route with the status of the search
+   */
+  RouteResult solve_route();
+
+  /**
+   * @Brief  Search for the fastest trip through every waypoint
+   *
+   * @Returns  The trip in the answer string format
+   */
+  std::string solve();
+
+  /**
+   * @Brief  Get the waypoints in the order of the last solved trip
+   *
+   * @Returns  The names of the waypoints in visit order
+   */
+  const std::vector<std::string>& visit_order() const;
+
+  /**
+   * @Brief  Get the time of the fastest leg between two stops
+   *
+   *         Stop 0 is the start charger, stops 1 to n are the
+   *         waypoints and stop n + 1 is the goal charger
+   *
+   * @Param from The stop the leg leaves
+   * @Param to The stop the leg arrives at
+   *
+   * @Returns  The time of the leg in hours,
+   *           infinity if no leg connects the stops
+   */
+  double leg_time(int from, int to);
+
+ private:
+  /**
+   * @Brief  Search the legs from every stop to every other stop
+   *         on parallel threads
+   */
+  void search_legs();
+
+  /**
+   * @Brief  Search the legs from one stop to every other stop
+   *
+   * @Param from The stop the legs leave
+   */
+  void search_legs_from(int from);
+
+  /**
+   * @Brief  Total leg time of visiting the waypoints in an order
+   *
+   * @Param order The stops of the waypoints in visit order
+   *
+   * @Returns  The total time in hours from start to goal
+   */
+  double order_time(const std::vector<int>& order) const;
+
+  /**
+   * @Brief  The fastest visit order by Held-Karp dynamic programming
+   *
+   * @Returns  The stops of the waypoints in visit order
+   */
+  std::vector<int> exact_order() const;
+
+  /**
+   * @Brief  A fast visit order by nearest neighbor improved with 2-opt
+   *
+   * @Returns  The stops of the waypoints in visit order
+   */
+  std::vector<int> heuristic_order() const;
+
+  /**
+   * @Brief  The names of the start charger, the waypoints
+   *         and the goal charger
+   */
+  std::vector<std::string> stops_;
+
+  /**
+   * @Brief  The battery and speed setting of the car
+   */
+  VehicleProfile vehicle_;
+
+  /**
+   * @Brief  The number of search threads
+   */
+  int num_of_threads_;
+
+  /**
+   * @Brief  Time of the fastest leg between every two stops
+   */
+  std::vector<std::vector<double>> leg_times_;  // hr
+
+  /**
+   * @Brief  Charging stations of the fastest leg between every two stops
+   */
+  std::vector<std::vector<std::vector<std::string>>> leg_chargers_;
+
+  /**
+   * @Brief  The waypoints in the order of the last solved trip
+   */
+  std::vector<std::string> visit_order_;
+};
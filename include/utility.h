@@ -5,12 +5,16 @@
  */
 
 #pragma once
+#include <istream>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "charging_curve.h"
 #include "network.h"
+#include "time_profile.h"
 
 /**
  * @Brief  Constant setting for the challenge
@@ -43,8 +47,87 @@ namespace constant {
    */
   constexpr double SPEED = 105;  // km/hr
 
+  /**
+   * @Brief  Length of a day for time-dependent charging
+   */
+  constexpr double DAY_LENGTH = 24;  // hr
+
 }  // namespace constant
 
+/**
+ * @Brief  Battery and speed setting of a vehicle
+ *
+ *         The default profile is the challenge setting
+ *         from the constant namespace
+ */
+struct VehicleProfile {
+  /**
+   * @Brief  Constructor for the default vehicle
+   */
+  constexpr VehicleProfile():
+    full_charge{constant::FULL_CHARGE},
+    init_charge{constant::INIT_CHARGE},
+    speed{constant::SPEED} {}
+
+  /**
+   * @Brief  Constructor for a vehicle starting with full charge
+   *
+   * @Param full_charge Max distance the car can go when in full charge
+   * @Param speed Constant velocity of the car
+   */
+  constexpr VehicleProfile(double full_charge, double speed):
+    full_charge{full_charge},
+    init_charge{full_charge},
+    speed{speed} {}
+
+  /**
+   * @Brief  Constructor
+   *
+   * @Param full_charge Max distance the car can go when in full charge
+   * @Param speed Constant velocity of the car
+   * @Param init_charge Charge at start charger
+   */
+  constexpr VehicleProfile(double full_charge, double speed,
+                           double init_charge):
+    full_charge{full_charge},
+    init_charge{init_charge},
+    speed{speed} {}
+
+  /**
+   * @Brief  Max distance the car can go when in full charge
+   */
+  double full_charge;  // km
+
+  /**
+   * @Brief  Initial charge at start charger
+   */
+  double init_charge;  // km
+
+  /**
+   * @Brief  Constant velocity of the car
+   */
+  double speed;  // km/hr
+};
+
+/**
+ * @Brief  Neighbors of a charging station as parallel arrays
+ *
+ *         ids[i] is the id of a neighbor, and dists[i]
+ *         is the distance to it
+ */
+struct NeighborTable {
+  std::vector<int> ids;
+  std::vector<double> dists;  // km
+};
+
+/**
+ * @Brief  The charging station database
+ *
+ *         Lookups and the lazily cached neighbor tables are safe
+ *         for searches running in parallel threads. Loading a network
+ *         or changing a charging station must not run at the same
+ *         time as a search.
+ */
 namespace database {
   /**
    * @Brief  Get the charging station info by name
@@ -53,17 +136,221 @@ namespace database {
    *
    * @Returns  The complete info of a charging station
    */
-  row get_charger_record(std::string& name);
+  row get_charger_record(const std::string& name);
+
+  /**
+   * @Brief  Get the charging station info by id
+   *
+   * @Param id The id of the charging station
+   *
+   * @Returns  The complete info of a charging station
+   */
+  const row& get_charger_record(int id);
+
+  /**
+   * @Brief  Get the id of a charging station
+   *
+   *         Ids are consecutive from 0 in the order of the network
+   *
+   * @Param name The name of the charging station
+   *
+   * @Returns  The id of the charging station
+   */
+  int get_charger_id(const std::string& name);
+
+  /**
+   * @Brief  Get the number of charging stations
+   *
+   * @Returns  The number of charging stations
+   */
+  int num_of_chargers();
+
+  /**
+   * @Brief  Replace the charging stations with a network file
+   *
+   *         Every line of the file is a charging station as
+   *         "name lat lon rate", and lines starting with # are skipped.
+   *         Cached tables, availability, time profiles and the
+   *         state version are reset, so solvers created before
+   *         have to be created again.
+   *
+   * @Param file_name The path of the network file
+   */
+  void load_network(const std::string& file_name);
+
+  /**
+   * @Brief  Replace the charging stations with network lines
+   *         from a stream, like load_network of a file
+   *
+   * @Param network_stream The lines of a network file
+   */
+  void load_network(std::istream& network_stream);
+
+  /**
+   * @Brief  Go back to the built-in network
+   *
+   *         Resets the same state as load_network
+   */
+  void reset_network();
+
+  /**
+   * @Brief  Get neighbors within maximum distance of a charging station
+   *         together with their distances
+   *
+   *         Tables are cached separately for every range, and stay
+   *         valid until a charging station within range changes availability
+   *
+   * @Param id The id of the charging station
+   * @Param range The maximum distance to a neighbor (Default: FULL_CHARGE)
+   *
+   * @Returns  The ids and distances of all neighbors within range
+   */
+  const NeighborTable& get_neighbor_table(
+      int id, double range = constant::FULL_CHARGE);
 
   /**
    * @Brief  Get neighbors within maximum distance 
    *         of a charging station
    *
+   *         Neighbors are cached separately for every range
+   *
    * @Param name The name of the charging station
+   * @Param range The maximum distance to a neighbor (Default: FULL_CHARGE)
    *
    * @Returns  All neighbors statino within maximum range
    */
-  std::vector<std::string> get_neighbors(std::string& name);
+  std::vector<std::string> get_neighbors(
+      std::string& name, double range = constant::FULL_CHARGE);
+
+  /**
+   * @Brief  Mark a charging station as available or out of service
+   *
+   *         Out of service charging stations are not neighbors of
+   *         any charging station. Only the cached neighbor lists
+   *         within range of the charging station are invalidated.
+   *
+   * @Param name The name of the charging station
+   * @Param available False if the charging station is out of service
+   */
+  void set_charger_available(const std::string& name, bool available);
+
+  /**
+   * @Brief  Whether a charging station is in service
+   *
+   * @Param name The name of the charging station
+   *
+   * @Returns  False if the charging station is out of service
+   */
+  bool charger_available(const std::string& name);
+
+  /**
+   * @Brief  Change the charge rate of a charging station
+   *
+   * @Param name The name of the charging station
+   * @Param rate The new charge rate in km/hr
+   */
+  void set_charge_rate(const std::string& name, double rate);
+
+  /**
+   * @Brief  Version of the charging station state
+   *
+   *         The version increases for every availability
+   *         or charge rate change
+   *
+   * @Returns  The current state version
+   */
+  unsigned long state_version();
+
+  /**
+   * @Brief  Get the charging stations changed after a state version
+   *
+   * @Param since_version The state version to compare with
+   *
+   * @Returns  The names of the changed charging stations
+   */
+  std::set<std::string> changed_chargers(unsigned long since_version);
+
+  /**
+   * @Brief  Set the time-dependent charge rate and wait time
+   *         of a charging station
+   *
+   *         Throws std::invalid_argument if a charge rate is not
+   *         positive, a wait time is negative or the wait time
+   *         breaks FIFO order
+   *
+   * @Param name The name of the charging station
+   * @Param profile The charge rate and wait time over the day
+   */
+  void set_time_profile(const std::string& name,
+                        const StationTimeProfile& profile);
+
+  /**
+   * @Brief  Get the time-dependent setting of a charging station
+   *
+   * @Param name The name of the charging station
+   *
+   * @Returns  The time profile, or nullptr if the charging station
+   *           has a constant charge rate and no wait time
+   */
+  const StationTimeProfile* get_time_profile(const std::string& name);
+
+  /**
+   * @Brief  Go back to the constant charge rate and no wait time
+   *
+   * @Param name The name of the charging station
+   */
+  void clear_time_profile(const std::string& name);
+
+  /**
+   * @Brief  Load time profiles from a file
+   *
+   *         Every line is a charging station name, the kind of
+   *         profile (rate or wait) and values evenly spaced over the day.
+   *         A station with only one kind keeps the other constant.
+   *
+   * @Param file_name The profile file
+   */
+  void load_time_profiles(const std::string& file_name);
+
+  /**
+   * @Brief  Set the charging curve of a charging station
+   *
+   * @Param name The name of the charging station,
+   *             or * for every station without a curve of its own
+   * @Param curve The charging power over the state of charge
+   */
+  void set_charging_curve(const std::string& name,
+                          const ChargingCurve& curve);
+
+  /**
+   * @Brief  Get the charging curve of a charging station
+   *
+   * @Param name The name of the charging station
+   *
+   * @Returns  The curve of the station, or the curve of every station,
+   *           or nullptr if the station charges at a constant rate
+   */
+  std::shared_ptr<const ChargingCurve> get_charging_curve(
+      const std::string& name);
+
+  /**
+   * @Brief  Go back to charging at a constant rate
+   *
+   * @Param name The name of the charging station, or *
+   */
+  void clear_charging_curve(const std::string& name);
+
+  /**
+   * @Brief  Load charging curves from a file
+   *
+   *         Every line is a charging station name, or * for every
+   *         station, and pairs of a state of charge and the power at it
+   *         as a fraction of the charge rate. Lines starting with #
+   *         are skipped.
+   *
+   * @Param file_name The curve file
+   */
+  void load_charging_curves(const std::string& file_name);
 }  // namespace database
 
 namespace utility {
@@ -94,6 +381,16 @@ namespace utility {
   double calc_great_distance(row charger1, row charger2);
   double calc_great_distance(std::string& charger1, std::string& charger2);
   double calc_great_distance(std::string&& charger1, std::string&& charger2);
+
+  /**
+   * @Brief  Get a percentile of sorted values by the nearest rank
+   *
+   * @Param sorted_values The values in ascending order
+   * @Param p The percentile between 0 and 1
+   *
+   * @Returns  The value at the percentile, 0 if there is no value
+   */
+  double percentile(const std::vector<double>& sorted_values, double p);
 }  // namespace utility
 
 // make_unique for C++11
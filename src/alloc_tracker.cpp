@@ -0,0 +1,231 @@
+/* alloc_tracker.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+#include "alloc_tracker.h"
+
+namespace {
+  /**
+   * @Brief  Allocation counters of a thread
+   *
+   *         Only the thread updates its counters, except the live bytes,
+   *         which other threads lower when they free its blocks
+   */
+  struct ThreadCounters {
+    size_t allocations = 0;
+    size_t bytes = 0;
+    std::atomic<long long> live_bytes{0};
+    long long peak_bytes = 0;
+    long long alloc_time = 0;  // ns
+  };
+
+  /**
+   * @Brief  The counters of the current thread, made on first use
+   */
+  thread_local ThreadCounters* thread_counters = nullptr;
+
+  /**
+   * @Brief  Get the counters of the current thread
+   *
+   *         The counters are made with malloc and never freed, so a block
+   *         freed after its thread exited still finds the counters
+   */
+  ThreadCounters& get_thread_counters() {
+    if (thread_counters == nullptr) {
+      void* memory = std::malloc(sizeof(ThreadCounters));
+      if (memory == nullptr) {
+        std::abort();
+      }
+      thread_counters = new (memory) ThreadCounters();
+    }
+    return *thread_counters;
+  }
+}  // namespace
+
+#ifdef ALLOC_TRACKING
+namespace {
+  /**
+   * @Brief  Header in front of every tracked block
+   *
+   *         Records the thread that allocated the block, so a free on any
+   *         thread lowers the live bytes of the allocating thread
+   */
+  struct BlockHeader {
+    ThreadCounters* owner;
+    size_t size;
+  };
+
+  /**
+   * @Brief  Size of the header, rounded up to keep blocks aligned
+   */
+  constexpr size_t HEADER_SIZE =
+    (sizeof(BlockHeader) + alignof(std::max_align_t) - 1) /
+    alignof(std::max_align_t) * alignof(std::max_align_t);
+}  // namespace
+
+/**
+ * @Brief  Allocate with malloc and count the requested size of the block
+ */
+static void* tracked_malloc(size_t size) {
+  auto start_time = std::chrono::steady_clock::now();
+  void* ptr = nullptr;
+  while ((ptr = std::malloc(HEADER_SIZE + size)) == nullptr) {
+    auto handler = std::get_new_handler();
+    if (handler == nullptr) {
+      return nullptr;
+    }
+    handler();
+  }
+
+  auto& counters = get_thread_counters();
+  auto header = static_cast<BlockHeader*>(ptr);
+  header->owner = &counters;
+  header->size = size;
+  counters.allocations++;
+  counters.bytes += size;
+  long long live_bytes = (counters.live_bytes += size);
+  counters.peak_bytes = std::max(counters.peak_bytes, live_bytes);
+  counters.alloc_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start_time).count();
+  return static_cast<char*>(ptr) + HEADER_SIZE;
+}
+
+static void tracked_free(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  auto start_time = std::chrono::steady_clock::now();
+  void* block = static_cast<char*>(ptr) - HEADER_SIZE;
+  auto header = static_cast<BlockHeader*>(block);
+  header->owner->live_bytes -= header->size;
+  std::free(block);
+
+  // The time is spent by the freeing thread
+  auto& counters = get_thread_counters();
+  counters.alloc_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start_time).count();
+}
+
+void* operator new(size_t size) {
+  void* ptr = tracked_malloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return ::operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return tracked_malloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return ::operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+  tracked_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  tracked_free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  tracked_free(ptr);
+}
+#endif
+
+alloc_tracker::AllocScope::AllocScope() {
+  auto& counters = get_thread_counters();
+  start_allocations_ = counters.allocations;
+  start_bytes_ = counters.bytes;
+  start_live_bytes_ = counters.live_bytes;
+  start_alloc_time_ = std::chrono::nanoseconds(counters.alloc_time);
+
+  // The peak of the scope starts from the live bytes of now,
+  // the peak of an outer scope is put back at the end
+  outer_peak_bytes_ = counters.peak_bytes;
+  counters.peak_bytes = counters.live_bytes;
+}
+
+alloc_tracker::AllocScope::~AllocScope() {
+  auto& counters = get_thread_counters();
+  counters.peak_bytes = std::max(counters.peak_bytes, outer_peak_bytes_);
+}
+
+alloc_tracker::AllocStats alloc_tracker::AllocScope::stats() const {
+  auto& counters = get_thread_counters();
+  AllocStats stats;
+  stats.allocations = counters.allocations - start_allocations_;
+  stats.bytes_allocated = counters.bytes - start_bytes_;
+  stats.peak_live_bytes = std::max(0LL,
+    counters.peak_bytes - start_live_bytes_);
+  stats.alloc_time = std::chrono::duration<double, std::milli>(
+    std::chrono::nanoseconds(counters.alloc_time) - start_alloc_time_).count();
+  return stats;
+}
+
+bool alloc_tracker::enabled() {
+#ifdef ALLOC_TRACKING
+  return true;
+#else
+  return false;
+#endif
+}
+
+size_t alloc_tracker::peak_rss() {
+  std::ifstream status_file("/proc/self/status");
+  std::string line;
+  while (std::getline(status_file, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::stoul(line.substr(6)) * 1024;
+    }
+  }
+  return 0;
+}
+
+size_t alloc_tracker::private_memory() {
+  std::ifstream rollup_file("/proc/self/smaps_rollup");
+  std::string line;
+  size_t private_bytes = 0;
+  while (std::getline(rollup_file, line)) {
+    if (line.compare(0, 14, "Private_Clean:") == 0 ||
+        line.compare(0, 14, "Private_Dirty:") == 0) {
+      private_bytes += std::stoul(line.substr(14)) * 1024;
+    }
+  }
+  return private_bytes;
+}
+
+bool alloc_tracker::reset_peak_rss() {
+  // Writing 5 to clear_refs sets the high water mark to the current
+  // resident memory, see proc(5)
+  std::ofstream clear_refs_file("/proc/self/clear_refs");
+  if (!clear_refs_file.is_open()) {
+    return false;
+  }
+  clear_refs_file << "5";
+  clear_refs_file.close();
+  return !clear_refs_file.fail();
+}
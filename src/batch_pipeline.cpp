@@ -0,0 +1,321 @@
+/* batch_pipeline.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "batch_pipeline.h"
+#include "route_evaluator.h"
+
+BatchPipeline::BatchPipeline(const BatchConfig& config):
+  config_(config),
+  parsed_queue_(config.queue_capacity),
+  solved_queue_(config.queue_capacity),
+  checked_queue_(config.queue_capacity),
+  written_count_{0},
+  active_workers_{0},
+  invalid_routes_{0},
+  allocations_{0},
+  bytes_allocated_{0},
+  peak_live_bytes_{0},
+  alloc_time_{0},
+  start_time_(std::chrono::steady_clock::now()) {
+  if (config_.num_of_workers <= 0) {
+    config_.num_of_workers =
+      std::max(1u, std::thread::hardware_concurrency());
+  }
+  config_.max_in_flight = std::max<size_t>(1, config_.max_in_flight);
+
+  for (auto counter : {&read_counter_, &solve_counter_,
+                       &check_counter_, &write_counter_}) {
+    counter->items = 0;
+    counter->busy_time = 0;
+    counter->num_of_threads = 1;
+  }
+  solve_counter_.num_of_threads = config_.num_of_workers;
+  check_counter_.num_of_threads = config_.validate ? 1 : 0;
+}
+
+void BatchPipeline::count(StageCounter& counter,
+                          std::chrono::steady_clock::time_point start_time) {
+  counter.items++;
+  counter.busy_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start_time).count();
+}
+
+void BatchPipeline::read_stage(std::istream& input) {
+  size_t sequence = 0;
+  std::string line;
+  while (std::getline(input, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    // Answers are written in order, so reading waits for the writer
+    // instead of letting the queries behind a slow one pile up
+    for (int tries=0;
+         sequence - written_count_.load() >= config_.max_in_flight; ++tries) {
+      BoundedQueue<BatchItem>::backoff(tries);
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    BatchItem item;
+    item.sequence = sequence++;
+    std::stringstream line_stream(line);
+    std::string extra;
+    if (!(line_stream >> item.start_charger >> item.goal_charger) ||
+        (line_stream >> extra)) {
+      item.error = "Bad query line " + line;
+    } else {
+      try {
+        database::get_charger_id(item.start_charger);
+        database::get_charger_id(item.goal_charger);
+      } catch (const std::invalid_argument& e) {
+        item.error = e.what();
+      }
+    }
+
+    count(read_counter_, start_time);
+    parsed_queue_.push(std::move(item));
+  }
+
+  parsed_queue_.close();
+}
+
+void BatchPipeline::solve_stage() {
+  BatchItem item;
+  while (parsed_queue_.pop(item)) {
+    auto start_time = std::chrono::steady_clock::now();
+    if (item.error.empty()) {
+      alloc_tracker::AllocScope alloc_scope;
+      try {
+        PathSolver my_solver(item.start_charger, item.goal_charger,
+                             config_.vehicle);
+        my_solver.set_config(config_.solver_config);
+        item.answer = my_solver.solve();
+      } catch (const std::exception& e) {
+        item.error = e.what();
+      }
+      item.allocation = alloc_scope.stats();
+    }
+
+    allocations_ += item.allocation.allocations;
+    bytes_allocated_ += item.allocation.bytes_allocated;
+    alloc_time_ += static_cast<long long>(item.allocation.alloc_time * 1e6);
+    auto peak_live_bytes = peak_live_bytes_.load();
+    while (item.allocation.peak_live_bytes > peak_live_bytes &&
+           !peak_live_bytes_.compare_exchange_weak(
+             peak_live_bytes, item.allocation.peak_live_bytes)) {
+    }
+
+    count(solve_counter_, start_time);
+    solved_queue_.push(std::move(item));
+  }
+
+  // The last solver thread tells the next stage that no more items come
+  if (--active_workers_ == 0) {
+    solved_queue_.close();
+  }
+}
+
+void BatchPipeline::check_stage() {
+  BatchItem item;
+  while (solved_queue_.pop(item)) {
+    auto start_time = std::chrono::steady_clock::now();
+    if (item.error.empty()) {
+      auto evaluation = evaluator::evaluate_route(item.answer);
+      if (!evaluation.valid) {
+        item.error = "Invalid route " + evaluation.error;
+        invalid_routes_++;
+      }
+    }
+
+    count(check_counter_, start_time);
+    checked_queue_.push(std::move(item));
+  }
+
+  checked_queue_.close();
+}
+
+void BatchPipeline::write_stage(std::ostream& output, std::ostream* report,
+                                std::ostream* alloc_log) {
+  // Without validation the writer takes the solved items directly
+  auto& queue = config_.validate ? checked_queue_ : solved_queue_;
+
+  // Items that finished before an item in front of them
+  std::map<size_t, BatchItem> pending_items;
+  auto last_report = std::chrono::steady_clock::now();
+
+  BatchItem item;
+  while (queue.pop(item)) {
+    auto start_time = std::chrono::steady_clock::now();
+    pending_items[item.sequence] = std::move(item);
+
+    auto next_item = pending_items.begin();
+    while (next_item != pending_items.end() &&
+           next_item->first == written_count_.load()) {
+      auto& ready_item = next_item->second;
+      if (ready_item.error.empty()) {
+        output << ready_item.answer << "\n";
+      } else {
+        output << "Error: " << ready_item.error << "\n";
+      }
+      if (alloc_log != nullptr) {
+        auto& allocation = ready_item.allocation;
+        *alloc_log << ready_item.sequence << " " <<
+          ready_item.start_charger << " " << ready_item.goal_charger << " " <<
+          allocation.allocations << " " << allocation.bytes_allocated <<
+          " " << allocation.peak_live_bytes << " " << allocation.alloc_time <<
+          "\n";
+      }
+      next_item = pending_items.erase(next_item);
+      written_count_++;
+    }
+    count(write_counter_, start_time);
+
+    if (report != nullptr && std::chrono::duration<double>(
+          start_time - last_report).count() >= pipelineParam::REPORT_INTERVAL) {
+      print_stats(this->stats(), *report);
+      last_report = start_time;
+    }
+  }
+  output.flush();
+  if (alloc_log != nullptr) {
+    alloc_log->flush();
+  }
+}
+
+void BatchPipeline::run(std::istream& input, std::ostream& output,
+                        std::ostream* report, std::ostream* alloc_log) {
+  start_time_ = std::chrono::steady_clock::now();
+
+  // Share the lazily built database with every thread before they start
+  database::num_of_chargers();
+
+  active_workers_ = config_.num_of_workers;
+  std::vector<std::thread> threads;
+  threads.emplace_back(&BatchPipeline::read_stage, this, std::ref(input));
+  for (int i=0; i < config_.num_of_workers; ++i) {
+    threads.emplace_back(&BatchPipeline::solve_stage, this);
+  }
+  if (config_.validate) {
+    threads.emplace_back(&BatchPipeline::check_stage, this);
+  }
+
+  if (alloc_log != nullptr) {
+    *alloc_log << "# sequence start goal allocations bytes_allocated "
+      "peak_live_bytes alloc_time_ms\n";
+  }
+  this->write_stage(output, report, alloc_log);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (report != nullptr) {
+    print_stats(this->stats(), *report);
+  }
+}
+
+PipelineStats BatchPipeline::stats() const {
+  PipelineStats stats;
+  stats.elapsed_time = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start_time_).count();
+  stats.invalid_routes = invalid_routes_.load();
+  stats.allocation.allocations = allocations_.load();
+  stats.allocation.bytes_allocated = bytes_allocated_.load();
+  stats.allocation.peak_live_bytes = peak_live_bytes_.load();
+  stats.allocation.alloc_time = alloc_time_.load() * 1e-6;
+  stats.peak_rss = alloc_tracker::peak_rss();
+
+  auto add_stage = [&stats](const std::string& name,
+                            const StageCounter& counter) {
+    StageStats stage;
+    stage.name = name;
+    stage.items = counter.items.load();
+    stage.busy_time = counter.busy_time.load() * 1e-9;
+    stage.num_of_threads = counter.num_of_threads;
+    stats.stages.push_back(stage);
+  };
+  add_stage("read", read_counter_);
+  add_stage("solve", solve_counter_);
+  if (config_.validate) {
+    add_stage("check", check_counter_);
+  }
+  add_stage("write", write_counter_);
+
+  auto add_queue = [&stats](const std::string& name,
+                            const BoundedQueue<BatchItem>& queue) {
+    QueueStats queue_stats;
+    queue_stats.name = name;
+    queue_stats.depth = queue.size();
+    queue_stats.max_depth = queue.max_depth();
+    queue_stats.capacity = queue.capacity();
+    stats.queues.push_back(queue_stats);
+  };
+  add_queue("read->solve", parsed_queue_);
+  add_queue(config_.validate ? "solve->check" : "solve->write",
+            solved_queue_);
+  if (config_.validate) {
+    add_queue("check->write", checked_queue_);
+  }
+
+  return stats;
+}
+
+void BatchPipeline::print_stats(const PipelineStats& stats,
+                                std::ostream& report) {
+  report << std::fixed << std::setprecision(2) <<
+    "pipeline " << stats.elapsed_time << " s";
+  if (stats.invalid_routes > 0) {
+    report << ", " << stats.invalid_routes << " invalid routes";
+  }
+  report << std::endl;
+
+  // Throughput is per busy second of the stage,
+  // so it shows which stage limits the pipeline
+  for (auto& stage : stats.stages) {
+    double utilization = stats.elapsed_time > 0.0 ?
+      stage.busy_time / (stats.elapsed_time * stage.num_of_threads) : 0.0;
+    double throughput = stage.busy_time > 0.0 ?
+      stage.items * stage.num_of_threads / stage.busy_time : 0.0;
+    report << "  stage " << std::left << std::setw(14) << stage.name <<
+      std::right << std::setw(10) << stage.items << " items" <<
+      std::setw(12) << std::setprecision(0) << throughput << " items/s" <<
+      std::setw(8) << std::setprecision(1) << 100.0 * utilization <<
+      "% busy" << std::endl;
+  }
+  for (auto& queue : stats.queues) {
+    report << "  queue " << std::left << std::setw(14) << queue.name <<
+      std::right << std::setw(10) << queue.depth << " depth" <<
+      std::setw(8) << queue.max_depth << " max of " << queue.capacity <<
+      std::endl;
+  }
+
+  // Allocations are only counted when built with ALLOC_TRACKING
+  size_t solved_items = 1;
+  double solve_time = 1e-9;  // s
+  for (auto& stage : stats.stages) {
+    if (stage.name == "solve") {
+      solved_items = std::max<size_t>(1, stage.items);
+      solve_time = std::max(solve_time, stage.busy_time);
+    }
+  }
+  if (alloc_tracker::enabled()) {
+    report << "  memory " << stats.allocation.allocations / solved_items <<
+      " allocations/query, " <<
+      stats.allocation.bytes_allocated / solved_items / 1024 <<
+      " KiB/query, peak live " << stats.allocation.peak_live_bytes / 1024 <<
+      " KiB, allocator " << std::setprecision(1) <<
+      100.0 * stats.allocation.alloc_time * 1e-3 / solve_time <<
+      "% of solve" << std::endl;
+  }
+  report << "  memory peak RSS " << std::setprecision(1) <<
+    stats.peak_rss / (1024.0 * 1024.0) << " MiB" << std::endl;
+}
@@ -0,0 +1,138 @@
+/* beam_solver.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+#include "utility.h"
+#include "path.h"
+#include "beam_solver.h"
+
+BeamSolver::BeamSolver(
+  const std::string& start_charger,
+  const std::string& goal_charger,
+  const VehicleProfile& vehicle,
+  int beam_width,
+  size_t memory_limit):
+  start_charger_{start_charger},
+  goal_charger_{goal_charger},
+  vehicle_(vehicle),
+  beam_width_{std::max(1, beam_width)},
+  memory_limit_{memory_limit} {
+}
+
+int BeamSolver::layer_width(size_t path_size) const {
+  size_t max_paths = memory_limit_ / (2 * std::max<size_t>(1, path_size));
+  return static_cast<int>(std::max<size_t>(1,
+    std::min<size_t>(beam_width_, max_paths)));
+}
+
+size_t BeamSolver::peak_memory() const {
+  return peak_memory_;
+}
+
+std::string BeamSolver::solve() {
+  std::vector<std::shared_ptr<Path>> layer = {
+    std::make_shared<Path>(start_charger_, goal_charger_, vehicle_)};
+
+  Path best_path(start_charger_, goal_charger_, vehicle_);
+  double best_cost = std::numeric_limits<double>::infinity();
+
+  while (layer.size() > 0) {
+    size_t layer_memory = 0;
+    for (auto& path_ptr : layer) {
+      layer_memory += path_ptr->memory_size();
+    }
+
+    // Paths in the next layer have one more charger
+    auto& front_path = *layer.front();
+    size_t child_size = front_path.memory_size() *
+      (front_path.num_of_chargers() + 1) / front_path.num_of_chargers();
+    int width = this->layer_width(child_size);
+
+    // The best path to every charger in the next layer,
+    // limited to the width best ones by heuristic cost
+    std::unordered_map<std::string, PathAndCost> next_by_charger;
+    std::multimap<double, std::string> next_costs;
+
+    for (auto& path_ptr : layer) {
+      Path& curr_path = *path_ptr;
+      auto curr_charger = curr_path.current_charger();
+      auto neighbors = database::get_neighbors(
+        curr_charger, vehicle_.full_charge);
+
+      for (auto& charger : neighbors) {
+        if (curr_path.charger_visited(charger)) {
+          continue;
+        }
+
+        std::shared_ptr<Path> child_path_ptr =
+          std::make_shared<Path>(curr_path);
+        child_path_ptr->add_charger(charger);
+
+        // Paths that already took longer cannot improve the best path
+        double child_time = child_path_ptr->time_cost();
+        if (child_time >= best_cost) {
+          continue;
+        }
+
+        if (child_path_ptr->reached_goal) {
+          best_cost = child_time;
+          best_path = *child_path_ptr;
+          continue;
+        }
+
+        double child_cost = child_path_ptr->heuristic_cost();
+        auto same_charger = next_by_charger.find(charger);
+        if (same_charger != next_by_charger.end()) {
+          double old_cost = same_charger->second.first;
+          if (old_cost <= child_cost) {
+            continue;
+          }
+
+          auto range = next_costs.equal_range(old_cost);
+          for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == charger) {
+              next_costs.erase(it);
+              break;
+            }
+          }
+          next_by_charger.erase(same_charger);
+        } else if (next_by_charger.size() == width) {
+          // Replace the worst path in the next layer
+          auto worst = std::prev(next_costs.end());
+          if (worst->first <= child_cost) {
+            continue;
+          }
+
+          next_by_charger.erase(worst->second);
+          next_costs.erase(worst);
+        }
+
+        next_by_charger.emplace(
+          charger, std::make_pair(child_cost, child_path_ptr));
+        next_costs.emplace(child_cost, charger);
+      }
+    }
+
+    std::vector<std::shared_ptr<Path>> next_layer;
+    size_t next_memory = 0;
+    for (auto& next_cost : next_costs) {
+      next_layer.push_back(next_by_charger[next_cost.second].second);
+      next_memory += next_layer.back()->memory_size();
+    }
+
+    peak_memory_ = std::max(peak_memory_, layer_memory + next_memory);
+    layer.swap(next_layer);
+  }
+
+  if (best_cost < std::numeric_limits<double>::infinity()) {
+    return best_path.to_string();
+  }
+
+  return "";
+}
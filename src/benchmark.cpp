@@ -0,0 +1,341 @@
+/* benchmark.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "alloc_tracker.h"
+#include "beam_solver.h"
+#include "heuristic_cache.h"
+#include "parallel_solver.h"
+#include "path_solver.h"
+#include "route_evaluator.h"
+
+/**
+ * @Brief  Result of one engine on one query
+ */
+struct QueryResult {
+  double latency;  // ms
+  RouteEvaluation evaluation;
+
+  /**
+   * @Brief  Allocations of the query, all 0 without ALLOC_TRACKING
+   */
+  alloc_tracker::AllocStats allocation;
+
+  /**
+   * @Brief  Peak resident memory of the process during the query
+   */
+  size_t peak_rss;  // bytes
+};
+
+/**
+ * @Brief  Run an engine over the workload and time every query
+ */
+std::vector<QueryResult> run_engine(
+    const std::vector<std::pair<std::string, std::string>>& workload,
+    const std::function<std::string(const std::string&,
+                                    const std::string&)>& engine) {
+  std::vector<QueryResult> results;
+  for (auto& query : workload) {
+    QueryResult result;
+    alloc_tracker::reset_peak_rss();
+    auto start_time = std::chrono::steady_clock::now();
+    std::string solution;
+    {
+      alloc_tracker::AllocScope alloc_scope;
+      solution = engine(query.first, query.second);
+      result.allocation = alloc_scope.stats();
+    }
+    auto end_time = std::chrono::steady_clock::now();
+
+    result.latency = std::chrono::duration<double, std::milli>(
+      end_time - start_time).count();
+    result.peak_rss = alloc_tracker::peak_rss();
+    result.evaluation = evaluator::evaluate_route(solution);
+    results.push_back(result);
+  }
+
+  return results;
+}
+
+/**
+ * @Brief  Print latency and cost gap of an engine against the exact engine
+ */
+void report(const std::string& name,
+            const std::vector<QueryResult>& results,
+            const std::vector<QueryResult>& exact_results) {
+  std::vector<double> latencies;
+  double total_gap = 0.0;
+  double max_gap = 0.0;
+  int valid_count = 0;
+  int compared_count = 0;
+
+  for (int i=0; i < results.size(); ++i) {
+    latencies.push_back(results[i].latency);
+    if (!results[i].evaluation.valid) {
+      continue;
+    }
+    valid_count++;
+
+    if (exact_results[i].evaluation.valid) {
+      double gap = results[i].evaluation.cost /
+        exact_results[i].evaluation.cost - 1.0;
+      total_gap += gap;
+      max_gap = std::max(max_gap, gap);
+      compared_count++;
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::cout << std::left << std::setw(16) << name << std::right <<
+    std::fixed << std::setprecision(3) <<
+    std::setw(10) << utility::percentile(latencies, 0.5) <<
+    std::setw(10) << utility::percentile(latencies, 0.95) <<
+    std::setw(10) << latencies.back() <<
+    std::setw(8) << valid_count << "/" << results.size() <<
+    std::setprecision(2) <<
+    std::setw(10) << 100.0 * total_gap / std::max(1, compared_count) <<
+    std::setw(10) << 100.0 * max_gap << std::endl;
+}
+
+/**
+ * @Brief  Print the allocations and peak memory of an engine
+ *
+ *         Allocations are only counted when built with ALLOC_TRACKING
+ *
+ * @Param results The results of the engine
+ * @Param show_allocations Whether the allocations of the calling thread
+ *                         are all the allocations of the engine
+ */
+void report_memory(const std::vector<QueryResult>& results,
+                   bool show_allocations = true) {
+  size_t allocations = 0;
+  size_t bytes_allocated = 0;
+  size_t peak_live_bytes = 0;
+  size_t peak_rss = 0;
+  double alloc_time = 0.0;
+  double latency = 0.0;
+  for (auto& result : results) {
+    allocations += result.allocation.allocations;
+    bytes_allocated += result.allocation.bytes_allocated;
+    peak_live_bytes = std::max(peak_live_bytes,
+                               result.allocation.peak_live_bytes);
+    peak_rss = std::max(peak_rss, result.peak_rss);
+    alloc_time += result.allocation.alloc_time;
+    latency += result.latency;
+  }
+
+  size_t num_of_queries = std::max<size_t>(1, results.size());
+  std::cout << std::setprecision(1);
+  if (alloc_tracker::enabled() && show_allocations) {
+    std::cout << "  allocations " << allocations / num_of_queries <<
+      "/query, " << bytes_allocated / num_of_queries / 1024 <<
+      " KiB/query, peak live " << peak_live_bytes / 1024 <<
+      " KiB, allocator " << 100.0 * alloc_time / std::max(latency, 1e-9) <<
+      "% of latency" << std::endl;
+  }
+  std::cout << "  peak RSS " << peak_rss / (1024.0 * 1024.0) << " MiB" <<
+    std::endl;
+}
+
+/**
+ * @Brief  Write one line per query of an engine to the allocation log
+ */
+void write_alloc_log(std::ofstream& log, const std::string& name,
+    const std::vector<std::pair<std::string, std::string>>& workload,
+    const std::vector<QueryResult>& results) {
+  if (!log.is_open()) {
+    return;
+  }
+  for (int i=0; i < results.size(); ++i) {
+    auto& allocation = results[i].allocation;
+    log << name << " " << workload[i].first << " " << workload[i].second <<
+      " " << results[i].latency << " " << allocation.allocations << " " <<
+      allocation.bytes_allocated << " " << allocation.peak_live_bytes <<
+      " " << allocation.alloc_time << " " << results[i].peak_rss << "\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  int number_of_pairs = 100;
+  unsigned int seed = 0;
+  std::string query_file_name;
+  std::string alloc_log_name;
+  std::vector<int> beam_widths = {10, 50, 200};
+  std::vector<int> thread_counts;
+  double cost_window = parallelSolverParam::COST_WINDOW;
+  double min_dist = 0.0;
+  size_t memory_limit = beamSolverParam::DEFAULT_MEMORY_LIMIT;
+
+  for (int i=1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--network") {
+      database::load_network(argv[i + 1]);
+    } else if (arg == "--queries") {
+      query_file_name = argv[i + 1];
+    } else if (arg == "--pairs") {
+      number_of_pairs = std::stoi(argv[i + 1]);
+    } else if (arg == "--seed") {
+      seed = std::stoul(argv[i + 1]);
+    } else if (arg == "--memory-limit") {
+      memory_limit = std::stoul(argv[i + 1]);
+    } else if (arg == "--beam-widths") {
+      beam_widths.clear();
+      std::stringstream widths_stream(argv[i + 1]);
+      std::string width;
+      while (std::getline(widths_stream, width, ',')) {
+        beam_widths.push_back(std::stoi(width));
+      }
+    } else if (arg == "--alloc-log") {
+      alloc_log_name = argv[i + 1];
+    } else if (arg == "--min-dist") {
+      min_dist = std::stod(argv[i + 1]);
+    } else if (arg == "--threads") {
+      std::stringstream threads_stream(argv[i + 1]);
+      std::string threads;
+      while (std::getline(threads_stream, threads, ',')) {
+        thread_counts.push_back(std::stoi(threads));
+      }
+    } else if (arg == "--cost-window") {
+      cost_window = std::stod(argv[i + 1]);
+    } else {
+      std::cout << "Usage: benchmark [--pairs N] [--seed S] "
+        "[--beam-widths W1,W2,...] [--memory-limit BYTES]" << std::endl;
+      std::cout << "                 [--threads T1,T2,...] "
+        "[--cost-window F] [--min-dist KM] [--alloc-log log_file]" <<
+        std::endl;
+      std::cout << "                 [--network network_file] "
+        "[--queries query_file]" << std::endl;
+      return -1;
+    }
+  }
+
+  // Hard queries are the long ones, which can be benchmarked alone
+  auto is_long_enough = [min_dist](const std::string& start,
+                                   const std::string& goal) {
+    return utility::calc_great_distance(database::get_charger_record(start),
+      database::get_charger_record(goal)) >= min_dist;
+  };
+
+  // The same seed always gives the same workload,
+  // unless the queries are given as "start goal" lines
+  std::vector<std::pair<std::string, std::string>> workload;
+  if (!query_file_name.empty()) {
+    std::ifstream query_file(query_file_name);
+    std::string start;
+    std::string goal;
+    while (query_file >> start >> goal &&
+           workload.size() < number_of_pairs) {
+      if (is_long_enough(start, goal)) {
+        workload.emplace_back(start, goal);
+      }
+    }
+  }
+
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> charger_dist(
+    0, database::num_of_chargers() - 1);
+  while (query_file_name.empty() && workload.size() < number_of_pairs) {
+    int start = charger_dist(gen);
+    int goal = charger_dist(gen);
+    auto& start_name = database::get_charger_record(start).name;
+    auto& goal_name = database::get_charger_record(goal).name;
+    if (start != goal && is_long_enough(start_name, goal_name)) {
+      workload.emplace_back(start_name, goal_name);
+    }
+  }
+
+  // One line per query and engine with its allocations and peak memory
+  std::ofstream alloc_log;
+  if (!alloc_log_name.empty()) {
+    alloc_log.open(alloc_log_name);
+    alloc_log << "# engine start goal latency_ms allocations bytes_allocated "
+      "peak_live_bytes alloc_time_ms peak_rss_bytes\n";
+  }
+
+  size_t exact_nodes_expanded = 0;
+  auto exact_results = run_engine(workload,
+    [&exact_nodes_expanded](const std::string& start,
+                            const std::string& goal) {
+      PathSolver my_solver(start, goal);
+      auto solution = my_solver.solve();
+      exact_nodes_expanded += my_solver.nodes_expanded();
+      return solution;
+    });
+
+  std::cout << std::left << std::setw(16) << "engine" << std::right <<
+    std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms" <<
+    std::setw(10) << "max ms" << std::setw(12) << "valid" <<
+    std::setw(10) << "gap %" << std::setw(10) << "max gap %" << std::endl;
+  report("astar", exact_results, exact_results);
+
+  // Queries to the same goal share the backward search
+  auto goal_table_stats = heuristic::stats();
+  std::cout << "  goal table cache " << goal_table_stats.hits << " hits, " <<
+    goal_table_stats.misses << " misses, hit rate " <<
+    std::setprecision(1) << 100.0 * goal_table_stats.hit_rate() << "%" <<
+    std::endl;
+  std::cout << "  nodes expanded " << exact_nodes_expanded << std::endl;
+  report_memory(exact_results);
+  write_alloc_log(alloc_log, "astar", workload, exact_results);
+
+  for (int width : beam_widths) {
+    size_t peak_memory = 0;
+    auto beam_results = run_engine(workload,
+      [width, memory_limit, &peak_memory](
+          const std::string& start, const std::string& goal) {
+        BeamSolver beam_solver(start, goal, VehicleProfile(),
+                               width, memory_limit);
+        auto solution = beam_solver.solve();
+        peak_memory = std::max(peak_memory, beam_solver.peak_memory());
+        return solution;
+      });
+
+    report("beam_" + std::to_string(width), beam_results, exact_results);
+    std::cout << "  peak path memory " << peak_memory / 1024 << " KiB" <<
+      std::endl;
+    report_memory(beam_results);
+    write_alloc_log(alloc_log, "beam_" + std::to_string(width), workload,
+                    beam_results);
+  }
+
+  // The same search as astar on several threads for every query
+  for (int num_of_threads : thread_counts) {
+    size_t nodes_expanded = 0;
+    auto parallel_results = run_engine(workload,
+      [num_of_threads, cost_window, &nodes_expanded](
+          const std::string& start, const std::string& goal) {
+        ParallelSolver parallel_solver(start, goal, VehicleProfile(),
+                                       num_of_threads);
+        parallel_solver.set_cost_window(cost_window);
+        auto solution = parallel_solver.solve();
+        nodes_expanded += parallel_solver.nodes_expanded();
+        return solution;
+      });
+
+    report("parallel_" + std::to_string(num_of_threads), parallel_results,
+           exact_results);
+    std::cout << "  nodes expanded " << nodes_expanded << std::endl;
+
+    // Allocations are only counted on the calling thread,
+    // so only the peak memory is comparable
+    report_memory(parallel_results, false);
+    write_alloc_log(alloc_log, "parallel_" + std::to_string(num_of_threads),
+                    workload, parallel_results);
+  }
+
+  return 0;
+}
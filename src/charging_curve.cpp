@@ -0,0 +1,122 @@
+/* charging_curve.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "charging_curve.h"
+
+ChargingCurve::ChargingCurve(const std::vector<double>& socs,
+                             const std::vector<double>& powers):
+  socs_(socs),
+  powers_(powers) {
+  if (socs_.empty() || socs_.size() != powers_.size()) {
+    throw std::invalid_argument(
+      "Charging curve requires a power at every state of charge");
+  }
+  for (int i=0; i < socs_.size(); ++i) {
+    if (socs_[i] < 0.0 || socs_[i] > 1.0 ||
+        (i > 0 && socs_[i] <= socs_[i - 1])) {
+      throw std::invalid_argument(
+        "States of charge have to increase between 0 and 1");
+    }
+    if (powers_[i] < chargingCurveParam::MIN_POWER || powers_[i] > 1.0) {
+      throw std::invalid_argument(
+        "Charging power has to be a fraction of the charge rate");
+    }
+  }
+
+  // The power is linear between the points and the steps,
+  // so the time of every piece is exact
+  const int size = chargingCurveParam::TABLE_SIZE;
+  times_.assign(size + 1, 0.0);
+  for (int m=0; m < size; ++m) {
+    double step_start = static_cast<double>(m) / size;
+    double step_end = static_cast<double>(m + 1) / size;
+
+    std::vector<double> cuts = {step_start};
+    for (double soc : socs_) {
+      if (soc > step_start && soc < step_end) {
+        cuts.push_back(soc);
+      }
+    }
+    cuts.push_back(step_end);
+
+    double time = 0.0;
+    for (int i=0; i + 1 < cuts.size(); ++i) {
+      double length = cuts[i + 1] - cuts[i];
+      double start_power = this->power(cuts[i]);
+      double end_power = this->power(cuts[i + 1]);
+      if (std::abs(end_power - start_power) < 1e-12) {
+        time += length / start_power;
+      } else {
+        time += length * std::log(end_power / start_power) /
+          (end_power - start_power);
+      }
+    }
+    times_[m + 1] = times_[m] + time;
+  }
+
+  // Every step of the table takes at least 1 / size as the power
+  // is at most 1, so a time step of 1 / size never skips a step
+  time_step_ = 1.0 / size;
+  int num_of_time_steps = static_cast<int>(times_.back() / time_step_) + 1;
+  steps_.resize(num_of_time_steps);
+  int m = 0;
+  for (int j=0; j < num_of_time_steps; ++j) {
+    while (m + 1 < size && times_[m + 1] <= j * time_step_) {
+      m++;
+    }
+    steps_[j] = m;
+  }
+}
+
+double ChargingCurve::power(double soc) const {
+  if (soc <= socs_.front()) {
+    return powers_.front();
+  }
+  if (soc >= socs_.back()) {
+    return powers_.back();
+  }
+
+  int i = std::upper_bound(socs_.begin(), socs_.end(), soc) - socs_.begin();
+  double fraction = (soc - socs_[i - 1]) / (socs_[i] - socs_[i - 1]);
+  return powers_[i - 1] + fraction * (powers_[i] - powers_[i - 1]);
+}
+
+double ChargingCurve::charge_time(double charge, double full_charge) const {
+  const int size = chargingCurveParam::TABLE_SIZE;
+  double position = std::min(1.0, std::max(0.0, charge / full_charge)) * size;
+  int m = std::min(static_cast<int>(position), size - 1);
+
+  return (times_[m] + (position - m) * (times_[m + 1] - times_[m])) *
+    full_charge;
+}
+
+double ChargingCurve::charge_time(double from, double to,
+                                  double full_charge, double rate) const {
+  return (this->charge_time(to, full_charge) -
+          this->charge_time(from, full_charge)) / rate;
+}
+
+double ChargingCurve::charge_after(double from, double time,
+                                   double full_charge, double rate) const {
+  const int size = chargingCurveParam::TABLE_SIZE;
+  double target = (this->charge_time(from, full_charge) + time * rate) /
+    full_charge;
+  if (target >= times_.back()) {
+    return full_charge;
+  }
+
+  int m = steps_[static_cast<int>(target / time_step_)];
+  if (m + 1 < size && times_[m + 1] <= target) {
+    m++;
+  }
+  double position = m + (target - times_[m]) / (times_[m + 1] - times_[m]);
+
+  return std::min(full_charge, position / size * full_charge);
+}
@@ -0,0 +1,504 @@
+/* diff_harness.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "beam_solver.h"
+#include "path_solver.h"
+#include "route_evaluator.h"
+
+/**
+ * @Brief  Default settings of the differential harness
+ */
+namespace diffHarnessParam {
+  /**
+   * @Brief  Allowed growth of the cost of a route before the harness fails
+   *
+   *         Tight, so that any route changed by a rewrite is reported
+   *         and only rounding noise passes
+   */
+  constexpr double COST_THRESHOLD = 1e-6;
+
+  /**
+   * @Brief  Number of pairs a thread takes at a time
+   *
+   *         Pairs are ordered by goal, so a chunk shares the
+   *         goal table of the heuristic
+   */
+  constexpr int CHUNK_SIZE = 64;
+
+  /**
+   * @Brief  Number of the worst pairs printed for every list
+   */
+  constexpr int WORST_OFFENDERS = 10;
+}  // namespace diffHarnessParam
+
+using Engine = std::function<std::string(const std::string&,
+                                         const std::string&)>;
+
+/**
+ * @Brief  Result of one engine on one pair
+ */
+struct PairRecord {
+  std::string start;
+  std::string goal;
+  double cost;  // hr, infinity if the route is invalid
+  double latency;  // ms
+  std::string route;
+};
+
+/**
+ * @Brief  Make an engine from its name
+ *
+ *         "beam_W" is the beam search of width W, any other name
+ *         is a preset of the path solver
+ *
+ *         Throws std::invalid_argument for an unknown name
+ */
+Engine make_engine(const std::string& name) {
+  if (name.compare(0, 5, "beam_") == 0) {
+    int width = std::stoi(name.substr(5));
+    return [width](const std::string& start, const std::string& goal) {
+      BeamSolver beam_solver(start, goal, VehicleProfile(), width);
+      return beam_solver.solve();
+    };
+  }
+
+  auto config = PathSolverConfig::preset(name);
+  return [config](const std::string& start, const std::string& goal) {
+    PathSolver my_solver(start, goal);
+    my_solver.set_config(config);
+    return my_solver.solve();
+  };
+}
+
+/**
+ * @Brief  Solve a pair with an engine and validate the route
+ *         with the in-process checker
+ */
+PairRecord run_pair(const Engine& engine, const std::string& start,
+                    const std::string& goal) {
+  PairRecord record;
+  record.start = start;
+  record.goal = goal;
+
+  auto start_time = std::chrono::steady_clock::now();
+  record.route = engine(start, goal);
+  auto end_time = std::chrono::steady_clock::now();
+  record.latency = std::chrono::duration<double, std::milli>(
+    end_time - start_time).count();
+
+  auto evaluation = evaluator::evaluate_route(record.route);
+  record.cost = evaluation.valid ? evaluation.cost :
+    std::numeric_limits<double>::infinity();
+  return record;
+}
+
+/**
+ * @Brief  Solve every pair with every engine on parallel threads
+ *
+ *         The engines solve a pair one after the other on the same
+ *         thread, so their latencies see the same load
+ *
+ * @Returns  The records of every engine in the order of the pairs
+ */
+std::vector<std::vector<PairRecord>> run_pairs(
+    const std::vector<std::pair<std::string, std::string>>& pairs,
+    const std::vector<Engine>& engines, int num_of_threads) {
+  std::vector<std::vector<PairRecord>> records(
+    engines.size(), std::vector<PairRecord>(pairs.size()));
+
+  std::atomic<size_t> next_pair{0};
+  std::atomic<size_t> done_pairs{0};
+  std::mutex progress_mutex;
+  auto worker = [&]() {
+    size_t first;
+    while ((first = next_pair.fetch_add(diffHarnessParam::CHUNK_SIZE)) <
+           pairs.size()) {
+      size_t last = std::min(pairs.size(),
+                             first + diffHarnessParam::CHUNK_SIZE);
+      for (size_t i=first; i < last; ++i) {
+        // The engine that runs first takes the misses of the shared
+        // caches, so the order alternates between pairs
+        for (int k=0; k < engines.size(); ++k) {
+          int e = (i + k) % engines.size();
+          records[e][i] = run_pair(engines[e], pairs[i].first,
+                                   pairs[i].second);
+        }
+      }
+
+      // Report progress every tenth of the pairs
+      size_t done = done_pairs.fetch_add(last - first) + (last - first);
+      size_t tenth = std::max<size_t>(1, pairs.size() / 10);
+      if (done / tenth != (done - (last - first)) / tenth) {
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        std::cerr << "  " << done << "/" << pairs.size() << " pairs" <<
+          std::endl;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i=1; i < num_of_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  return records;
+}
+
+/**
+ * @Brief  Write records as one "pair" line per pair
+ */
+void write_records(const std::vector<PairRecord>& records,
+                   const std::string& file_name) {
+  std::ofstream file(file_name);
+  file << "# diff_harness record, latency in ms and cost in hr" << std::endl;
+  file << "# pair start goal cost latency route" << std::endl;
+  file << std::fixed;
+  for (auto& record : records) {
+    file << "pair " << record.start << " " << record.goal << " " <<
+      std::setprecision(9) << record.cost << " " <<
+      std::setprecision(3) << record.latency << " " << record.route <<
+      std::endl;
+  }
+}
+
+/**
+ * @Brief  Read records written by write_records
+ *
+ *         Throws std::invalid_argument if the file is missing or malformed
+ */
+std::vector<PairRecord> read_records(const std::string& file_name) {
+  std::ifstream file(file_name);
+  if (!file) {
+    throw std::invalid_argument("Cannot open baseline " + file_name);
+  }
+
+  std::vector<PairRecord> records;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::stringstream line_stream(line);
+    std::string key;
+    std::string cost;
+    PairRecord record;
+    line_stream >> key >> record.start >> record.goal >> cost >>
+      record.latency;
+    if (key != "pair" || line_stream.fail()) {
+      throw std::invalid_argument("Malformed baseline line: " + line);
+    }
+    record.cost = (cost == "inf") ?
+      std::numeric_limits<double>::infinity() : std::stod(cost);
+
+    // The route is the rest of the line
+    std::getline(line_stream >> std::ws, record.route);
+    records.push_back(record);
+  }
+
+  return records;
+}
+
+/**
+ * @Brief  Print a summary line of the records of an engine
+ */
+void report_engine(const std::string& name,
+                   const std::vector<PairRecord>& records) {
+  std::vector<double> latencies;
+  double total_latency = 0.0;
+  int valid_count = 0;
+  for (auto& record : records) {
+    latencies.push_back(record.latency);
+    total_latency += record.latency;
+    valid_count += (record.cost < std::numeric_limits<double>::infinity());
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::cout << std::left << std::setw(16) << name << std::right <<
+    std::setw(10) << valid_count << std::setw(10) <<
+    records.size() - valid_count << std::fixed << std::setprecision(3) <<
+    std::setw(10) << utility::percentile(latencies, 0.5) <<
+    std::setw(10) << utility::percentile(latencies, 0.95) <<
+    std::setw(10) << utility::percentile(latencies, 1.0) <<
+    std::setprecision(1) << std::setw(10) << total_latency / 1000.0 <<
+    std::endl;
+}
+
+/**
+ * @Brief  Compare the candidate with the reference pair by pair
+ *         and print the difference
+ *
+ * @Returns  True if any route of the candidate is invalid where the
+ *           reference is valid, costs more than the threshold allows,
+ *           or is missing from the reference
+ */
+bool compare_records(const std::vector<PairRecord>& base,
+                     const std::vector<PairRecord>& current,
+                     double cost_threshold, int num_of_worst) {
+  const double inf = std::numeric_limits<double>::infinity();
+  std::map<std::pair<std::string, std::string>, const PairRecord*>
+    base_records;
+  for (auto& record : base) {
+    base_records[std::make_pair(record.start, record.goal)] = &record;
+  }
+
+  int missing_count = 0;
+  int changed_routes = 0;
+  int cost_regressions = 0;
+  int cost_improvements = 0;
+  double total_delta = 0.0;
+  int compared_count = 0;
+  std::vector<double> deltas;
+  double base_latency = 0.0;
+  double current_latency = 0.0;
+  std::vector<double> latency_ratios;
+
+  // Worst pairs by relative cost delta and by added latency
+  std::vector<std::pair<double, int>> cost_deltas;
+  std::vector<std::pair<double, int>> slowdowns;
+  std::vector<int> broken_pairs;
+  std::vector<const PairRecord*> matched(current.size(), nullptr);
+
+  for (int i=0; i < current.size(); ++i) {
+    auto& record = current[i];
+    auto base_record = base_records.find(
+      std::make_pair(record.start, record.goal));
+    if (base_record == base_records.end()) {
+      missing_count++;
+      continue;
+    }
+    auto& base_pair = *base_record->second;
+    matched[i] = &base_pair;
+
+    changed_routes += (record.route != base_pair.route);
+    base_latency += base_pair.latency;
+    current_latency += record.latency;
+    latency_ratios.push_back(
+      record.latency / std::max(base_pair.latency, 1e-6));
+
+    // Ratios of the fastest pairs are mostly timer noise,
+    // so the worst slowdowns are the largest added time
+    if (record.latency > base_pair.latency) {
+      slowdowns.emplace_back(record.latency - base_pair.latency, i);
+    }
+
+    if (base_pair.cost < inf && record.cost == inf) {
+      broken_pairs.push_back(i);
+      continue;
+    }
+    if (base_pair.cost == inf || record.cost == inf) {
+      continue;
+    }
+
+    double delta = record.cost / base_pair.cost - 1.0;
+    total_delta += delta;
+    compared_count++;
+    deltas.push_back(delta);
+    if (delta > cost_threshold) {
+      cost_regressions++;
+      cost_deltas.emplace_back(delta, i);
+    } else if (delta < -cost_threshold) {
+      cost_improvements++;
+    }
+  }
+  std::sort(latency_ratios.begin(), latency_ratios.end());
+  std::sort(deltas.begin(), deltas.end());
+
+  std::cout << "routes changed " << changed_routes << " of " <<
+    current.size() << std::endl;
+  std::cout << "cost " << cost_regressions << " worse, " <<
+    cost_improvements << " better, mean delta " << std::scientific <<
+    std::setprecision(2) << total_delta / std::max(1, compared_count) <<
+    ", p99 " << utility::percentile(deltas, 0.99) <<
+    ", max " << utility::percentile(deltas, 1.0) << std::endl;
+  std::cout << std::fixed << std::setprecision(3) <<
+    "latency ratio p50 " << utility::percentile(latency_ratios, 0.5) <<
+    ", p95 " << utility::percentile(latency_ratios, 0.95) <<
+    ", p99 " << utility::percentile(latency_ratios, 0.99) <<
+    ", total " << current_latency / std::max(base_latency, 1e-6) <<
+    std::endl;
+
+  auto worst_first = [](const std::pair<double, int>& a,
+                        const std::pair<double, int>& b) {
+    return a.first > b.first;
+  };
+  auto print_worst = [&](const std::string& title,
+                         std::vector<std::pair<double, int>>& values,
+                         bool is_cost) {
+    int num_printed = std::min<int>(num_of_worst, values.size());
+    if (num_printed == 0) {
+      return;
+    }
+    std::partial_sort(values.begin(), values.begin() + num_printed,
+                      values.end(), worst_first);
+    std::cout << title << ":" << std::endl;
+    for (int k=0; k < num_printed; ++k) {
+      auto& record = current[values[k].second];
+      auto& base_pair = *matched[values[k].second];
+      std::cout << "  " << record.start << " " << record.goal << "  ";
+      if (is_cost) {
+        std::cout << std::setprecision(5) << base_pair.cost << " -> " <<
+          record.cost << " hr (" << std::showpos << std::setprecision(4) <<
+          100.0 * values[k].first << std::noshowpos << "%)" << std::endl;
+      } else {
+        std::cout << std::setprecision(3) << base_pair.latency << " -> " <<
+          record.latency << " ms (" << std::setprecision(2) <<
+          record.latency / std::max(base_pair.latency, 1e-6) << "x)" <<
+          std::endl;
+      }
+    }
+  };
+  print_worst("worst cost regressions", cost_deltas, true);
+  print_worst("worst latency increases", slowdowns, false);
+
+  if (!broken_pairs.empty()) {
+    std::cout << broken_pairs.size() << " invalid routes where the " <<
+      "reference is valid:" << std::endl;
+    for (int k=0; k < std::min<int>(num_of_worst, broken_pairs.size());
+         ++k) {
+      auto& record = current[broken_pairs[k]];
+      std::cout << "  " << record.start << " " << record.goal << std::endl;
+    }
+  }
+  if (missing_count > 0) {
+    std::cout << missing_count << " pairs missing from the reference" <<
+      std::endl;
+  }
+
+  return missing_count > 0 || !broken_pairs.empty() || cost_regressions > 0;
+}
+
+int main(int argc, char** argv) {
+  std::string reference_name = "default";
+  std::string candidate_name = "default";
+  std::string baseline_file_name;
+  std::string record_file_name;
+  int num_of_threads = 0;
+  int stride = 1;
+  int num_of_worst = diffHarnessParam::WORST_OFFENDERS;
+  double cost_threshold = diffHarnessParam::COST_THRESHOLD;
+
+  for (int i=1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--network") {
+      database::load_network(argv[i + 1]);
+    } else if (arg == "--reference") {
+      reference_name = argv[i + 1];
+    } else if (arg == "--candidate") {
+      candidate_name = argv[i + 1];
+    } else if (arg == "--baseline") {
+      baseline_file_name = argv[i + 1];
+    } else if (arg == "--record") {
+      record_file_name = argv[i + 1];
+    } else if (arg == "--threads") {
+      num_of_threads = std::stoi(argv[i + 1]);
+    } else if (arg == "--stride") {
+      stride = std::max(1, std::stoi(argv[i + 1]));
+    } else if (arg == "--worst") {
+      num_of_worst = std::stoi(argv[i + 1]);
+    } else if (arg == "--cost-threshold") {
+      cost_threshold = std::stod(argv[i + 1]);
+    } else {
+      std::cout << "Usage: diff_harness [--reference engine] "
+        "[--candidate engine] [--threads N]" << std::endl;
+      std::cout << "                    [--baseline record_file] "
+        "[--record record_file] [--stride K]" << std::endl;
+      std::cout << "                    [--worst N] [--cost-threshold F] "
+        "[--network network_file]" << std::endl;
+      std::cout << "Engines: default|balanced|fast|beam_WIDTH" << std::endl;
+      return -1;
+    }
+  }
+  if (num_of_threads <= 0) {
+    num_of_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // Every ordered pair of stations, grouped by goal,
+  // or every stride-th pair for a quick run
+  std::vector<std::pair<std::string, std::string>> pairs;
+  int num_of_chargers = database::num_of_chargers();
+  long long pair_index = 0;
+  for (int goal=0; goal < num_of_chargers; ++goal) {
+    for (int start=0; start < num_of_chargers; ++start) {
+      if (start != goal && pair_index++ % stride == 0) {
+        pairs.emplace_back(database::get_charger_record(start).name,
+                           database::get_charger_record(goal).name);
+      }
+    }
+  }
+
+  if (pairs.empty()) {
+    std::cout << "No pairs of stations to compare" << std::endl;
+    return -1;
+  }
+
+  // Recording alone runs only the candidate, and a baseline
+  // replaces the reference engine with another build
+  std::vector<Engine> engines = {make_engine(candidate_name)};
+  bool run_reference = baseline_file_name.empty() && record_file_name.empty();
+  if (run_reference) {
+    engines.push_back(make_engine(reference_name));
+  }
+
+  // The first search builds the lazy tables of the database,
+  // which no pair should be timed with
+  for (auto& engine : engines) {
+    engine(pairs.front().first, pairs.front().second);
+  }
+
+  std::cerr << "Solving " << pairs.size() << " pairs on " <<
+    num_of_threads << " threads" << std::endl;
+  auto start_time = std::chrono::steady_clock::now();
+  auto records = run_pairs(pairs, engines, num_of_threads);
+  double wall_time = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start_time).count();
+  std::cout << pairs.size() << " pairs on " << num_of_threads <<
+    " threads in " << std::fixed << std::setprecision(1) << wall_time <<
+    " s" << std::endl;
+
+  if (!record_file_name.empty()) {
+    write_records(records[0], record_file_name);
+    std::cout << "Recorded " << records[0].size() << " pairs to " <<
+      record_file_name << std::endl;
+    if (baseline_file_name.empty()) {
+      return 0;
+    }
+  }
+
+  auto base = run_reference ? records[1] : read_records(baseline_file_name);
+  std::cout << std::left << std::setw(16) << "engine" << std::right <<
+    std::setw(10) << "valid" << std::setw(10) << "invalid" <<
+    std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms" <<
+    std::setw(10) << "max ms" << std::setw(10) << "total s" << std::endl;
+  report_engine(run_reference ? reference_name : "baseline", base);
+  report_engine(candidate_name, records[0]);
+
+  bool regressed = compare_records(base, records[0], cost_threshold,
+                                   num_of_worst);
+  std::cout << (regressed ? "FAIL" : "PASS") << std::endl;
+  return regressed ? 1 : 0;
+}
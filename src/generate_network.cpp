@@ -0,0 +1,269 @@
+/* generate_network.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utility.h"
+
+/**
+ * @Brief  Tunable parameters for the synthetic network
+ */
+namespace generatorParam {
+  /**
+   * @Brief  Bounding box of the continental US
+   */
+  constexpr double MIN_LAT = 25.0;
+  constexpr double MAX_LAT = 49.0;
+  constexpr double MIN_LON = -124.0;
+  constexpr double MAX_LON = -67.0;
+
+  /**
+   * @Brief  Largest gap between stations along a corridor,
+   *         so that every corridor can be driven
+   */
+  constexpr double MAX_GAP = 0.6 * constant::FULL_CHARGE;  // km
+
+  /**
+   * @Brief  Spread of stations across a corridor
+   */
+  constexpr double CORRIDOR_WIDTH = 3.0;  // km
+
+  /**
+   * @Brief  Spread of stations around a city
+   */
+  constexpr double CITY_RADIUS = 15.0;  // km
+
+  /**
+   * @Brief  Length of one degree of latitude
+   */
+  constexpr double KM_PER_DEGREE = 111.2;  // km
+}  // namespace generatorParam
+
+/**
+ * @Brief  A point on the map
+ */
+struct Point {
+  double lat;
+  double lon;
+};
+
+/**
+ * @Brief  Move a point by an offset in km
+ */
+Point offset_point(const Point& point, double north, double east) {
+  double lon_scale = generatorParam::KM_PER_DEGREE *
+    std::cos(utility::degree_to_radians(point.lat));
+  return Point{point.lat + north / generatorParam::KM_PER_DEGREE,
+               point.lon + east / lon_scale};
+}
+
+double point_distance(const Point& a, const Point& b) {
+  return utility::calc_great_distance(a.lat, b.lat, a.lon, b.lon);
+}
+
+/**
+ * @Brief  Connect cities with a minimum spanning tree, so every city
+ *         is reachable, plus a corridor to the nearest city
+ */
+std::vector<std::pair<int, int>> make_corridors(
+    const std::vector<Point>& cities) {
+  int num_of_cities = cities.size();
+  std::vector<std::pair<int, int>> corridors;
+  std::vector<bool> in_tree(num_of_cities, false);
+  std::vector<double> link_dists(num_of_cities,
+    std::numeric_limits<double>::infinity());
+  std::vector<int> links(num_of_cities, -1);
+
+  // Prim's algorithm on the complete graph of cities
+  link_dists[0] = 0.0;
+  for (int count=0; count < num_of_cities; ++count) {
+    int next = -1;
+    for (int i=0; i < num_of_cities; ++i) {
+      if (!in_tree[i] && (next < 0 || link_dists[i] < link_dists[next])) {
+        next = i;
+      }
+    }
+
+    in_tree[next] = true;
+    if (links[next] >= 0) {
+      corridors.emplace_back(links[next], next);
+    }
+    for (int i=0; i < num_of_cities; ++i) {
+      double dist = point_distance(cities[next], cities[i]);
+      if (!in_tree[i] && dist < link_dists[i]) {
+        link_dists[i] = dist;
+        links[i] = next;
+      }
+    }
+  }
+
+  for (int i=0; i < num_of_cities; ++i) {
+    int nearest = -1;
+    for (int j=0; j < num_of_cities; ++j) {
+      if (j != i && (nearest < 0 || point_distance(cities[i], cities[j]) <
+                     point_distance(cities[i], cities[nearest]))) {
+        nearest = j;
+      }
+    }
+
+    auto corridor = std::make_pair(std::min(i, nearest),
+                                   std::max(i, nearest));
+    bool exists = std::any_of(corridors.begin(), corridors.end(),
+      [&corridor](const std::pair<int, int>& other) {
+        return std::min(other.first, other.second) == corridor.first &&
+               std::max(other.first, other.second) == corridor.second;
+      });
+    if (nearest >= 0 && !exists) {
+      corridors.push_back(corridor);
+    }
+  }
+
+  return corridors;
+}
+
+int main(int argc, char** argv) {
+  int number_of_stations = 10000;
+  int number_of_cities = 0;
+  int number_of_queries = 100;
+  unsigned int seed = 0;
+  double city_ratio = 0.2;
+  double rate_mean = constant::AVERAGE_RATE;
+  double rate_stddev = 25.0;
+  double rate_min = 60.0;
+  double rate_max = 250.0;
+  std::string output_prefix = "synthetic";
+
+  for (int i=1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--stations") {
+      number_of_stations = std::stoi(argv[i + 1]);
+    } else if (arg == "--cities") {
+      number_of_cities = std::stoi(argv[i + 1]);
+    } else if (arg == "--queries") {
+      number_of_queries = std::stoi(argv[i + 1]);
+    } else if (arg == "--seed") {
+      seed = std::stoul(argv[i + 1]);
+    } else if (arg == "--city-ratio") {
+      city_ratio = std::stod(argv[i + 1]);
+    } else if (arg == "--rate-mean") {
+      rate_mean = std::stod(argv[i + 1]);
+    } else if (arg == "--rate-stddev") {
+      rate_stddev = std::stod(argv[i + 1]);
+    } else if (arg == "--rate-min") {
+      rate_min = std::stod(argv[i + 1]);
+    } else if (arg == "--rate-max") {
+      rate_max = std::stod(argv[i + 1]);
+    } else if (arg == "--output") {
+      output_prefix = argv[i + 1];
+    } else {
+      std::cout << "Usage: generate_network [--stations N] [--cities C] "
+        "[--queries Q] [--seed S] [--city-ratio R]" << std::endl;
+      std::cout << "                        [--rate-mean M] "
+        "[--rate-stddev D] [--rate-min MIN] [--rate-max MAX]" << std::endl;
+      std::cout << "                        [--output prefix]" << std::endl;
+      return -1;
+    }
+  }
+  if (number_of_cities <= 0) {
+    number_of_cities = std::max(2, number_of_stations / 200);
+  }
+
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> lat_dist(
+    generatorParam::MIN_LAT, generatorParam::MAX_LAT);
+  std::uniform_real_distribution<double> lon_dist(
+    generatorParam::MIN_LON, generatorParam::MAX_LON);
+  std::uniform_real_distribution<double> unit_dist(0.0, 1.0);
+  std::normal_distribution<double> across_dist(
+    0.0, generatorParam::CORRIDOR_WIDTH);
+  std::normal_distribution<double> city_dist(
+    0.0, generatorParam::CITY_RADIUS);
+  std::normal_distribution<double> rate_dist(rate_mean, rate_stddev);
+
+  std::vector<Point> cities;
+  for (int i=0; i < number_of_cities; ++i) {
+    cities.push_back(Point{lat_dist(gen), lon_dist(gen)});
+  }
+  auto corridors = make_corridors(cities);
+
+  // Stations are shared by corridor length, and every corridor
+  // gets enough stations to be driven
+  std::vector<double> corridor_lengths;
+  double total_length = 0.0;
+  int min_corridor_stations = 0;
+  for (auto& corridor : corridors) {
+    double length = point_distance(cities[corridor.first],
+                                   cities[corridor.second]);
+    corridor_lengths.push_back(length);
+    total_length += length;
+    min_corridor_stations += std::ceil(length / generatorParam::MAX_GAP);
+  }
+  int corridor_budget = std::max(min_corridor_stations,
+    static_cast<int>(number_of_stations * (1.0 - city_ratio)));
+  int city_budget = std::max(0, number_of_stations - corridor_budget);
+
+  std::vector<Point> stations;
+  for (int c=0; c < corridors.size(); ++c) {
+    auto& from = cities[corridors[c].first];
+    auto& to = cities[corridors[c].second];
+    int count = std::max(
+      static_cast<int>(std::ceil(corridor_lengths[c] / generatorParam::MAX_GAP)),
+      static_cast<int>(corridor_budget * corridor_lengths[c] / total_length));
+
+    // Evenly spaced with jitter along and across the corridor
+    for (int i=0; i < count; ++i) {
+      double t = (i + 0.2 + 0.6 * unit_dist(gen)) / count;
+      Point on_line{from.lat + t * (to.lat - from.lat),
+                    from.lon + t * (to.lon - from.lon)};
+      stations.push_back(offset_point(on_line, across_dist(gen),
+                                      across_dist(gen)));
+    }
+  }
+  for (int i=0; i < city_budget; ++i) {
+    auto& city = cities[i % cities.size()];
+    stations.push_back(offset_point(city, city_dist(gen), city_dist(gen)));
+  }
+
+  std::ofstream network_file(output_prefix + "_network.txt");
+  network_file << "# name lat lon rate" << std::endl;
+  network_file << std::fixed;
+  for (int i=0; i < stations.size(); ++i) {
+    double rate = std::round(
+      std::min(rate_max, std::max(rate_min, rate_dist(gen))));
+    network_file << "Station_" << i << " " <<
+      std::setprecision(6) << stations[i].lat << " " <<
+      stations[i].lon << " " << std::setprecision(1) << rate << "\n";
+  }
+
+  // Queries use the same format as test_data.txt
+  std::ofstream query_file(output_prefix + "_queries.txt");
+  std::uniform_int_distribution<int> station_dist(
+    0, static_cast<int>(stations.size()) - 1);
+  for (int i=0; i < number_of_queries; ++i) {
+    int start = station_dist(gen);
+    int goal;
+    do {
+      goal = station_dist(gen);
+    } while (goal == start);
+    query_file << "Station_" << start << " Station_" << goal << "\n";
+  }
+
+  std::cout << "Generated " << stations.size() << " stations on " <<
+    corridors.size() << " corridors between " << cities.size() <<
+    " cities" << std::endl;
+  std::cout << "Network: " << output_prefix << "_network.txt" << std::endl;
+  std::cout << "Queries: " << output_prefix << "_queries.txt" << std::endl;
+  return 0;
+}
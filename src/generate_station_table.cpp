@@ -0,0 +1,327 @@
+/* generate_station_table.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "station_table.h"
+
+/**
+ * @Brief  Tunable parameters for the perfect hash
+ */
+namespace stationTableParam {
+  /**
+   * @Brief  Average number of names in a bucket
+   *
+   *         Larger buckets make the seed table smaller
+   *         and the seed search longer
+   */
+  constexpr int NAMES_PER_BUCKET = 2;
+
+  /**
+   * @Brief  Seeds tried for a bucket before giving up
+   */
+  constexpr uint32_t MAX_SEED = 1 << 20;
+}  // namespace stationTableParam
+
+/**
+ * @Brief  A station of the network source, with the numbers
+ *         as they are written in the source
+ */
+struct SourceStation {
+  std::string name;
+  std::string lat;
+  std::string lon;
+  std::string rate;
+};
+
+/**
+ * @Brief  Read the next number of a station initializer
+ *
+ * @Param source The content of src/network.cpp
+ * @Param pos The position after the previous field, moved past the number
+ *
+ * @Returns  The number as it is written in the source
+ */
+static std::string read_number(const std::string& source, size_t& pos) {
+  auto begin = source.find_first_not_of(" \t\n", pos + 1);
+  auto end = source.find_first_of(",}", begin);
+  if (begin == std::string::npos || end == std::string::npos) {
+    throw std::invalid_argument("Unterminated station");
+  }
+
+  auto number = source.substr(begin, end - begin);
+  number.erase(number.find_last_not_of(" \t\n") + 1);
+  size_t parsed = 0;
+  try {
+    std::stod(number, &parsed);
+  } catch (const std::exception&) {
+  }
+  if (number.empty() || parsed != number.size()) {
+    throw std::invalid_argument("Bad number " + number);
+  }
+
+  pos = end;
+  return number;
+}
+
+/**
+ * @Brief  Read the stations of the network source in order
+ *
+ *         Every station is written as {"name", lat, lon, rate}
+ *         in the array initializer, and the size of the array
+ *         is checked against the number of stations found.
+ *
+ * @Param source The content of src/network.cpp
+ *
+ * @Returns  The stations in the order of the network
+ */
+static std::vector<SourceStation> read_stations(const std::string& source) {
+  const std::string array_type = "std::array<row,";
+  auto array_pos = source.find(array_type);
+  if (array_pos == std::string::npos) {
+    throw std::invalid_argument("No network array in the source");
+  }
+  size_t array_size = std::stoul(source.substr(array_pos + array_type.size()));
+
+  std::vector<SourceStation> stations;
+  auto pos = source.find("{{", array_pos);
+  while ((pos = source.find("{\"", pos)) != std::string::npos) {
+    auto name_end = source.find('"', pos + 2);
+    if (name_end == std::string::npos) {
+      throw std::invalid_argument("Unterminated station name");
+    }
+
+    SourceStation station;
+    station.name = source.substr(pos + 2, name_end - pos - 2);
+    pos = source.find(',', name_end);
+    if (pos == std::string::npos) {
+      throw std::invalid_argument("Unterminated station " + station.name);
+    }
+    station.lat = read_number(source, pos);
+    station.lon = read_number(source, pos);
+    station.rate = read_number(source, pos);
+    if (source[pos] != '}') {
+      throw std::invalid_argument("Extra field in station " + station.name);
+    }
+    stations.push_back(station);
+  }
+
+  if (stations.size() != array_size) {
+    throw std::invalid_argument("Found " + std::to_string(stations.size()) +
+      " stations in an array of " + std::to_string(array_size));
+  }
+  if (stations.size() > std::numeric_limits<uint16_t>::max()) {
+    throw std::invalid_argument("Too many stations for 16-bit ids");
+  }
+  std::unordered_set<std::string> unique_names;
+  for (auto& station : stations) {
+    if (!unique_names.insert(station.name).second) {
+      throw std::invalid_argument("Duplicated station name " + station.name);
+    }
+  }
+  return stations;
+}
+
+/**
+ * @Brief  Find a seed for every bucket, so that every name
+ *         gets its own slot
+ *
+ *         Hash and displace: the largest buckets are placed first,
+ *         while most slots are still free
+ *
+ * @Param names The station names
+ * @Param num_of_buckets The number of buckets
+ * @Param ids Filled with the id of the name in every slot
+ *
+ * @Returns  The seed of every bucket
+ */
+static std::vector<uint32_t> find_seeds(const std::vector<std::string>& names,
+                                        uint32_t num_of_buckets,
+                                        std::vector<int>& ids) {
+  uint32_t num_of_slots = names.size();
+  std::vector<uint64_t> hashes;
+  std::vector<std::vector<int>> buckets(num_of_buckets);
+  for (int id=0; id < names.size(); ++id) {
+    auto& name = names[id];
+    hashes.push_back(station_table::hash(name.data(), name.size()));
+    buckets[(hashes[id] >> 32) % num_of_buckets].push_back(id);
+  }
+
+  std::vector<uint32_t> order(num_of_buckets);
+  for (uint32_t i=0; i < num_of_buckets; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+    [&buckets](uint32_t a, uint32_t b) {
+      return buckets[a].size() > buckets[b].size();
+    });
+
+  std::vector<uint32_t> seeds(num_of_buckets, 0);
+  ids.assign(num_of_slots, -1);
+  std::vector<uint32_t> slots;
+  for (auto bucket : order) {
+    if (buckets[bucket].empty()) {
+      break;
+    }
+
+    bool placed = false;
+    for (uint32_t seed=0; seed < stationTableParam::MAX_SEED; ++seed) {
+      slots.clear();
+      for (auto id : buckets[bucket]) {
+        uint32_t slot =
+          station_table::displace(hashes[id], seed) % num_of_slots;
+        if (ids[slot] != -1 ||
+            std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+          break;
+        }
+        slots.push_back(slot);
+      }
+
+      if (slots.size() == buckets[bucket].size()) {
+        for (int i=0; i < slots.size(); ++i) {
+          ids[slots[i]] = buckets[bucket][i];
+        }
+        seeds[bucket] = seed;
+        placed = true;
+        break;
+      }
+    }
+
+    if (!placed) {
+      throw std::runtime_error("No seed places bucket " +
+                               std::to_string(bucket));
+    }
+  }
+
+  return seeds;
+}
+
+/**
+ * @Brief  Write a list of values as the body of an array initializer
+ */
+template <typename T>
+static void write_values(std::ostream& output, const std::vector<T>& values) {
+  for (int i=0; i < values.size(); ++i) {
+    output << ((i % 10 == 0) ? "\n    " : " ") << values[i] << ",";
+  }
+  output << "\n";
+}
+
+/**
+ * @Brief  Generate the station table header from the network source
+ *
+ *         Run by the build whenever src/network.cpp changes, so the
+ *         table always has the same stations in the same order, and
+ *         the same numbers as they are written in the source
+ */
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " network.cpp station_table_data.h"
+      << std::endl;
+    return 1;
+  }
+
+  std::ifstream source_file(argv[1]);
+  if (!source_file.is_open()) {
+    std::cerr << "Cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::stringstream source;
+  source << source_file.rdbuf();
+
+  std::vector<SourceStation> stations;
+  std::vector<std::string> names;
+  std::vector<uint32_t> seeds;
+  std::vector<int> ids;
+  uint32_t num_of_buckets = 0;
+  try {
+    stations = read_stations(source.str());
+    for (auto& station : stations) {
+      names.push_back(station.name);
+    }
+    num_of_buckets = std::max<uint32_t>(1,
+      (names.size() + stationTableParam::NAMES_PER_BUCKET - 1) /
+      stationTableParam::NAMES_PER_BUCKET);
+    seeds = find_seeds(names, num_of_buckets, ids);
+  } catch (const std::exception& e) {
+    std::cerr << argv[1] << ": " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::vector<size_t> lengths;
+  std::vector<std::string> lats;
+  std::vector<std::string> lons;
+  std::vector<std::string> rates;
+  for (auto& station : stations) {
+    lengths.push_back(station.name.size());
+    lats.push_back(station.lat);
+    lons.push_back(station.lon);
+    rates.push_back(station.rate);
+  }
+
+  std::stringstream output;
+  output <<
+    "/* station_table_data.h\n"
+    " *\n"
+    " * Generated by generate_station_table from src/network.cpp,\n"
+    " * do not edit\n"
+    " */\n"
+    "\n"
+    "#pragma once\n"
+    "#include <cstddef>\n"
+    "#include <cstdint>\n"
+    "\n"
+    "namespace station_table_data {\n"
+    "  constexpr int NUM_OF_STATIONS = " << names.size() << ";\n"
+    "  constexpr uint32_t NUM_OF_BUCKETS = " << num_of_buckets << ";\n"
+    "\n"
+    "  constexpr const char* NAMES[NUM_OF_STATIONS] = {";
+  for (auto& name : names) {
+    output << "\n    \"" << name << "\",";
+  }
+  output << "\n  };\n\n";
+
+  output << "  constexpr size_t LENGTHS[NUM_OF_STATIONS] = {";
+  write_values(output, lengths);
+  output << "  };\n\n";
+
+  output << "  constexpr double LATS[NUM_OF_STATIONS] = {";
+  write_values(output, lats);
+  output << "  };\n\n";
+
+  output << "  constexpr double LONS[NUM_OF_STATIONS] = {";
+  write_values(output, lons);
+  output << "  };\n\n";
+
+  output << "  constexpr double RATES[NUM_OF_STATIONS] = {";
+  write_values(output, rates);
+  output << "  };\n\n";
+
+  output << "  constexpr uint32_t SEEDS[NUM_OF_BUCKETS] = {";
+  write_values(output, seeds);
+  output << "  };\n\n";
+
+  output << "  constexpr uint16_t IDS[NUM_OF_STATIONS] = {";
+  write_values(output, ids);
+  output << "  };\n";
+  output << "}  // namespace station_table_data\n";
+
+  std::ofstream output_file(argv[2]);
+  if (!output_file.is_open()) {
+    std::cerr << "Cannot write " << argv[2] << std::endl;
+    return 1;
+  }
+  output_file << output.str();
+  return 0;
+}
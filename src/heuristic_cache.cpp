@@ -0,0 +1,189 @@
+/* heuristic_cache.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <tuple>
+#include <utility>
+
+#include "heuristic_cache.h"
+
+/**
+ * @Brief  Goal, range, speed and database state version of a goal table
+ */
+typedef std::tuple<int, double, double, unsigned long> GoalTableKey;
+
+/**
+ * @Brief  Goal tables from the most to the least recently used
+ *
+ *         Guarded by a mutex for searches running in parallel
+ */
+struct GoalTableCache {
+  typedef std::pair<GoalTableKey, std::shared_ptr<const GoalTable>> Entry;
+
+  std::list<Entry> entries;
+  std::map<GoalTableKey, std::list<Entry>::iterator> index;
+  size_t capacity = heuristicParam::DEFAULT_CAPACITY;
+  size_t hits = 0;
+  size_t misses = 0;
+  std::mutex mutex;
+};
+
+static GoalTableCache& goal_table_cache() {
+  static GoalTableCache cache;
+  return cache;
+}
+
+double GoalTableStats::hit_rate() const {
+  size_t lookups = hits + misses;
+  return (lookups > 0) ? static_cast<double>(hits) / lookups : 0.0;
+}
+
+double GoalTable::remaining_time(int id, double charge) const {
+  double goal_dist = goal_dists[id];
+  if (goal_dist == std::numeric_limits<double>::infinity()) {
+    return goal_dist;
+  }
+
+  // The goal itself needs no charge and has no rate
+  double lacking_charge = goal_dist - charge;
+  if (lacking_charge <= 0.0) {
+    return goal_dist / speed;
+  }
+
+  return goal_dist / speed + lacking_charge / max_rate;
+}
+
+GoalTable heuristic::build_goal_table(
+    int goal_id, const VehicleProfile& vehicle) {
+  GoalTable table;
+  table.speed = vehicle.speed;
+  table.goal_dists.assign(database::num_of_chargers(),
+    std::numeric_limits<double>::infinity());
+  if (!database::charger_available(
+        database::get_charger_record(goal_id).name)) {
+    return table;
+  }
+
+  // Neighbor tables are symmetric, so the stations that can drive to
+  // a station are its neighbors
+  typedef std::pair<double, int> DistAndId;
+  std::priority_queue<DistAndId, std::vector<DistAndId>,
+                      std::greater<DistAndId>> queue;
+  auto& goal_dists = table.goal_dists;
+  goal_dists[goal_id] = 0.0;
+  queue.emplace(0.0, goal_id);
+
+  while (!queue.empty()) {
+    auto curr = queue.top();
+    queue.pop();
+
+    int curr_id = curr.second;
+    if (curr.first > goal_dists[curr_id]) {
+      continue;
+    }
+
+    // The car does not charge at the goal
+    if (curr_id != goal_id) {
+      auto& record = database::get_charger_record(curr_id);
+      auto profile = database::get_time_profile(record.name);
+      double rate = (profile != nullptr) ?
+        std::max(record.rate, profile->rate.max_value()) : record.rate;
+      table.max_rate = std::max(table.max_rate, rate);
+    }
+
+    auto& neighbor_table =
+      database::get_neighbor_table(curr_id, vehicle.full_charge);
+    for (int i=0; i < neighbor_table.ids.size(); ++i) {
+      int prev_id = neighbor_table.ids[i];
+      double dist = curr.first + neighbor_table.dists[i];
+      if (dist < goal_dists[prev_id]) {
+        goal_dists[prev_id] = dist;
+        queue.emplace(dist, prev_id);
+      }
+    }
+  }
+
+  return table;
+}
+
+std::shared_ptr<const GoalTable> heuristic::goal_table(
+    int goal_id, const VehicleProfile& vehicle) {
+  auto& cache = goal_table_cache();
+  GoalTableKey key(goal_id, vehicle.full_charge, vehicle.speed,
+                   database::state_version());
+
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto cached_entry = cache.index.find(key);
+    if (cached_entry != cache.index.end()) {
+      cache.hits++;
+      cache.entries.splice(cache.entries.begin(), cache.entries,
+                           cached_entry->second);
+      return cached_entry->second->second;
+    }
+    cache.misses++;
+  }
+
+  // The backward search runs without the lock, so searches to other
+  // goals are not blocked. Two searches to a new goal may both build
+  // the table, and the first one is kept.
+  auto table = std::make_shared<const GoalTable>(
+    build_goal_table(goal_id, vehicle));
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  auto cached_entry = cache.index.find(key);
+  if (cached_entry != cache.index.end()) {
+    return cached_entry->second->second;
+  }
+  if (cache.capacity == 0) {
+    return table;
+  }
+
+  while (cache.entries.size() >= cache.capacity) {
+    cache.index.erase(cache.entries.back().first);
+    cache.entries.pop_back();
+  }
+  cache.entries.emplace_front(key, table);
+  cache.index[key] = cache.entries.begin();
+
+  return table;
+}
+
+void heuristic::set_capacity(size_t capacity) {
+  auto& cache = goal_table_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.capacity = capacity;
+  while (cache.entries.size() > cache.capacity) {
+    cache.index.erase(cache.entries.back().first);
+    cache.entries.pop_back();
+  }
+}
+
+void heuristic::clear() {
+  auto& cache = goal_table_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.entries.clear();
+  cache.index.clear();
+  cache.hits = 0;
+  cache.misses = 0;
+}
+
+GoalTableStats heuristic::stats() {
+  auto& cache = goal_table_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  GoalTableStats stats;
+  stats.hits = cache.hits;
+  stats.misses = cache.misses;
+  stats.size = cache.entries.size();
+  stats.capacity = cache.capacity;
+  return stats;
+}
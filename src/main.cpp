@@ -1,17 +1,184 @@
 #include <iostream>
 #include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
 
+#include "batch_pipeline.h"
 #include "network.h"
+#include "parallel_solver.h"
 #include "path_solver.h"
+#include "reachability_solver.h"
+#include "region_planner.h"
+#include "trace.h"
+#include "trip_planner.h"
 
 int main(int argc, char** argv) {
-  if (argc != 3) {
+  // Vehicle options can be given anywhere in the arguments
+  double full_charge = constant::FULL_CHARGE;
+  double speed = constant::SPEED;
+  double init_charge = -1;
+  double departure_time = -1;
+  int num_of_alternatives = 0;
+  std::string preset = "default";
+  std::string trace_prefix;
+  int num_of_regions = 0;
+  std::string network_file;
+  std::string profile_file;
+  std::string curve_file;
+  std::string batch_file;
+  int num_of_threads = 0;
+  bool validate = false;
+  bool show_stats = false;
+  bool parallel_search = false;
+  std::string alloc_log_file;
+  std::vector<std::string> waypoints;
+  bool has_waypoints = false;
+  std::vector<std::string> args;
+  for (int i=1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--range" && i + 1 < argc) {
+      full_charge = std::stod(argv[++i]);
+    } else if (arg == "--speed" && i + 1 < argc) {
+      speed = std::stod(argv[++i]);
+    } else if (arg == "--charge" && i + 1 < argc) {
+      init_charge = std::stod(argv[++i]);
+    } else if (arg == "--depart" && i + 1 < argc) {
+      departure_time = std::stod(argv[++i]);
+    } else if (arg == "--network" && i + 1 < argc) {
+      network_file = argv[++i];
+    } else if (arg == "--profiles" && i + 1 < argc) {
+      profile_file = argv[++i];
+    } else if (arg == "--curves" && i + 1 < argc) {
+      curve_file = argv[++i];
+    } else if (arg == "--alternatives" && i + 1 < argc) {
+      num_of_alternatives = std::stoi(argv[++i]);
+    } else if (arg == "--preset" && i + 1 < argc) {
+      preset = argv[++i];
+    } else if (arg == "--regions" && i + 1 < argc) {
+      num_of_regions = std::stoi(argv[++i]);
+    } else if (arg == "--trace" && i + 1 < argc) {
+      trace_prefix = argv[++i];
+    } else if (arg == "--batch" && i + 1 < argc) {
+      batch_file = argv[++i];
+    } else if (arg == "--threads" && i + 1 < argc) {
+      num_of_threads = std::stoi(argv[++i]);
+    } else if (arg == "--validate") {
+      validate = true;
+    } else if (arg == "--stats") {
+      show_stats = true;
+    } else if (arg == "--parallel") {
+      parallel_search = true;
+    } else if (arg == "--alloc-log" && i + 1 < argc) {
+      alloc_log_file = argv[++i];
+    } else if (arg == "--waypoints" && i + 1 < argc) {
+      // Comma separated names of the stations to visit in any order
+      has_waypoints = true;
+      std::stringstream waypoint_stream(argv[++i]);
+      std::string waypoint;
+      while (std::getline(waypoint_stream, waypoint, ',')) {
+        if (!waypoint.empty()) {
+          waypoints.push_back(waypoint);
+        }
+      }
+    } else {
+      args.push_back(arg);
+    }
+  }
+#ifndef SEARCH_TRACE
+  // Without SEARCH_TRACE no event is recorded, so the trace would be empty
+  if (!trace_prefix.empty()) {
+    std::cout << "Error: --trace requires a build with SEARCH_TRACE" << std::endl;
+    return -1;
+  }
+#endif
+
+  // Loading a network drops time profiles, so it goes first
+  if (!network_file.empty()) {
+    database::load_network(network_file);
+  }
+  if (!profile_file.empty()) {
+    database::load_time_profiles(profile_file);
+  }
+  if (!curve_file.empty()) {
+    database::load_charging_curves(curve_file);
+  }
+
+  // Without the current charge the car starts with full charge
+  if (init_charge < 0) {
+    init_charge = full_charge;
+  }
+  VehicleProfile vehicle(full_charge, speed, init_charge);
+
+  // Batch mode: answer a stream of "start goal" lines in input order
+  if (!batch_file.empty() && args.empty()) {
+    BatchConfig batch_config;
+    batch_config.num_of_workers = num_of_threads;
+    batch_config.validate = validate;
+    batch_config.solver_config = PathSolverConfig::preset(preset);
+    batch_config.vehicle = vehicle;
+
+    BatchPipeline pipeline(batch_config);
+    std::ifstream batch_input;
+    if (batch_file != "-") {
+      batch_input.open(batch_file);
+      if (!batch_input.is_open()) {
+        std::cout << "Error: cannot open " << batch_file << std::endl;
+        return -1;
+      }
+    }
+    std::ofstream alloc_log;
+    if (!alloc_log_file.empty()) {
+      alloc_log.open(alloc_log_file);
+      if (!alloc_log.is_open()) {
+        std::cout << "Error: cannot write " << alloc_log_file << std::endl;
+        return -1;
+      }
+    }
+    pipeline.run(batch_file == "-" ? std::cin : batch_input, std::cout,
+                 show_stats ? &std::cerr : nullptr,
+                 alloc_log.is_open() ? &alloc_log : nullptr);
+    return 0;
+  }
+
+  // Reachability mode: stream every charger reachable within the time budget
+  if (args.size() == 3 && args[0] == "--reachable") {
+    std::string initial_charger_name = args[1];
+    double time_budget = std::stod(args[2]);
+
+    ReachabilitySolver reach_solver(initial_charger_name, time_budget, vehicle);
+    reach_solver.solve([](const ReachableCharger& reached) {
+      std::cout << reached.name << ", " <<
+        std::fixed << std::setprecision(5) <<
+        reached.arrival_time << ", " <<
+        reached.arrival_charge << std::endl;
+    });
+    return 0;
+  }
+
+  if (args.size() != 2) {
       std::cout << "Error: requires initial and final supercharger names" << std::endl;
+      std::cout << "       or --reachable initial_charger_name time_budget_in_hours" << std::endl;
+      std::cout << "       or --batch query_file (- for stdin) [--threads N] [--validate] [--stats] [--alloc-log log_file]" << std::endl;
+      std::cout << "Options: --range full_charge_in_km --speed speed_in_km_per_hr" << std::endl;
+      std::cout << "         --charge current_charge_in_km" << std::endl;
+      std::cout << "         --profiles time_profile_file --depart departure_hour" << std::endl;
+      std::cout << "         --curves charging_curve_file" << std::endl;
+      std::cout << "         --network network_file" << std::endl;
+      std::cout << "         --regions number_of_worker_processes" << std::endl;
+      std::cout << "         --waypoints charger_name,charger_name,..." << std::endl;
+      std::cout << "         --alternatives number_of_paths" << std::endl;
+      std::cout << "         --preset default|balanced|fast" << std::endl;
+      std::cout << "         --threads number_of_search_threads" << std::endl;
+      std::cout << "         --parallel (one query on --threads threads, experimental)" << std::endl;
+      std::cout << "         --trace output_prefix (built with SEARCH_TRACE)" << std::endl;
       return -1;
   }
 
-  std::string initial_charger_name = argv[1];
-  std::string goal_charger_name = argv[2];
+  std::string initial_charger_name = args[0];
+  std::string goal_charger_name = args[1];
 
   // double average_rate = 0.0;
   // for (auto charger : network) {
@@ -19,9 +186,61 @@ int main(int argc, char** argv) {
   // }
   // std::cout << average_rate / network.size() << std::endl;
 
-  PathSolver my_solver(initial_charger_name, goal_charger_name);
+  // Visit every waypoint in the fastest order on the way to the goal
+  if (has_waypoints) {
+    TripPlanner trip_planner(initial_charger_name, waypoints,
+                             goal_charger_name, vehicle, num_of_threads);
+    std::cout << trip_planner.solve() << std::endl;
+    return 0;
+  }
+
+  // Split the network into regions served by worker processes
+  if (num_of_regions > 0) {
+    RegionPlanner region_planner(num_of_regions, vehicle);
+    std::cout << region_planner.solve(initial_charger_name,
+                                      goal_charger_name) << std::endl;
+    return 0;
+  }
+
+  // Search a single query on several threads, only when asked for
+  if (parallel_search && num_of_threads > 1 && departure_time < 0 &&
+      num_of_alternatives == 0 && trace_prefix.empty()) {
+    ParallelSolver parallel_solver(initial_charger_name, goal_charger_name,
+                                   vehicle, num_of_threads);
+    parallel_solver.set_config(PathSolverConfig::preset(preset));
+    std::cout << parallel_solver.solve() << std::endl;
+    return 0;
+  }
+
+  PathSolver my_solver(initial_charger_name, goal_charger_name, vehicle);
+  my_solver.set_config(PathSolverConfig::preset(preset));
+  if (departure_time >= 0) {
+    my_solver.set_departure_time(departure_time);
+  }
+
+  // Print the best path and its alternatives, one path per line
+  if (num_of_alternatives > 0) {
+    auto alternatives = my_solver.solve_alternatives(num_of_alternatives);
+    for (auto& alternative : alternatives) {
+      std::cout << alternative.to_string() << std::endl;
+    }
+    return 0;
+  }
+
+  if (!trace_prefix.empty()) {
+    trace::start();
+  }
+
   auto solution = my_solver.solve();
 
   std::cout << solution << std::endl;
+
+  // Write the search trace and the expansion heat layer
+  if (!trace_prefix.empty()) {
+    trace::stop();
+    auto events = trace::events();
+    std::ofstream(trace_prefix + ".json") << trace::to_chrome_json(events);
+    std::ofstream(trace_prefix + ".geojson") << trace::to_geojson(events);
+  }
   return 0;
 }
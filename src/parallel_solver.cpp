@@ -0,0 +1,475 @@
+/* parallel_solver.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "heuristic_cache.h"
+#include "parallel_solver.h"
+#include "utility.h"
+
+/**
+ * @Brief  Convert a cost in hours to the fixed point of the queue
+ */
+static int64_t to_cost_units(double cost) {
+  return static_cast<int64_t>(
+    std::llround(cost * pathSolverParam::COST_UNITS_PER_HOUR));
+}
+
+ParallelSolver::Worker::Worker(int num_of_threads):
+  inbox(parallelSolverParam::INBOX_CAPACITY),
+  outboxes(num_of_threads),
+  min_cost{std::numeric_limits<int64_t>::max()},
+  inbox_min_cost{std::numeric_limits<int64_t>::max()} {
+}
+
+void ParallelSolver::WorkerDeleter::operator()(Worker* worker) const {
+  worker->~Worker();
+  std::free(worker);
+}
+
+std::unique_ptr<ParallelSolver::Worker, ParallelSolver::WorkerDeleter>
+ParallelSolver::new_worker(int num_of_threads) {
+  void* memory = nullptr;
+  if (posix_memalign(&memory, alignof(Worker), sizeof(Worker)) != 0) {
+    throw std::bad_alloc();
+  }
+
+  try {
+    return std::unique_ptr<Worker, WorkerDeleter>(
+      new (memory) Worker(num_of_threads));
+  } catch (...) {
+    std::free(memory);
+    throw;
+  }
+}
+
+ParallelSolver::ParallelSolver(
+  const std::string& start_charger,
+  const std::string& goal_charger,
+  const VehicleProfile& vehicle,
+  int num_of_threads):
+  start_charger_{start_charger},
+  goal_charger_{goal_charger},
+  vehicle_(vehicle),
+  num_of_threads_{num_of_threads},
+  start_id_{database::get_charger_id(start_charger)},
+  goal_id_{database::get_charger_id(goal_charger)},
+  best_cost_{std::numeric_limits<int64_t>::max()},
+  best_path_(start_charger, goal_charger, vehicle),
+  generation_{0},
+  pending_nodes_{0},
+  queued_nodes_{0},
+  done_{false} {
+  if (num_of_threads_ <= 0) {
+    num_of_threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  auto& goal_record = database::get_charger_record(goal_id_);
+  for (int id=0; id < database::num_of_chargers(); ++id) {
+    goal_dists_.push_back(id == goal_id_ ? 0.0 :
+      utility::calc_great_distance(
+        database::get_charger_record(id), goal_record));
+  }
+
+  this->set_config(PathSolverConfig());
+}
+
+void ParallelSolver::set_cost_window(double cost_window) {
+  if (cost_window < 0.0) {
+    throw std::invalid_argument("Cost window cannot be negative");
+  }
+  cost_window_ = cost_window;
+}
+
+void ParallelSolver::set_config(const PathSolverConfig& config) {
+  config_ = config;
+  goal_table_ = config_.use_goal_table ?
+    heuristic::goal_table(goal_id_, vehicle_) : nullptr;
+}
+
+int ParallelSolver::owner(int charger_id) const {
+  // Neighboring stations have neighboring ids in generated networks,
+  // so the ids are mixed before they are spread over the threads
+  uint32_t hash = static_cast<uint32_t>(charger_id) * 2654435761u;
+  return (hash >> 16) % num_of_threads_;
+}
+
+std::shared_ptr<Path> ParallelSolver::build_path(
+    const std::vector<int>& ids) const {
+  std::shared_ptr<Path> path_ptr =
+    std::make_shared<Path>(start_charger_, goal_charger_, vehicle_);
+  for (int i=1; i < ids.size(); ++i) {
+    // Same distance as the neighbor table the node was scored with
+    auto& record = database::get_charger_record(ids[i]);
+    double dist = utility::calc_great_distance(
+      database::get_charger_record(ids[i - 1]), record);
+    path_ptr->add_charger(record.name, dist);
+  }
+
+  return path_ptr;
+}
+
+ParallelNode ParallelSolver::start_node(int generation) const {
+  Path init_path(start_charger_, goal_charger_, vehicle_);
+  ParallelNode node;
+  node.cost = to_cost_units(init_path.heuristic_cost());
+  node.bound = to_cost_units(goal_dists_[start_id_] / vehicle_.speed);
+  node.generation = generation;
+  node.ids = {start_id_};
+  return node;
+}
+
+std::string ParallelSolver::solve() {
+  return route::to_string(this->solve_route());
+}
+
+RouteResult ParallelSolver::solve_route() {
+  workers_.clear();
+  for (int i=0; i < num_of_threads_; ++i) {
+    workers_.push_back(this->new_worker(num_of_threads_));
+  }
+
+  best_cost_ = std::numeric_limits<int64_t>::max();
+  best_path_ = Path(start_charger_, goal_charger_, vehicle_);
+  generation_ = 0;
+  candidate_count_ = 0;
+  reset_limit_ = false;
+  done_ = false;
+
+  // The start is queued before any thread runs
+  auto& start_worker = *workers_[this->owner(start_id_)];
+  start_worker.open_list.push_back(this->start_node(0));
+  pending_nodes_ = 1;
+  queued_nodes_ = 1;
+
+  // The calling thread searches as the first thread
+  std::vector<std::thread> threads;
+  for (int i=1; i < num_of_threads_; ++i) {
+    threads.emplace_back(&ParallelSolver::search, this, i);
+  }
+  this->search(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  nodes_expanded_ = 0;
+  for (auto& worker : workers_) {
+    nodes_expanded_ += worker->nodes_expanded;
+  }
+
+  if (best_cost_.load() == std::numeric_limits<int64_t>::max()) {
+    return RouteResult();
+  }
+  return best_path_.to_route_result(
+    reset_limit_ ? RouteStatus::RESET_LIMIT : RouteStatus::SUCCESS);
+}
+
+void ParallelSolver::search(int index) {
+  auto& worker = *workers_[index];
+  int tries = 0;
+  while (!done_.load(std::memory_order_acquire)) {
+    this->sync_generation(worker);
+    this->receive(worker);
+    this->flush(worker);
+
+    if (this->search_next(worker, index)) {
+      tries = 0;
+      continue;
+    }
+
+    // Nothing is queued or on its way anywhere
+    if (pending_nodes_.load() == 0) {
+      done_.store(true, std::memory_order_release);
+      break;
+    }
+    BoundedQueue<ParallelNode>::backoff(tries++);
+  }
+}
+
+bool ParallelSolver::search_next(Worker& worker, int index) {
+  auto& open_list = worker.open_list;
+
+  // Nodes that did not fit into an inbox are still held by this thread
+  worker.min_cost.store(this->held_min_cost(worker),
+                        std::memory_order_release);
+
+  if (open_list.empty()) {
+    return false;
+  }
+
+  // Nodes are searched about in the order of the sequential search,
+  // and a finished path waits while another thread can still find
+  // a cheaper one
+  bool reached_goal = open_list.front().ids.back() == goal_id_;
+  int64_t cost = open_list.front().cost;
+  if (!reached_goal) {
+    cost -= static_cast<int64_t>(cost_window_ * cost);
+  }
+  if (!this->is_cheapest(index, cost)) {
+    return false;
+  }
+
+  std::pop_heap(open_list.begin(), open_list.end());
+  ParallelNode node = std::move(open_list.back());
+  open_list.pop_back();
+  queued_nodes_--;
+
+  // Another thread may have restarted the search in the meantime
+  bool current = node.generation == generation_.load();
+  if (current && reached_goal) {
+    auto path_ptr = this->build_path(node.ids);
+    this->finish_candidate(*path_ptr, node.generation);
+
+  } else if (current &&
+             node.bound < best_cost_.load(std::memory_order_relaxed)) {
+    if (queued_nodes_.load() > config_.max_queue_size) {
+      this->restart(worker, node.generation);
+    } else {
+      auto path_ptr = this->build_path(node.ids);
+      this->expand(worker, *path_ptr, node);
+      worker.nodes_expanded++;
+    }
+  }
+
+  // The children are counted, so the node is done
+  pending_nodes_--;
+  return true;
+}
+
+bool ParallelSolver::is_cheapest(int index, int64_t cost) const {
+  for (int i=0; i < num_of_threads_; ++i) {
+    if (i != index &&
+        std::min(workers_[i]->min_cost.load(),
+                 workers_[i]->inbox_min_cost.load()) < cost) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void ParallelSolver::finish_candidate(Path& path, int generation) {
+  // If only start and goal in path (Shortest path),
+  // then return the path
+  if (path.num_of_chargers() == 2) {
+    this->update_best_cost(to_cost_units(path.time_cost()));
+    std::lock_guard<std::mutex> lock(best_path_mutex_);
+    best_path_ = path;
+    done_ = true;
+    return;
+  }
+
+  if (this->update_best_cost(to_cost_units(path.time_cost()))) {
+    std::lock_guard<std::mutex> lock(best_path_mutex_);
+    best_path_ = path;
+  }
+
+  candidate_count_++;
+  // Compare multiple candidates for better result
+  if (candidate_count_ >= config_.num_of_candidate) {
+    done_ = true;
+  } else if (generation >= config_.max_reset) {
+    reset_limit_ = true;
+    done_ = true;
+  }
+}
+
+bool ParallelSolver::update_best_cost(int64_t cost) {
+  int64_t best_cost = best_cost_.load();
+  while (cost < best_cost) {
+    if (best_cost_.compare_exchange_weak(best_cost, cost)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ParallelSolver::expand(Worker& worker, Path& parent,
+                            const ParallelNode& node) {
+  int curr_id = node.ids.back();
+  auto& neighbor_table =
+    database::get_neighbor_table(curr_id, vehicle_.full_charge);
+  double goal_weight = config_.default_goal_weight +
+    node.generation * config_.goal_weight_step;
+  double goal_factor =
+    goal_weight / vehicle_.speed + 1.0 / constant::AVERAGE_RATE;
+
+  auto base = parent.child_cost_base();
+  double charge = goal_table_ ? parent.current_charge() : 0.0;
+  for (int i=0; i < neighbor_table.ids.size(); ++i) {
+    int id = neighbor_table.ids[i];
+    if (std::find(node.ids.begin(), node.ids.end(), id) != node.ids.end()) {
+      continue;
+    }
+
+    // Same heuristic cost as PathSolver, stations that
+    // cannot reach the goal are dropped
+    double time = base.child_time(neighbor_table.dists[i]);
+    double cost;
+    double remaining_time;
+    if (goal_table_) {
+      remaining_time = goal_table_->remaining_time(
+        id, std::max(0.0, charge - neighbor_table.dists[i]));
+      if (remaining_time == std::numeric_limits<double>::infinity()) {
+        continue;
+      }
+      cost = time + goal_weight * remaining_time;
+    } else {
+      cost = base.greedy_child_time(neighbor_table.dists[i]) +
+        goal_factor * goal_dists_[id];
+      remaining_time = goal_dists_[id] / vehicle_.speed;
+    }
+
+    // The rest of the way takes at least the driving time, or the
+    // goal table bound, finished paths are kept to be counted as candidates
+    int64_t bound = to_cost_units(time + remaining_time);
+    if (id != goal_id_ &&
+        bound >= best_cost_.load(std::memory_order_relaxed)) {
+      continue;
+    }
+
+    ParallelNode child;
+    child.cost = to_cost_units(cost);
+    child.bound = bound;
+    child.generation = node.generation;
+    child.ids.reserve(node.ids.size() + 1);
+    child.ids = node.ids;
+    child.ids.push_back(id);
+    this->send(worker, std::move(child));
+  }
+}
+
+void ParallelSolver::send(Worker& worker, ParallelNode node) {
+  // Children of a node from before a restart are not needed
+  if (node.generation != generation_.load()) {
+    return;
+  }
+
+  pending_nodes_++;
+  queued_nodes_++;
+  int target = this->owner(node.ids.back());
+  if (workers_[target].get() == &worker) {
+    worker.open_list.push_back(std::move(node));
+    std::push_heap(worker.open_list.begin(), worker.open_list.end());
+  } else {
+    // The node is held by this thread until its owner received it
+    if (node.cost < worker.min_cost.load()) {
+      worker.min_cost.store(node.cost);
+    }
+    worker.outboxes[target].push_back(std::move(node));
+  }
+}
+
+void ParallelSolver::flush(Worker& worker) {
+  for (int i=0; i < num_of_threads_; ++i) {
+    auto& outbox = worker.outboxes[i];
+    auto& target = *workers_[i];
+    int sent = 0;
+    while (sent < outbox.size()) {
+      // The min cost of this thread still covers the node until its next
+      // search, and the cost of the inbox covers it from now on, so the
+      // node is never missed by a thread waiting for cheaper nodes
+      int64_t cost = outbox[sent].cost;
+      if (!target.inbox.try_push(outbox[sent])) {
+        break;
+      }
+      int64_t inbox_min_cost = target.inbox_min_cost.load();
+      while (cost < inbox_min_cost &&
+             !target.inbox_min_cost.compare_exchange_weak(
+               inbox_min_cost, cost)) {
+      }
+      sent++;
+    }
+    outbox.erase(outbox.begin(), outbox.begin() + sent);
+  }
+}
+
+void ParallelSolver::receive(Worker& worker) {
+  this->drain_inbox(worker);
+
+  // The cost of the inbox is taken over by the thread before it is
+  // reset, so a node sent in the meantime is covered by one of them.
+  // A node sent before the reset is taken by the second drain, and one
+  // sent after it lowers the cost of the inbox again.
+  int64_t inbox_min_cost = worker.inbox_min_cost.load();
+  do {
+    worker.min_cost.store(std::min(worker.min_cost.load(), inbox_min_cost));
+  } while (!worker.inbox_min_cost.compare_exchange_weak(
+             inbox_min_cost, std::numeric_limits<int64_t>::max()));
+  this->drain_inbox(worker);
+
+  // Every node the thread holds is in the open list or an outbox now
+  worker.min_cost.store(this->held_min_cost(worker));
+}
+
+void ParallelSolver::drain_inbox(Worker& worker) {
+  ParallelNode node;
+  while (worker.inbox.try_pop(node)) {
+    // The sender can be a restart ahead of this thread
+    if (node.generation > worker.generation) {
+      this->sync_generation(worker);
+    }
+    if (node.generation < worker.generation) {
+      pending_nodes_--;
+      continue;
+    }
+    worker.open_list.push_back(std::move(node));
+    std::push_heap(worker.open_list.begin(), worker.open_list.end());
+  }
+}
+
+int64_t ParallelSolver::held_min_cost(const Worker& worker) const {
+  int64_t min_cost = worker.open_list.empty() ?
+    std::numeric_limits<int64_t>::max() : worker.open_list.front().cost;
+  for (auto& outbox : worker.outboxes) {
+    for (auto& node : outbox) {
+      min_cost = std::min(min_cost, node.cost);
+    }
+  }
+
+  return min_cost;
+}
+
+void ParallelSolver::sync_generation(Worker& worker) {
+  int generation = generation_.load();
+  if (worker.generation == generation) {
+    return;
+  }
+
+  long dropped = worker.open_list.size();
+  worker.open_list.clear();
+  for (auto& outbox : worker.outboxes) {
+    dropped += outbox.size();
+    outbox.clear();
+  }
+  pending_nodes_ -= dropped;
+  worker.generation = generation;
+}
+
+void ParallelSolver::restart(Worker& worker, int generation) {
+  // Only the first thread that finds the search too large restarts it
+  if (!generation_.compare_exchange_strong(generation, generation + 1)) {
+    return;
+  }
+
+  queued_nodes_ = 0;
+  this->sync_generation(worker);
+  this->send(worker, this->start_node(generation + 1));
+}
+
+size_t ParallelSolver::nodes_expanded() const {
+  return nodes_expanded_;
+}
+
+int ParallelSolver::num_of_threads() const {
+  return num_of_threads_;
+}
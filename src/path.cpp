@@ -14,17 +14,22 @@
 #include "path.h"
 
 Path::Path(const std::string& start_charger,
-           const std::string& goal_charger):
+           const std::string& goal_charger,
+           const VehicleProfile& vehicle):
   start_charger_{start_charger},
   goal_charger_{goal_charger},
+  vehicle_(vehicle),
   chargers_{start_charger},
   chargers_set_{start_charger},
   charge_distances_{0},
   charge_rates_{},
-  dists_{} {
+  dists_{},
+  accumulate_dists_{0} {
   auto charge_rate =
       database::get_charger_record(start_charger_).rate;
   charge_rates_.push_back(charge_rate);
+  this->push_charge_curve();
+  this->push_faster_charger(0);
 }
 
 void Path::add_charger(std::string& next_charger) {
@@ -34,15 +39,24 @@ void Path::add_charger(std::string& next_charger) {
   double dist = utility::calc_great_distance(
     curr_charger, next_charger);
 
-  dists_.push_back(dist);
+  this->add_charger(next_charger, dist);
+}
 
-  if (dist > constant::FULL_CHARGE) {
-    throw std::invalid_argument("Next charger is too far");
+void Path::add_charger(const std::string& next_charger, double dist) {
+  if (this->charger_visited(next_charger)) {
+    dists_.push_back(dist);
+    throw std::invalid_argument("Charger already visited");
     return;
   }
 
-  if (this->charger_visited(next_charger)) {
-    throw std::invalid_argument("Charger already visited");
+  this->add_stop(next_charger, dist);
+}
+
+void Path::add_stop(const std::string& next_charger, double dist) {
+  dists_.push_back(dist);
+
+  if (dist > vehicle_.full_charge) {
+    throw std::invalid_argument("Next charger is too far");
     return;
   }
 
@@ -57,6 +71,10 @@ void Path::add_charger(std::string& next_charger) {
   auto charge_rate =
     database::get_charger_record(next_charger).rate;
   charge_rates_.push_back(charge_rate);
+  this->push_charge_curve();
+
+  accumulate_dists_.push_back(accumulate_dists_.back() + dist);
+  this->push_faster_charger(chargers_.size() - 1);
 
   // If next charger is the goal,
   // then calculate the optimize charging amount
@@ -67,34 +85,63 @@ void Path::add_charger(std::string& next_charger) {
 }
 
 double Path::time_cost() {
+  if (time_dependent_) {
+    return this->time_dependent_cost();
+  }
+
   // Calculate optmize charging amount
   // for time cost estimation
   this->optimize_charge();
 
   double total_time = 0.0;
+  double charge = vehicle_.init_charge;
 
   for (int i=0; i < chargers_.size() - 1; ++i) {
-    std::string curr_charger = chargers_[i];
-
     // Charging time
     if (i < charge_distances_.size() &&
         i < charge_rates_.size()) {
-      total_time += charge_distances_[i] / charge_rates_[i];
+      total_time += this->charge_time(i, charge);
     }
 
     // Moving time
     if (i < dists_.size()) {
-      total_time += dists_[i] / constant::SPEED;
+      total_time += dists_[i] / vehicle_.speed;
+      charge += charge_distances_[i] - dists_[i];
     }
   }
 
   return total_time;
 }
 
+double Path::greedy_time_cost() {
+  if (time_dependent_ || !charge_curves_.empty()) {
+    return this->time_cost();
+  }
+
+  // Just enough before a faster charger or the end, full before a slower
+  int last = chargers_.size() - 1;
+  double total_time = 0.0;
+  double accumulate_charge = 0.0;
+  for (int i=0; i < last; ++i) {
+    auto max_amount = vehicle_.full_charge -
+      (vehicle_.init_charge + accumulate_charge - accumulate_dists_[i]);
+    auto min_amount = std::max(0.0,
+      accumulate_dists_[i + 1] - vehicle_.init_charge - accumulate_charge);
+    double amount = (charge_rates_[i] < charge_rates_[i + 1] || i + 1 == last) ?
+      min_amount : max_amount;
+
+    accumulate_charge += amount;
+    total_time += amount / charge_rates_[i] + dists_[i] / vehicle_.speed;
+  }
+
+  return total_time;
+}
+
 std::string Path::to_string() {
   std::string solution;
   std::stringstream solution_stream;
 
+  double charge = vehicle_.init_charge;
   for (int i=0; i < chargers_.size(); ++i) {
     auto curr_charger = chargers_[i];
     solution_stream << curr_charger;
@@ -102,22 +149,153 @@ std::string Path::to_string() {
     if (curr_charger != goal_charger_) {
       solution_stream << ", ";
 
-      if (curr_charger != start_charger_ &&
+      // The start charger only has a charge time
+      // when the car does not start with enough charge
+      bool has_charge_time =
+        curr_charger != start_charger_ || charge_distances_[i] > 0;
+      if (has_charge_time &&
           i < charge_distances_.size()) {
-        auto charge_rate =
-          database::get_charger_record(curr_charger).rate;
-        double charge_time = charge_distances_[i] / charge_rate;
+        double charge_time = this->charge_time(i, charge);
         charge_time = std::ceil(charge_time * 1e5) / 1e5;
         solution_stream << std::fixed << std::setprecision(5) <<
           charge_time;
         solution_stream << ", ";
       }
     }
+
+    if (i < dists_.size()) {
+      charge += charge_distances_[i] - dists_[i];
+    }
   }
 
   return solution_stream.str();
 }
 
+RouteResult Path::to_route_result(RouteStatus status) {
+  RouteResult result;
+  result.status = status;
+  result.cost = this->time_cost();
+
+  double charge = vehicle_.init_charge;
+  for (int i=0; i < chargers_.size(); ++i) {
+    result.charger_ids.push_back(database::get_charger_id(chargers_[i]));
+    result.charge_times.push_back(this->charge_time(i, charge));
+    if (i < dists_.size()) {
+      charge += charge_distances_[i] - dists_[i];
+    }
+  }
+  result.leg_dists = dists_;
+
+  return result;
+}
+
+ChildCostBase Path::child_cost_base() {
+  ChildCostBase base;
+  base.time = 0.0;
+  base.full_charge = vehicle_.full_charge;
+  base.speed = vehicle_.speed;
+  base.rate = charge_rates_.back();
+
+  // The greedy plan of a child, where the current charger compares
+  // its charge rate with the next one only when the child is added
+  double accumulate_charge = 0.0;
+  base.greedy_time = 0.0;
+  for (int i=0; i + 1 < chargers_.size(); ++i) {
+    auto max_amount = vehicle_.full_charge -
+      (vehicle_.init_charge + accumulate_charge - accumulate_dists_[i]);
+    auto min_amount = std::max(0.0,
+      accumulate_dists_[i + 1] - vehicle_.init_charge - accumulate_charge);
+    double amount = (charge_rates_[i] < charge_rates_[i + 1]) ?
+      min_amount : max_amount;
+
+    accumulate_charge += amount;
+    base.greedy_time += amount / charge_rates_[i] + dists_[i] / vehicle_.speed;
+  }
+  base.greedy_charge = vehicle_.init_charge + accumulate_charge -
+    accumulate_dists_.back();
+
+  // With charging curves a child starts from the cheapest
+  // arrivals at the current charger
+  if (!charge_curves_.empty()) {
+    this->optimize_curve_charge(charge_rates_, &base);
+    return base;
+  }
+  this->optimize_charge();
+
+  double charge = vehicle_.init_charge;
+  double total_dist = accumulate_dists_.back();
+  for (int i=0; i < chargers_.size(); ++i) {
+    // Chargers that fill up stay the same, and chargers with a faster
+    // charger ahead charge just enough to get there
+    double dist_to_end = total_dist - accumulate_dists_[i];
+    if (next_faster_[i] < 0 && dist_to_end < vehicle_.full_charge) {
+      base.dists_to_end.push_back(dist_to_end);
+      base.arrival_charges.push_back(charge);
+      base.charge_amounts.push_back(charge_distances_[i]);
+      base.rates.push_back(charge_rates_[i]);
+    }
+
+    base.time += charge_distances_[i] / charge_rates_[i];
+    charge += charge_distances_[i];
+    if (i < dists_.size()) {
+      base.time += dists_[i] / vehicle_.speed;
+      charge -= dists_[i];
+    }
+  }
+
+  return base;
+}
+
+double ChildCostBase::child_time(double dist) const {
+  // With charging curves the child takes the cheapest arrival at the
+  // current charger and charges there as needed, a higher arrival
+  // is slower to get but needs less charge
+  if (!arrival_levels.empty()) {
+    double best_time = std::numeric_limits<double>::infinity();
+    for (int i=0; i < arrival_levels.size(); ++i) {
+      double level = arrival_levels[i];
+      if (level >= dist) {
+        best_time = std::min(best_time, arrival_times[i]);
+        break;
+      }
+
+      double charge_time = (curve != nullptr) ?
+        curve->charge_time(level, dist, full_charge, rate) :
+        (dist - level) / rate;
+      best_time = std::min(best_time, arrival_times[i] + charge_time);
+    }
+    return best_time + dist / speed;
+  }
+
+  double child_time = time + dist / speed;
+
+  // The child needs dist more charge at the end, which is charged at
+  // the changed chargers as far as the battery allows
+  double extra_charge = 0.0;
+  for (int i=0; i < rates.size(); ++i) {
+    double arrival_charge = arrival_charges[i] + extra_charge;
+    double target = std::min(full_charge, dists_to_end[i] + dist);
+    double amount = std::max(0.0, target - arrival_charge);
+
+    child_time += (amount - charge_amounts[i]) / rates[i];
+    extra_charge = arrival_charge + amount -
+      (arrival_charges[i] + charge_amounts[i]);
+  }
+
+  return child_time;
+}
+
+double ChildCostBase::greedy_child_time(double dist) const {
+  if (!arrival_levels.empty()) {
+    return this->child_time(dist);
+  }
+
+  // The current charger is the last before the child,
+  // so it charges just enough
+  return greedy_time + std::max(0.0, dist - greedy_charge) / rate +
+    dist / speed;
+}
+
 bool Path::charger_visited(const std::string& next_charger) {
   return chargers_set_.find(next_charger) != chargers_set_.end();
 }
@@ -126,9 +304,47 @@ std::string Path::current_charger() {
   return chargers_.back();
 }
 
+const std::vector<std::string>& Path::chargers() const {
+  return chargers_;
+}
+
+double Path::shared_ratio(const Path& other) const {
+  // Only path longer than 2 has intermediate chargers
+  int num_of_intermediates = static_cast<int>(
+    std::min(chargers_.size(), other.chargers_.size())) - 2;
+  if (num_of_intermediates <= 0) {
+    return 0.0;
+  }
+
+  // Only the intermediate chargers of the other Path are counted,
+  // so the ratio is the same both ways
+  int shared_count = 0;
+  for (int i=1; i < chargers_.size() - 1; ++i) {
+    if (chargers_[i] != other.chargers_.front() &&
+        chargers_[i] != other.chargers_.back() &&
+        other.chargers_set_.find(chargers_[i]) != other.chargers_set_.end()) {
+      shared_count++;
+    }
+  }
+
+  return static_cast<double>(shared_count) / num_of_intermediates;
+}
+
+double Path::current_charge() {
+  this->optimize_charge();
+
+  double charge = vehicle_.init_charge;
+  for (int i=0; i < dists_.size(); ++i) {
+    charge += charge_distances_[i] - dists_[i];
+  }
+
+  // Remove rounding noise when arriving with an empty battery
+  return std::max(0.0, charge);
+}
+
 double Path::heuristic_cost(double goal_weight) {
   if (reached_goal) {
-    return this->time_cost();
+    return this->greedy_time_cost();
   }
 
   double goal_dist = utility::calc_great_distance(
@@ -136,52 +352,316 @@ double Path::heuristic_cost(double goal_weight) {
 
 
   double heuristic =
-    this->time_cost() +  // Past travel time and charging time
-    goal_weight * goal_dist / constant::SPEED +  // Estimated travel-to-goal time
+    this->greedy_time_cost() +  // Past travel time and charging time
+    goal_weight * goal_dist / vehicle_.speed +  // Estimated travel-to-goal time
     goal_dist / constant::AVERAGE_RATE;  // Estimated future charging time
 
   return heuristic;
 }
 
+void Path::set_departure_time(double departure_time) {
+  time_dependent_ = true;
+  departure_time_ = departure_time;
+}
+
+void Path::refresh_rates() {
+  charge_curves_.clear();
+  for (int i=0; i < chargers_.size(); ++i) {
+    charge_rates_[i] = database::get_charger_record(chargers_[i]).rate;
+    auto curve = database::get_charging_curve(chargers_[i]);
+    if (curve != nullptr || !charge_curves_.empty()) {
+      charge_curves_.resize(i);
+      charge_curves_.push_back(curve);
+    }
+  }
+  this->update_faster_chargers();
+}
+
+const VehicleProfile& Path::vehicle() const {
+  return vehicle_;
+}
+
+size_t Path::memory_size() const {
+  // Each visited charger is stored in chargers_, as a node of
+  // chargers_set_ (about three pointers and a color), in the
+  // charge_distances_, charge_rates_, dists_ and accumulate_dists_
+  // vectors, and in next_faster_ and at most once in faster_stack_
+  size_t set_node_size = sizeof(std::string) + 4 * sizeof(void*);
+  size_t size = sizeof(Path) +
+    charge_curves_.size() * sizeof(std::shared_ptr<const ChargingCurve>);
+  for (auto& charger : chargers_) {
+    size += sizeof(std::string) + set_node_size +
+      4 * sizeof(double) + 2 * sizeof(int);
+    // Names longer than the small string buffer are stored twice on heap
+    if (charger.size() >= sizeof(std::string) - 1) {
+      size += 2 * (charger.size() + 1);
+    }
+  }
+
+  return size;
+}
+
 int Path::num_of_chargers() {
   return chargers_.size();
 }
 
 void Path::optimize_charge() {
-  // Only path longer than 2 needs charging optimization
-  if (chargers_.size() < 3) {
+  // Only path with at least one move needs charging optimization
+  if (chargers_.size() < 2) {
     return;
   }
 
-  double accumulate_dists = 0.0;
-  double accumulate_charge = 0.0;
+  if (!charge_curves_.empty()) {
+    this->optimize_curve_charge(charge_rates_);
+    return;
+  }
+
+  this->distribute_charge(next_faster_);
+}
+
+void Path::distribute_charge(const std::vector<int>& next_faster) {
+  int last = chargers_.size() - 1;
+  double charge = vehicle_.init_charge;
+  for (int i=0; i < last; ++i) {
+    // The current charger is the end of the path,
+    // so it counts as faster than every charger
+    int next = (next_faster[i] < 0) ? last : next_faster[i];
+
+    // Charge enough to get to the faster charger, or as much as
+    // possible if it is farther than full charge
+    double target = std::min(vehicle_.full_charge,
+      accumulate_dists_[next] - accumulate_dists_[i]);
+    charge_distances_[i] = std::max(0.0, target - charge);
+
+    charge += charge_distances_[i] - dists_[i];
+  }
+  charge_distances_[last] = 0;
+}
+
+namespace {
+  /**
+   * @Brief  Index of the nearest faster charger ahead of every charger,
+   *         -1 if there is none
+   */
+  std::vector<int> find_faster_chargers(const std::vector<double>& rates) {
+    std::vector<int> next_faster(rates.size(), -1);
+    std::vector<int> slower_chargers;
+    for (int i=0; i < rates.size(); ++i) {
+      while (!slower_chargers.empty() &&
+             rates[slower_chargers.back()] < rates[i]) {
+        next_faster[slower_chargers.back()] = i;
+        slower_chargers.pop_back();
+      }
+      slower_chargers.push_back(i);
+    }
+
+    return next_faster;
+  }
+
+  /**
+   * @Brief  A charge of the car at a charger in a charging plan
+   */
+  struct ChargeState {
+    double level;  // km
+
+    /**
+     * @Brief  Least time from the start to have the charge
+     */
+    double time;  // hr
+
+    /**
+     * @Brief  Index of the state it comes from in the stage before
+     */
+    int parent;
+  };
+}  // namespace
+
+void Path::optimize_curve_charge(const std::vector<double>& rates,
+                                 ChildCostBase* base) {
+  int last = chargers_.size() - 1;
+  double full_charge = vehicle_.full_charge;
+
+  // Arrivals at every charger and departures from every charger
+  // but the current one
+  std::vector<std::vector<ChargeState>> arrivals(last + 1);
+  std::vector<std::vector<ChargeState>> departures(last);
+  arrivals[0].push_back({vehicle_.init_charge, 0.0, -1});
+
+  std::vector<double> levels;
+  for (int i=0; i < last; ++i) {
+    auto curve = this->charge_curve(i);
+    double rate = rates[i];
+    auto time_at = [curve, rate, full_charge](double level) {
+      return (curve != nullptr) ?
+        curve->charge_time(level, full_charge) / rate : level / rate;
+    };
+
+    // The three kinds of levels are each in increasing order
+    levels.clear();
+    for (int m=0; m <= chargingCurveParam::PLAN_LEVELS; ++m) {
+      levels.push_back(full_charge * m / chargingCurveParam::PLAN_LEVELS);
+    }
+    auto middle = levels.size();
+    for (int k=i + 1; k <= last &&
+         accumulate_dists_[k] - accumulate_dists_[i] <= full_charge; ++k) {
+      levels.push_back(accumulate_dists_[k] - accumulate_dists_[i]);
+    }
+    std::inplace_merge(levels.begin(), levels.begin() + middle, levels.end());
+    middle = levels.size();
+    for (auto& arrival : arrivals[i]) {
+      levels.push_back(arrival.level);
+    }
+    std::inplace_merge(levels.begin(), levels.begin() + middle, levels.end());
+
+    // The time to leave with a charge is the best arrival below it plus
+    // the charging time, which is a difference of cumulative times
+    auto& stage_arrivals = arrivals[i];
+    std::vector<ChargeState> stage_departures;
+    double best_offset = std::numeric_limits<double>::infinity();
+    int best_arrival = -1;
+    int next_arrival = 0;
+    for (double level : levels) {
+      while (next_arrival < stage_arrivals.size() &&
+             stage_arrivals[next_arrival].level <= level) {
+        auto& arrival = stage_arrivals[next_arrival];
+        double offset = arrival.time - time_at(arrival.level);
+        if (offset < best_offset) {
+          best_offset = offset;
+          best_arrival = next_arrival;
+        }
+        next_arrival++;
+      }
+
+      // Leaving with too little charge for the next charger is no plan
+      if (best_arrival < 0 || level < dists_[i] - 1e-9) {
+        continue;
+      }
+      stage_departures.push_back({level, best_offset + time_at(level),
+                                  best_arrival});
+    }
+
+    // Keep only departures faster than every higher one
+    auto& kept_departures = departures[i];
+    double fastest_time = std::numeric_limits<double>::infinity();
+    for (int j=stage_departures.size() - 1; j >= 0; --j) {
+      if (stage_departures[j].time < fastest_time) {
+        fastest_time = stage_departures[j].time;
+        kept_departures.push_back(stage_departures[j]);
+      }
+    }
+    std::reverse(kept_departures.begin(), kept_departures.end());
+
+    for (int j=0; j < kept_departures.size(); ++j) {
+      arrivals[i + 1].push_back({
+        std::max(0.0, kept_departures[j].level - dists_[i]),
+        kept_departures[j].time + dists_[i] / vehicle_.speed, j});
+    }
+  }
+
+  // The fastest arrival at the current charger has the lowest charge,
+  // follow it back to the start
+  int state = 0;
+  for (int i=last - 1; i >= 0; --i) {
+    auto& departure = departures[i][arrivals[i + 1][state].parent];
+    auto& arrival = arrivals[i][departure.parent];
+    charge_distances_[i] = std::max(0.0, departure.level - arrival.level);
+    state = departure.parent;
+  }
+  charge_distances_[last] = 0;
+
+  if (base != nullptr) {
+    for (auto& arrival : arrivals[last]) {
+      base->arrival_levels.push_back(arrival.level);
+      base->arrival_times.push_back(arrival.time);
+    }
+    base->time = arrivals[last].front().time;
+    base->curve = this->charge_curve(last);
+    base->rate = rates[last];
+  }
+}
+
+double Path::charge_time(int index, double arrival_charge) const {
+  return this->charge_time(index, arrival_charge, charge_rates_[index]);
+}
+
+double Path::charge_time(int index, double arrival_charge,
+                         double rate) const {
+  auto curve = this->charge_curve(index);
+  if (curve == nullptr) {
+    return charge_distances_[index] / rate;
+  }
 
-  // For every charger, there exists a maximum charging amount
-  // and a minimum charging amount
-  // Determine which one to use based on the relative charging speed of
-  // current and next charger.
-  for (int i=0; i < chargers_.size()-1; ++i) {
-    // The charging amount after charging cannot exceed FULL_CHARGE value
-    auto max_amount = constant::FULL_CHARGE -
-      (constant::INIT_CHARGE + accumulate_charge - accumulate_dists);
+  return curve->charge_time(arrival_charge,
+    arrival_charge + charge_distances_[index],
+    vehicle_.full_charge, rate);
+}
 
-    // The charging amount has to be enough to get to next charger
-    accumulate_dists += dists_[i];
-    auto min_amount =
-      std::max(0.0, accumulate_dists - constant::INIT_CHARGE - accumulate_charge);
+const ChargingCurve* Path::charge_curve(int index) const {
+  return charge_curves_.empty() ? nullptr : charge_curves_[index].get();
+}
 
-    // If next charger has faster charging rate
-    // or next charger is the last charger,
-    // charge minimal charge at current station
-    bool minimal_charge_condition =
-      charge_rates_[i] < charge_rates_[i+1] ||
-      i + 1 == chargers_.size() - 1;
+void Path::push_charge_curve() {
+  // Paths on stations without a curve keep no curves at all
+  auto curve = database::get_charging_curve(chargers_.back());
+  if (curve != nullptr || !charge_curves_.empty()) {
+    charge_curves_.resize(chargers_.size() - 1);
+    charge_curves_.push_back(curve);
+  }
+}
 
-    charge_distances_[i] =
-      (minimal_charge_condition) ? min_amount : max_amount;
+void Path::push_faster_charger(int index) {
+  next_faster_.push_back(-1);
+  while (!faster_stack_.empty() &&
+         charge_rates_[faster_stack_.back()] < charge_rates_[index]) {
+    next_faster_[faster_stack_.back()] = index;
+    faster_stack_.pop_back();
+  }
+  faster_stack_.push_back(index);
+}
 
-    accumulate_charge += charge_distances_[i];
+void Path::update_faster_chargers() {
+  next_faster_.clear();
+  faster_stack_.clear();
+  for (int i=0; i < chargers_.size(); ++i) {
+    this->push_faster_charger(i);
   }
 }
 
+double Path::time_dependent_cost() {
+  double total_time = 0.0;
 
+  // The charge rates depend on the arrival time, which depends on
+  // the charging plan. The first plan uses the database rates, the
+  // second the rates at the arrival times of the first.
+  std::vector<double> plan_rates = charge_rates_;
+  for (int pass=0; pass < 2; ++pass) {
+    if (chargers_.size() >= 2 && !charge_curves_.empty()) {
+      this->optimize_curve_charge(plan_rates);
+    } else if (chargers_.size() >= 2) {
+      this->distribute_charge(find_faster_chargers(plan_rates));
+    }
+
+    std::vector<double> rates = charge_rates_;
+    double clock = departure_time_;
+    double charge = vehicle_.init_charge;
+    for (int i=0; i < dists_.size(); ++i) {
+      auto profile = database::get_time_profile(chargers_[i]);
+      if (profile != nullptr) {
+        // Only wait in the queue when charging
+        if (charge_distances_[i] > 0) {
+          clock += profile->wait.value(clock);
+        }
+        rates[i] = profile->rate.value(clock);
+      }
+
+      clock += this->charge_time(i, charge, rates[i]);
+      clock += dists_[i] / vehicle_.speed;
+      charge += charge_distances_[i] - dists_[i];
+    }
+
+    total_time = clock - departure_time_;
+    plan_rates = rates;
+  }
+
+  return total_time;
+}
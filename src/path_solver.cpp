@@ -5,17 +5,25 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
+#include "heuristic_cache.h"
 #include "utility.h"
 #include "path.h"
 #include "path_solver.h"
+#include "trace.h"
 
 PathSolver::PathSolver(
   const std::string& start_charger,
-  const std::string& goal_charger):
+  const std::string& goal_charger,
+  const VehicleProfile& vehicle):
   start_charger_{start_charger},
   goal_charger_{goal_charger},
-  best_path_(start_charger, goal_charger) {
+  vehicle_(vehicle),
+  best_path_(start_charger, goal_charger, vehicle),
+  state_version_{database::state_version()},
+  goal_id_{database::get_charger_id(goal_charger)} {
   this->reset_queue();
 }
 
@@ -23,7 +31,8 @@ std::vector<std::string> PathSolver::find_neighbors(Path& parent) {
   std::vector<std::string> child_chargers;
 
   auto curr_charger = parent.current_charger();
-  auto neighbors = database::get_neighbors(curr_charger);
+  auto neighbors = database::get_neighbors(
+    curr_charger, vehicle_.full_charge);
 
   for (auto& charger : neighbors) {
     if (parent.charger_visited(charger)) {
@@ -36,65 +45,628 @@ std::vector<std::string> PathSolver::find_neighbors(Path& parent) {
   return child_chargers;
 }
 
+std::shared_ptr<Path> PathSolver::init_path() {
+  std::shared_ptr<Path> path_ptr =
+    std::make_shared<Path>(start_charger_, goal_charger_, vehicle_);
+  if (time_dependent_) {
+    path_ptr->set_departure_time(departure_time_);
+  }
+
+  return path_ptr;
+}
+
+PathSolverConfig PathSolverConfig::preset(const std::string& name) {
+  // Tuned with the tune tool over every 30th ordered pair of stations,
+  // and measured with diff_harness against default over all 91,506 pairs.
+  // Fewer candidates leave a tail of much slower routes behind a small
+  // mean cost, so the tail is given with the mean.
+  PathSolverConfig config;
+  if (name == "default") {
+    return config;
+
+  } else if (name == "balanced") {
+    // About 1.5 times faster at p50 and 4 times at p95. 25% of the
+    // routes cost more, 0.43% more on average, 6.9% at p99 and 26.8%
+    // at most
+    config.num_of_candidate = 10;
+    config.max_queue_size = 2000;
+    return config;
+
+  } else if (name == "fast") {
+    // About 2.4 times faster at p50 and 6.4 times at p95. 51% of the
+    // routes cost more, 1.2% more on average, 9.3% at p99 and 34.8%
+    // at most
+    config.num_of_candidate = 3;
+    config.goal_weight_step = 0.5;
+    config.max_queue_size = 2000;
+    return config;
+  }
+
+  throw std::invalid_argument("Unknown path solver preset " + name);
+}
+
+void PathSolver::set_config(const PathSolverConfig& config) {
+  config_ = config;
+  goal_weight_ = config_.default_goal_weight;
+  reset_count_ = 0;
+
+  // The next search fetches the goal table of the new setting
+  goal_table_.reset();
+
+  // Paths searched so far used different parameters
+  best_path_ = *this->init_path();
+  best_cost_ = std::numeric_limits<double>::infinity();
+  candidate_count_ = 0;
+  this->reset_queue();
+}
+
+void PathSolver::set_departure_time(double departure_time) {
+  time_dependent_ = true;
+  departure_time_ = departure_time;
+
+  // Paths searched so far used a different time
+  best_path_ = *this->init_path();
+  best_cost_ = std::numeric_limits<double>::infinity();
+  candidate_count_ = 0;
+  this->reset_queue();
+}
+
 void PathSolver::reset_queue() {
-  path_queue_ = std::priority_queue<PathAndCost>();
-  std::shared_ptr<Path> init_path_ptr =
-    std::make_shared<Path>(start_charger_, goal_charger_);
+  path_queue_ = std::priority_queue<QueueEntry>();
+  nodes_.clear();
+  std::shared_ptr<Path> init_path_ptr = this->init_path();
   double init_cost = init_path_ptr->heuristic_cost();
-  path_queue_.emplace(std::make_pair(-init_cost, init_path_ptr));
+  this->push_node(this->add_node(-1, database::get_charger_id(start_charger_)),
+                  init_cost);
 }
 
-std::string PathSolver::solve() {
+int PathSolver::add_node(int parent, int charger_id) {
+  int depth = (parent < 0) ? 1 : nodes_[parent].depth + 1;
+  nodes_.push_back(SearchNode{parent, charger_id, depth});
+  return nodes_.size() - 1;
+}
+
+void PathSolver::push_node(int node, double cost) {
+  // A station that cannot reach the goal has an infinite cost, which has
+  // no fixed point value, so the node is left out of the queue
+  if (!std::isfinite(cost)) {
+    return;
+  }
+
+  path_queue_.push(QueueEntry{static_cast<int64_t>(
+    std::llround(cost * pathSolverParam::COST_UNITS_PER_HOUR)), node});
+}
+
+void PathSolver::push_path(Path& path) {
+  int node = -1;
+  for (auto& charger : path.chargers()) {
+    node = this->add_node(node, database::get_charger_id(charger));
+  }
+  this->push_node(node, this->heuristic_cost(path));
+}
+
+std::vector<int> PathSolver::chain_ids(int node) const {
+  std::vector<int> ids(nodes_[node].depth);
+  for (int i=ids.size() - 1; i >= 0; --i) {
+    ids[i] = nodes_[node].charger_id;
+    node = nodes_[node].parent;
+  }
+
+  return ids;
+}
+
+std::shared_ptr<Path> PathSolver::build_path(int node) {
+  auto ids = this->chain_ids(node);
+  std::shared_ptr<Path> path_ptr = this->init_path();
+  for (int i=1; i < ids.size(); ++i) {
+    // Same distance as the neighbor table the node was scored with
+    auto& record = database::get_charger_record(ids[i]);
+    double dist = utility::calc_great_distance(
+      database::get_charger_record(ids[i - 1]), record);
+    path_ptr->add_charger(record.name, dist);
+  }
+
+  return path_ptr;
+}
+
+std::vector<std::shared_ptr<Path>> PathSolver::take_queued_paths() {
+  std::vector<std::shared_ptr<Path>> paths;
+  while (path_queue_.size() > 0) {
+    paths.push_back(this->build_path(path_queue_.top().node));
+    path_queue_.pop();
+  }
+  nodes_.clear();
+
+  return paths;
+}
+
+std::shared_ptr<Path> PathSolver::next_candidate() {
+  // The goal table is fetched once, when the search starts
+  if (config_.use_goal_table && !goal_table_) {
+    this->update_goal_table();
+  }
+
   while (path_queue_.size() > 0) {
     // If the amount of path candidates grows too large
     // (Possilby hard to find path due to large distance)
     // Reset the path candidate queue, and restart with a
     // larger penalty on the goal distance
-    if (path_queue_.size() > pathSolverParam::MAX_QUEUE_SIZE) {
-      goal_weight_ += pathSolverParam::GOAL_WEIGHT_STEP;
+    if (path_queue_.size() > config_.max_queue_size) {
+      goal_weight_ += config_.goal_weight_step;
+      TRACE_SEARCH(TraceKind::RESET, database::get_charger_id(start_charger_),
+                   goal_weight_, path_queue_.size());
       this->reset_queue();
       reset_count_++;
     }
 
+    // The arena and the queue only grow between resets
+    peak_memory_ = std::max(peak_memory_,
+      nodes_.capacity() * sizeof(SearchNode) +
+      path_queue_.size() * sizeof(QueueEntry));
+
     auto curr = path_queue_.top();
     path_queue_.pop();
 
-    double curr_cost = curr.first;
-    auto curr_path_ptr = curr.second;
+    auto curr_path_ptr = this->build_path(curr.node);
+    Path& curr_path = *curr_path_ptr;
+
+    if (curr_path.reached_goal) {
+      TRACE_SEARCH(TraceKind::CANDIDATE, goal_id_,
+                   goal_weight_, path_queue_.size());
+      return curr_path_ptr;
+    }
+
+    TRACE_SEARCH(TraceKind::EXPAND, nodes_[curr.node].charger_id,
+                 goal_weight_, path_queue_.size());
+    this->expand(curr_path, curr.node);
+    nodes_expanded_++;
+  }
+
+  return nullptr;
+}
+
+void PathSolver::expand(Path& parent, int parent_node) {
+  // Time-dependent charge rates depend on the whole path,
+  // so every child is evaluated on its own
+  if (time_dependent_) {
+    auto child_chargers = this->find_neighbors(parent);
+
+    for (auto& charger : child_chargers) {
+      Path child_path(parent);
+      child_path.add_charger(charger);
+      double child_cost = this->heuristic_cost(child_path);
+      this->push_node(
+        this->add_node(parent_node, database::get_charger_id(charger)),
+        child_cost);
+    }
+    return;
+  }
+
+  int curr_id = nodes_[parent_node].charger_id;
+  auto& neighbor_table =
+    database::get_neighbor_table(curr_id, vehicle_.full_charge);
+  int num_of_neighbors = neighbor_table.ids.size();
+  const int* ids = neighbor_table.ids.data();
+  const double* dists = neighbor_table.dists.data();
+
+  // The visited charging stations are the parent chain
+  visited_ids_ = this->chain_ids(parent_node);
+
+  child_costs_.resize(num_of_neighbors);
+  child_valid_.resize(num_of_neighbors);
+  double* child_costs = child_costs_.data();
+  char* child_valid = child_valid_.data();
+
+  // Heuristic cost of every neighbor in one pass over the arrays,
+  // the goal has no distance to goal left and gets its time cost
+  auto base = parent.child_cost_base();
+  if (goal_table_) {
+    // A child arrives with what is left of the initial charge, and
+    // stations that cannot reach the goal are dropped
+    const GoalTable& goal_table = *goal_table_;
+    double charge = parent.current_charge();
+    for (int i=0; i < num_of_neighbors; ++i) {
+      double remaining_time = goal_table.remaining_time(
+        ids[i], std::max(0.0, charge - dists[i]));
+      child_costs[i] = base.child_time(dists[i]) +
+        goal_weight_ * remaining_time;
+      child_valid[i] =
+        remaining_time != std::numeric_limits<double>::infinity();
+    }
+
+  } else {
+    const double* goal_dists = this->neighbor_goal_dists(curr_id).data();
+    double goal_factor =
+      goal_weight_ / vehicle_.speed + 1.0 / constant::AVERAGE_RATE;
+    for (int i=0; i < num_of_neighbors; ++i) {
+      child_costs[i] = base.greedy_child_time(dists[i]) +
+        goal_factor * goal_dists[i];
+      child_valid[i] = 1;
+    }
+  }
+
+  // Neighbors are within range by construction,
+  // so only visited chargers are filtered out
+  for (int visited_id : visited_ids_) {
+    for (int i=0; i < num_of_neighbors; ++i) {
+      child_valid[i] &= (ids[i] != visited_id);
+    }
+  }
+
+  // Only valid children become nodes in the queue
+  for (int i=0; i < num_of_neighbors; ++i) {
+    if (!child_valid[i]) {
+      continue;
+    }
+
+    this->push_node(this->add_node(parent_node, ids[i]), child_costs[i]);
+  }
+}
+
+double PathSolver::heuristic_cost(Path& path) {
+  if (!goal_table_) {
+    return path.heuristic_cost(goal_weight_);
+  }
+
+  int curr_id = database::get_charger_id(path.current_charger());
+  return path.time_cost() + goal_weight_ *
+    goal_table_->remaining_time(curr_id, path.current_charge());
+}
+
+void PathSolver::update_goal_table() {
+  goal_table_ = config_.use_goal_table ?
+    heuristic::goal_table(goal_id_, vehicle_) : nullptr;
+}
+
+const std::vector<double>& PathSolver::neighbor_goal_dists(int id) {
+  if (goal_dists_.size() != database::num_of_chargers()) {
+    goal_dists_.assign(database::num_of_chargers(), std::vector<double>());
+  }
+
+  auto& neighbor_table =
+    database::get_neighbor_table(id, vehicle_.full_charge);
+  auto& goal_dists = goal_dists_[id];
+  if (goal_dists.size() != neighbor_table.ids.size()) {
+    auto& goal_record = database::get_charger_record(goal_id_);
+    goal_dists.clear();
+    for (int neighbor_id : neighbor_table.ids) {
+      goal_dists.push_back(neighbor_id == goal_id_ ? 0.0 :
+        utility::calc_great_distance(
+          database::get_charger_record(neighbor_id), goal_record));
+    }
+  }
+
+  return goal_dists;
+}
+
+std::string PathSolver::solve() {
+  return route::to_string(this->solve_route());
+}
+
+RouteResult PathSolver::solve_route() {
+  std::shared_ptr<Path> curr_path_ptr;
+  while ((curr_path_ptr = this->next_candidate()) != nullptr) {
     Path& curr_path = *curr_path_ptr;
 
     // If only start and goal in path (Shortest path),
     // then return the path
-    if (curr_path.reached_goal) {
-      if (curr_path.num_of_chargers() == 2) {
-        return curr_path.to_string();
+    if (curr_path.num_of_chargers() == 2) {
+      return curr_path.to_route_result();
+    }
+
+    // Candidates are compared with the exact charging plan
+    double curr_cost = curr_path.time_cost();
+    if (curr_cost < best_cost_) {
+      best_cost_ = curr_cost;
+      best_path_ = curr_path;
+    }
+
+    candidate_count_++;
+    // Compare multiple candidates for better result
+    if (candidate_count_ >= config_.num_of_candidate) {
+      return best_path_.to_route_result();
+    }
+    if (reset_count_ >= config_.max_reset) {
+      return best_path_.to_route_result(RouteStatus::RESET_LIMIT);
+    }
+  }
+
+  // The queue ran out before enough candidates were compared
+  if (best_cost_ < std::numeric_limits<double>::infinity()) {
+    return best_path_.to_route_result();
+  }
+
+  return RouteResult();
+}
+
+std::vector<Path> PathSolver::solve_alternatives(
+    int k, double max_shared_ratio) {
+  std::vector<PathAndCost> candidates;
+  std::vector<Path> alternatives;
+  if (k <= 0) {
+    return alternatives;
+  }
+
+  // Every candidate is searched once, so the total work grows with k
+  // but stays far below k independent searches
+  int max_candidates = k * std::max(config_.num_of_candidate,
+                                    pathSolverParam::ALTERNATIVE_CANDIDATE);
+
+  std::shared_ptr<Path> curr_path_ptr;
+  while ((curr_path_ptr = this->next_candidate()) != nullptr) {
+    double curr_cost = curr_path_ptr->time_cost();
+    candidates.emplace_back(std::make_pair(curr_cost, curr_path_ptr));
+    candidate_count_++;
+
+    if (curr_cost < best_cost_) {
+      best_cost_ = curr_cost;
+      best_path_ = *curr_path_ptr;
+    }
+
+    // Rank all candidates by time cost and greedily keep
+    // the ones that are different enough from better ranked paths
+    std::sort(candidates.begin(), candidates.end(),
+      [](const PathAndCost& a, const PathAndCost& b) {
+        return a.first < b.first;
+      });
+
+    alternatives.clear();
+    for (auto& candidate : candidates) {
+      bool is_different = true;
+      for (auto& alternative : alternatives) {
+        if (candidate.second->shared_ratio(alternative) > max_shared_ratio) {
+          is_different = false;
+          break;
+        }
       }
 
-      if (curr_path.heuristic_cost() < best_cost_) {
-        best_cost_ = curr_path.heuristic_cost();
-        best_path_ = curr_path;
+      if (is_different) {
+        alternatives.push_back(*candidate.second);
       }
 
-      candidate_count_++;
-      // Compare multiple candidates for better result
-      if (candidate_count_ == pathSolverParam::NUM_OF_CANDIDATE ||
-          reset_count_ >= pathSolverParam::MAX_RESET) {
-        return best_path_.to_string();
+      if (alternatives.size() == k) {
+        break;
       }
+    }
 
-      continue;
+    // The best path needs as many candidates as solve() compares
+    if ((alternatives.size() == k &&
+         candidate_count_ >= config_.num_of_candidate) ||
+        candidate_count_ >= max_candidates ||
+        reset_count_ >= config_.max_reset) {
+      break;
     }
+  }
 
-    auto child_chargers = this->find_neighbors(curr_path);
+  return alternatives;
+}
 
-    for (auto& charger : child_chargers) {
-      std::shared_ptr<Path> child_path_ptr = std::make_shared<Path>(curr_path);
-      child_path_ptr->add_charger(charger);
-      double child_cost = child_path_ptr->heuristic_cost(goal_weight_);
-      path_queue_.emplace(std::make_pair(-child_cost, child_path_ptr));
+std::string PathSolver::replan() {
+  auto changed_chargers = database::changed_chargers(state_version_);
+  state_version_ = database::state_version();
+
+  // Neighbor tables may have changed
+  goal_dists_.clear();
+  this->update_goal_table();
+
+  // Whether a path visits any changed charging station
+  auto is_affected = [&changed_chargers](Path& path) {
+    for (auto& charger : changed_chargers) {
+      if (path.charger_visited(charger)) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Index of the first out of service charging station in a path
+  auto first_unavailable = [&changed_chargers](Path& path) {
+    auto& chargers = path.chargers();
+    for (int i=1; i < chargers.size(); ++i) {
+      if (changed_chargers.count(chargers[i]) > 0 &&
+          !database::charger_available(chargers[i])) {
+        return i;
+      }
+    }
+    return static_cast<int>(chargers.size());
+  };
+
+  // Charging stations back in service were missing from the neighbors
+  // of every path expanded so far, so every expanded path that can reach
+  // one is extended to it again
+  std::vector<int> restored_ids;
+  for (auto& charger : changed_chargers) {
+    if (database::charger_available(charger)) {
+      restored_ids.push_back(database::get_charger_id(charger));
     }
   }
+  std::vector<std::shared_ptr<Path>> reseeded_paths;
+  if (!restored_ids.empty()) {
+    std::vector<bool> expanded(nodes_.size(), false);
+    for (auto& node : nodes_) {
+      if (node.parent >= 0) {
+        expanded[node.parent] = true;
+      }
+    }
+
+    for (int node=0; node < nodes_.size(); ++node) {
+      if (!expanded[node]) {
+        continue;
+      }
+      auto& record = database::get_charger_record(nodes_[node].charger_id);
+      auto chain = this->chain_ids(node);
+      for (int restored_id : restored_ids) {
+        auto& restored_record = database::get_charger_record(restored_id);
+        double dist = utility::calc_great_distance(record, restored_record);
+        if (dist > vehicle_.full_charge ||
+            std::find(chain.begin(), chain.end(), restored_id) !=
+              chain.end()) {
+          continue;
+        }
+        auto path_ptr = this->build_path(node);
+        path_ptr->add_charger(restored_record.name, dist);
+        reseeded_paths.push_back(path_ptr);
+      }
+    }
+  }
+
+  // Keep the search frontier that is still valid, and score every
+  // path again with the goal table of the new state
+  for (auto& path_ptr : this->take_queued_paths()) {
+    if (is_affected(*path_ptr)) {
+      if (first_unavailable(*path_ptr) < path_ptr->num_of_chargers()) {
+        continue;
+      }
+      path_ptr->refresh_rates();
+    }
+    this->push_path(*path_ptr);
+  }
+  for (auto& path_ptr : reseeded_paths) {
+    this->push_path(*path_ptr);
+  }
+
+  // Repair the previous best path
+  if (best_cost_ < std::numeric_limits<double>::infinity() &&
+      is_affected(best_path_)) {
+    int cut = first_unavailable(best_path_);
+
+    if (cut == best_path_.num_of_chargers()) {
+      best_path_.refresh_rates();
+      best_cost_ = best_path_.time_cost();
+    } else {
+      // Continue the search from the valid part of the previous best path
+      std::shared_ptr<Path> prefix_ptr = this->init_path();
+      auto chargers = best_path_.chargers();
+      for (int i=1; i < cut; ++i) {
+        prefix_ptr->add_charger(chargers[i]);
+      }
+      this->push_path(*prefix_ptr);
 
-  return "";
+      best_path_ = *this->init_path();
+      best_cost_ = std::numeric_limits<double>::infinity();
+    }
+  }
+
+  if (path_queue_.size() == 0) {
+    this->reset_queue();
+  }
+
+  // Compare a new set of candidates with the repaired best path,
+  // with the full number of resets of a new search
+  candidate_count_ = 0;
+  reset_count_ = 0;
+  return this->solve();
+}
+
+std::shared_ptr<Path> PathSolver::make_path(
+    const std::vector<std::string>& chargers, int first) {
+  if (first < 0 || first >= chargers.size() ||
+      chargers[first] != start_charger_) {
+    return nullptr;
+  }
+
+  std::shared_ptr<Path> path_ptr = this->init_path();
+  for (int i=first+1; i < chargers.size(); ++i) {
+    std::string charger = chargers[i];
+    if (!database::charger_available(charger)) {
+      return nullptr;
+    }
+
+    try {
+      path_ptr->add_charger(charger);
+    } catch (std::invalid_argument& e) {
+      return nullptr;
+    }
+
+    if (path_ptr->reached_goal) {
+      break;
+    }
+  }
+
+  return path_ptr;
+}
+
+bool PathSolver::warm_start(const std::vector<std::string>& route) {
+  auto start = std::find(route.begin(), route.end(), start_charger_);
+  auto path_ptr = this->make_path(route, start - route.begin());
+  if (path_ptr == nullptr || !path_ptr->reached_goal) {
+    return false;
+  }
+
+  double cost = path_ptr->time_cost();
+  if (cost < best_cost_) {
+    best_cost_ = cost;
+    best_path_ = *path_ptr;
+  }
+
+  // Focus the search on the route by queueing every part of it
+  auto& chargers = path_ptr->chargers();
+  for (int i=2; i < chargers.size(); ++i) {
+    std::vector<std::string> prefix(chargers.begin(), chargers.begin() + i);
+    auto prefix_ptr = this->make_path(prefix, 0);
+    this->push_path(*prefix_ptr);
+  }
+
+  return true;
 }
 
+std::string PathSolver::replan_from(
+    const std::string& charger, double charge) {
+  database::get_charger_record(charger);
+  if (charge < 0 || charge > vehicle_.full_charge) {
+    throw std::invalid_argument("Charge out of battery range");
+  }
+
+  std::vector<std::string> previous_route;
+  if (best_cost_ < std::numeric_limits<double>::infinity()) {
+    previous_route = best_path_.chargers();
+  }
+
+  // Collect the most promising explored paths that pass the current charger
+  std::vector<std::vector<std::string>> frontier;
+  int charger_id = database::get_charger_id(charger);
+  while (path_queue_.size() > 0 &&
+         frontier.size() < pathSolverParam::MAX_FRONTIER_REUSE) {
+    auto ids = this->chain_ids(path_queue_.top().node);
+    if (std::find(ids.begin(), ids.end(), charger_id) != ids.end()) {
+      std::vector<std::string> chargers;
+      for (int id : ids) {
+        chargers.push_back(database::get_charger_record(id).name);
+      }
+      frontier.push_back(chargers);
+    }
+    path_queue_.pop();
+  }
+
+  // Restart the search from the current charger and charge
+  start_charger_ = charger;
+  vehicle_.init_charge = charge;
+  best_path_ = *this->init_path();
+  best_cost_ = std::numeric_limits<double>::infinity();
+  candidate_count_ = 0;
+  reset_count_ = 0;
+  goal_weight_ = config_.default_goal_weight;
+  this->reset_queue();
+
+  for (auto& chargers : frontier) {
+    auto start = std::find(chargers.begin(), chargers.end(), charger);
+    auto path_ptr = this->make_path(chargers, start - chargers.begin());
+    if (path_ptr == nullptr || path_ptr->num_of_chargers() < 2) {
+      continue;
+    }
+
+    this->push_path(*path_ptr);
+  }
+
+  this->warm_start(previous_route);
+
+  return this->solve();
+}
+
+size_t PathSolver::nodes_expanded() const {
+  return nodes_expanded_;
+}
+
+size_t PathSolver::peak_memory() const {
+  return peak_memory_;
+}
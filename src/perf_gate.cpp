@@ -0,0 +1,459 @@
+/* perf_gate.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "heuristic_cache.h"
+#include "path_solver.h"
+#include "route_evaluator.h"
+
+/**
+ * @Brief  Default thresholds of the gate
+ */
+namespace perfGateParam {
+  /**
+   * @Brief  Allowed growth of a latency percentile or of the
+   *         total nodes expanded before the gate fails
+   *
+   *         Latency is noisy between runs, so the threshold is loose
+   */
+  constexpr double LATENCY_THRESHOLD = 0.25;
+
+  /**
+   * @Brief  Allowed growth of the cost of a route before the gate fails
+   */
+  constexpr double COST_THRESHOLD = 0.001;
+
+  /**
+   * @Brief  Times every query is solved cold and warm,
+   *         the fastest run of each is kept
+   */
+  constexpr int REPEAT = 3;
+}  // namespace perfGateParam
+
+/**
+ * @Brief  Measurement of one query
+ */
+struct QueryRecord {
+  std::string start;
+  std::string goal;
+  double cost;  // hr, infinity if the route is invalid
+  size_t nodes_expanded;
+
+  /**
+   * @Brief  Latency with an empty goal table cache, and with
+   *         the goal table of the query already in the cache
+   */
+  double cold_latency;  // ms
+  double warm_latency;  // ms
+};
+
+/**
+ * @Brief  Measurement of the whole workload
+ */
+struct GateRecord {
+  std::vector<QueryRecord> queries;
+  double cold_p50_latency = 0.0;  // ms
+  double cold_p95_latency = 0.0;  // ms
+  double cold_p99_latency = 0.0;  // ms
+  double warm_p50_latency = 0.0;  // ms
+  double warm_p95_latency = 0.0;  // ms
+  double warm_p99_latency = 0.0;  // ms
+  size_t nodes_expanded = 0;
+};
+
+/**
+ * @Brief  Solve one query, and store its cost and nodes expanded
+ *
+ * @Returns  The latency of the query in ms
+ */
+double time_query(QueryRecord& query_record, const PathSolverConfig& config) {
+  auto start_time = std::chrono::steady_clock::now();
+  PathSolver my_solver(query_record.start, query_record.goal);
+  my_solver.set_config(config);
+  auto solution = my_solver.solve();
+  auto end_time = std::chrono::steady_clock::now();
+
+  query_record.nodes_expanded = my_solver.nodes_expanded();
+  auto evaluation = evaluator::evaluate_route(solution);
+  query_record.cost = evaluation.valid ? evaluation.cost :
+    std::numeric_limits<double>::infinity();
+
+  return std::chrono::duration<double, std::milli>(
+    end_time - start_time).count();
+}
+
+/**
+ * @Brief  Solve every query of the workload and measure it
+ */
+GateRecord run_workload(
+    const std::vector<std::pair<std::string, std::string>>& workload,
+    const PathSolverConfig& config, int repeat) {
+  GateRecord record;
+  std::vector<double> cold_latencies;
+  std::vector<double> warm_latencies;
+  for (auto& query : workload) {
+    QueryRecord query_record;
+    query_record.start = query.first;
+    query_record.goal = query.second;
+    query_record.cold_latency = std::numeric_limits<double>::infinity();
+    query_record.warm_latency = std::numeric_limits<double>::infinity();
+
+    // A cold run builds the goal table and the warm run after it finds
+    // the table in the cache. The search is deterministic, so only the
+    // latency differs between runs.
+    for (int run=0; run < repeat; ++run) {
+      heuristic::clear();
+      query_record.cold_latency = std::min(query_record.cold_latency,
+        time_query(query_record, config));
+      query_record.warm_latency = std::min(query_record.warm_latency,
+        time_query(query_record, config));
+    }
+
+    cold_latencies.push_back(query_record.cold_latency);
+    warm_latencies.push_back(query_record.warm_latency);
+    record.nodes_expanded += query_record.nodes_expanded;
+    record.queries.push_back(query_record);
+  }
+
+  std::sort(cold_latencies.begin(), cold_latencies.end());
+  std::sort(warm_latencies.begin(), warm_latencies.end());
+  record.cold_p50_latency = utility::percentile(cold_latencies, 0.5);
+  record.cold_p95_latency = utility::percentile(cold_latencies, 0.95);
+  record.cold_p99_latency = utility::percentile(cold_latencies, 0.99);
+  record.warm_p50_latency = utility::percentile(warm_latencies, 0.5);
+  record.warm_p95_latency = utility::percentile(warm_latencies, 0.95);
+  record.warm_p99_latency = utility::percentile(warm_latencies, 0.99);
+  return record;
+}
+
+/**
+ * @Brief  Write a record as "key value" lines and one "query" line
+ *         per query
+ */
+void write_record(const GateRecord& record, const std::string& file_name) {
+  std::ofstream file(file_name);
+  file << "# perf_gate baseline, latency in ms and cost in hr" << std::endl;
+  file << "# query start goal cost nodes_expanded cold_latency "
+    "warm_latency" << std::endl;
+  file << std::fixed << std::setprecision(3);
+  file << "cold_p50_latency " << record.cold_p50_latency << std::endl;
+  file << "cold_p95_latency " << record.cold_p95_latency << std::endl;
+  file << "cold_p99_latency " << record.cold_p99_latency << std::endl;
+  file << "warm_p50_latency " << record.warm_p50_latency << std::endl;
+  file << "warm_p95_latency " << record.warm_p95_latency << std::endl;
+  file << "warm_p99_latency " << record.warm_p99_latency << std::endl;
+  file << "nodes_expanded " << record.nodes_expanded << std::endl;
+  for (auto& query : record.queries) {
+    file << "query " << query.start << " " << query.goal << " " <<
+      std::setprecision(6) << query.cost << " " << query.nodes_expanded <<
+      " " << std::setprecision(3) << query.cold_latency << " " <<
+      query.warm_latency << std::endl;
+  }
+}
+
+/**
+ * @Brief  Read a record written by write_record
+ *
+ *         Throws std::invalid_argument if the file is missing or malformed
+ */
+GateRecord read_record(const std::string& file_name) {
+  std::ifstream file(file_name);
+  if (!file) {
+    throw std::invalid_argument("Cannot open baseline " + file_name);
+  }
+
+  GateRecord record;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::stringstream line_stream(line);
+    std::string key;
+    line_stream >> key;
+    if (key == "cold_p50_latency") {
+      line_stream >> record.cold_p50_latency;
+    } else if (key == "cold_p95_latency") {
+      line_stream >> record.cold_p95_latency;
+    } else if (key == "cold_p99_latency") {
+      line_stream >> record.cold_p99_latency;
+    } else if (key == "warm_p50_latency") {
+      line_stream >> record.warm_p50_latency;
+    } else if (key == "warm_p95_latency") {
+      line_stream >> record.warm_p95_latency;
+    } else if (key == "warm_p99_latency") {
+      line_stream >> record.warm_p99_latency;
+    } else if (key == "nodes_expanded") {
+      line_stream >> record.nodes_expanded;
+    } else if (key == "query") {
+      QueryRecord query;
+      std::string cost;
+      line_stream >> query.start >> query.goal >> cost >>
+        query.nodes_expanded >> query.cold_latency >> query.warm_latency;
+      query.cost = (cost == "inf") ?
+        std::numeric_limits<double>::infinity() : std::stod(cost);
+      record.queries.push_back(query);
+    } else {
+      throw std::invalid_argument("Unknown baseline line: " + line);
+    }
+
+    if (line_stream.fail()) {
+      throw std::invalid_argument("Malformed baseline line: " + line);
+    }
+  }
+
+  return record;
+}
+
+/**
+ * @Brief  Read the cost of every query from the reference solver,
+ *         as "start goal cost" lines
+ *
+ *         Throws std::invalid_argument if the file is missing or malformed
+ */
+std::map<std::pair<std::string, std::string>, double> read_reference(
+    const std::string& file_name) {
+  std::ifstream file(file_name);
+  if (!file) {
+    throw std::invalid_argument("Cannot open reference " + file_name);
+  }
+
+  std::map<std::pair<std::string, std::string>, double> reference;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::stringstream line_stream(line);
+    std::string start;
+    std::string goal;
+    double cost;
+    line_stream >> start >> goal >> cost;
+    if (line_stream.fail()) {
+      throw std::invalid_argument("Malformed reference line: " + line);
+    }
+    reference[std::make_pair(start, goal)] = cost;
+  }
+
+  return reference;
+}
+
+/**
+ * @Brief  Compare the cost of every route against the reference solver
+ *
+ *         A baseline is only as good as the solver it was recorded on,
+ *         so the costs are also held against a fixed reference that
+ *         does not move with every new baseline
+ *
+ * @Returns  True if any route costs more than the reference
+ */
+bool compare_reference(
+    const std::map<std::pair<std::string, std::string>, double>& reference,
+    const GateRecord& current, double cost_threshold) {
+  int cost_regressions = 0;
+  int num_of_compared = 0;
+  for (auto& query : current.queries) {
+    auto reference_query = reference.find(
+      std::make_pair(query.start, query.goal));
+    if (reference_query == reference.end()) {
+      continue;
+    }
+
+    num_of_compared++;
+    double reference_cost = reference_query->second;
+    if (query.cost > reference_cost * (1.0 + cost_threshold)) {
+      if (cost_regressions == 0) {
+        std::cout << "cost above the reference:" << std::endl;
+      }
+      std::cout << "  " << query.start << " " << query.goal << "  " <<
+        std::fixed << std::setprecision(5) << reference_cost << " -> " <<
+        query.cost << " hr" << std::endl;
+      cost_regressions++;
+    }
+  }
+
+  std::cout << cost_regressions << " of " << num_of_compared <<
+    " routes cost more than the reference" << std::endl;
+  return cost_regressions > 0;
+}
+
+/**
+ * @Brief  Print one metric against the baseline
+ *
+ * @Returns  True if the metric grew beyond the threshold
+ */
+bool compare_metric(const std::string& name, double base, double current,
+                    double threshold, int precision = 3) {
+  double change = (base > 0.0) ? current / base - 1.0 : 0.0;
+  bool regressed = change > threshold;
+  std::cout << std::left << std::setw(16) << name << std::right <<
+    std::fixed << std::setprecision(precision) <<
+    std::setw(14) << base << std::setw(14) << current <<
+    std::setprecision(1) << std::setw(9) << 100.0 * change << "%" <<
+    (regressed ? "  REGRESSION" : "") << std::endl;
+  return regressed;
+}
+
+/**
+ * @Brief  Compare a run against the baseline and print the difference
+ *
+ * @Returns  True if any latency percentile, the nodes expanded
+ *           or the cost of any route regressed
+ */
+bool compare_records(const GateRecord& base, const GateRecord& current,
+                     double latency_threshold, double cost_threshold) {
+  bool regressed = false;
+  std::cout << std::left << std::setw(16) << "metric" << std::right <<
+    std::setw(14) << "baseline" << std::setw(14) << "current" <<
+    std::setw(10) << "change" << std::endl;
+  regressed |= compare_metric("cold p50 ms", base.cold_p50_latency,
+    current.cold_p50_latency, latency_threshold);
+  regressed |= compare_metric("cold p95 ms", base.cold_p95_latency,
+    current.cold_p95_latency, latency_threshold);
+  regressed |= compare_metric("cold p99 ms", base.cold_p99_latency,
+    current.cold_p99_latency, latency_threshold);
+  regressed |= compare_metric("warm p50 ms", base.warm_p50_latency,
+    current.warm_p50_latency, latency_threshold);
+  regressed |= compare_metric("warm p95 ms", base.warm_p95_latency,
+    current.warm_p95_latency, latency_threshold);
+  regressed |= compare_metric("warm p99 ms", base.warm_p99_latency,
+    current.warm_p99_latency, latency_threshold);
+  regressed |= compare_metric("nodes expanded", base.nodes_expanded,
+    current.nodes_expanded, latency_threshold, 0);
+
+  std::map<std::pair<std::string, std::string>, const QueryRecord*>
+    base_queries;
+  for (auto& query : base.queries) {
+    base_queries[std::make_pair(query.start, query.goal)] = &query;
+  }
+
+  int cost_regressions = 0;
+  int cost_improvements = 0;
+  for (auto& query : current.queries) {
+    auto base_query = base_queries.find(
+      std::make_pair(query.start, query.goal));
+    if (base_query == base_queries.end()) {
+      std::cout << "missing from baseline: " << query.start << " " <<
+        query.goal << std::endl;
+      regressed = true;
+      continue;
+    }
+
+    double base_cost = base_query->second->cost;
+    if (query.cost > base_cost * (1.0 + cost_threshold)) {
+      if (cost_regressions == 0) {
+        std::cout << "cost regressions:" << std::endl;
+      }
+      std::cout << "  " << query.start << " " << query.goal << "  " <<
+        std::setprecision(5) << base_cost << " -> " << query.cost <<
+        " hr" << std::endl;
+      cost_regressions++;
+    } else if (query.cost < base_cost * (1.0 - cost_threshold)) {
+      cost_improvements++;
+    }
+  }
+
+  std::cout << cost_regressions << " of " << current.queries.size() <<
+    " routes cost more, " << cost_improvements << " cost less" << std::endl;
+  return regressed || cost_regressions > 0;
+}
+
+int main(int argc, char** argv) {
+  std::string workload_file_name = "results/perf_workload.txt";
+  std::string baseline_file_name = "results/perf_baseline.txt";
+  std::string reference_file_name = "results/perf_reference.txt";
+  std::string record_file_name;
+  std::string preset = "default";
+  double latency_threshold = perfGateParam::LATENCY_THRESHOLD;
+  double cost_threshold = perfGateParam::COST_THRESHOLD;
+  int repeat = perfGateParam::REPEAT;
+
+  for (int i=1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--workload") {
+      workload_file_name = argv[i + 1];
+    } else if (arg == "--baseline") {
+      baseline_file_name = argv[i + 1];
+    } else if (arg == "--reference") {
+      reference_file_name = argv[i + 1];
+    } else if (arg == "--record") {
+      record_file_name = argv[i + 1];
+    } else if (arg == "--preset") {
+      preset = argv[i + 1];
+    } else if (arg == "--latency-threshold") {
+      latency_threshold = std::stod(argv[i + 1]);
+    } else if (arg == "--cost-threshold") {
+      cost_threshold = std::stod(argv[i + 1]);
+    } else if (arg == "--repeat") {
+      repeat = std::max(1, std::stoi(argv[i + 1]));
+    } else {
+      std::cout << "Usage: perf_gate [--workload query_file] "
+        "[--baseline baseline_file] [--record baseline_file]" << std::endl;
+      std::cout << "                 [--reference reference_file]" <<
+        std::endl;
+      std::cout << "                 [--preset name] [--repeat N] "
+        "[--latency-threshold F] [--cost-threshold F]" << std::endl;
+      return -1;
+    }
+  }
+
+  std::vector<std::pair<std::string, std::string>> workload;
+  std::ifstream workload_file(workload_file_name);
+  std::string start;
+  std::string goal;
+  while (workload_file >> start >> goal) {
+    workload.emplace_back(start, goal);
+  }
+  if (workload.empty()) {
+    std::cout << "Empty workload " << workload_file_name << std::endl;
+    return -1;
+  }
+
+  auto current = run_workload(workload, PathSolverConfig::preset(preset),
+                              repeat);
+
+  bool above_reference = false;
+  if (!reference_file_name.empty()) {
+    above_reference = compare_reference(read_reference(reference_file_name),
+                                        current, cost_threshold);
+  }
+
+  // Recording only writes a new baseline, and never one that
+  // costs more than the reference
+  if (!record_file_name.empty()) {
+    if (above_reference) {
+      std::cout << "Not recorded, routes cost more than the reference" <<
+        std::endl;
+      return 1;
+    }
+    write_record(current, record_file_name);
+    std::cout << "Recorded " << current.queries.size() << " queries to " <<
+      record_file_name << std::endl;
+    return 0;
+  }
+
+  auto base = read_record(baseline_file_name);
+  bool regressed = compare_records(base, current,
+                                   latency_threshold, cost_threshold);
+  regressed |= above_reference;
+  std::cout << (regressed ? "FAIL" : "PASS") << std::endl;
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/* reachability_solver.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "charging_curve.h"
+#include "utility.h"
+#include "path.h"
+#include "reachability_solver.h"
+
+/**
+ * @Brief  Whether path a can leave its charging station with
+ *         any charge at least as early as path b
+ *
+ *         Without charging curves the leaving time is piecewise linear in
+ *         the charge, and only bends where a changed charger fills up or
+ *         starts charging, so comparing at those charges is exact
+ */
+static bool dominates(const ChildCostBase& a, const ChildCostBase& b) {
+  double full_charge = a.full_charge;
+  std::vector<double> levels = {0.0, full_charge};
+  for (auto base : {&a, &b}) {
+    for (int i=0; i < base->dists_to_end.size(); ++i) {
+      levels.push_back(full_charge - base->dists_to_end[i]);
+      levels.push_back(base->arrival_charges[i] - base->dists_to_end[i]);
+    }
+    levels.insert(levels.end(), base->arrival_levels.begin(),
+                  base->arrival_levels.end());
+    if (!base->arrival_levels.empty()) {
+      for (int m=1; m < chargingCurveParam::PLAN_LEVELS; ++m) {
+        levels.push_back(full_charge * m / chargingCurveParam::PLAN_LEVELS);
+      }
+    }
+  }
+
+  for (double level : levels) {
+    level = std::min(full_charge, std::max(0.0, level));
+    if (a.child_time(level) > b.child_time(level) + 1e-12) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+ReachabilitySolver::ReachabilitySolver(
+  const std::string& start_charger,
+  double time_budget,
+  const VehicleProfile& vehicle):
+  start_charger_{start_charger},
+  time_budget_{time_budget},
+  vehicle_(vehicle) {
+  if (time_budget_ < 0) {
+    throw std::invalid_argument("Time budget cannot be negative");
+  }
+
+  // Validate the start charger before searching
+  database::get_charger_record(start_charger_);
+
+  // The path has no goal, so every charger is an ordinary stop
+  std::shared_ptr<Path> init_path_ptr =
+    std::make_shared<Path>(start_charger_, "", vehicle_);
+  this->push_label(init_path_ptr, 0.0);
+}
+
+void ReachabilitySolver::solve(
+    const std::function<void(const ReachableCharger&)>& on_reached) {
+  this->search([&on_reached](const ReachableCharger& reached) {
+    on_reached(reached);
+    return true;
+  });
+}
+
+void ReachabilitySolver::search(
+    const std::function<bool(const ReachableCharger&)>& on_reached) {
+  while (label_queue_.size() > 0) {
+    auto curr = label_queue_.top();
+    label_queue_.pop();
+
+    double curr_cost = -curr.first;
+    if (labels_[curr.second].dominated) {
+      continue;
+    }
+    auto curr_path_ptr = labels_[curr.second].path;
+    Path& curr_path = *curr_path_ptr;
+
+    // Every path left in the queue takes longer than the budget
+    if (curr_cost > time_budget_) {
+      break;
+    }
+
+    // The first path settled at a charger arrives earliest,
+    // later paths are only expanded
+    auto curr_charger = curr_path.current_charger();
+    if (settled_.insert(curr_charger).second) {
+      ReachableCharger reached;
+      reached.name = curr_charger;
+      reached.arrival_time = curr_cost;
+      reached.arrival_charge = curr_path.current_charge();
+      reached.chargers = curr_path.chargers();
+      if (!on_reached(reached)) {
+        break;
+      }
+    }
+
+    auto neighbors = database::get_neighbors(
+      curr_charger, vehicle_.full_charge);
+    for (auto& charger : neighbors) {
+      if (curr_path.charger_visited(charger)) {
+        continue;
+      }
+
+      std::shared_ptr<Path> child_path_ptr = std::make_shared<Path>(curr_path);
+      child_path_ptr->add_charger(charger);
+      double child_cost = child_path_ptr->time_cost();
+
+      if (child_cost > time_budget_) {
+        continue;
+      }
+
+      this->push_label(child_path_ptr, child_cost);
+    }
+  }
+}
+
+void ReachabilitySolver::push_label(const std::shared_ptr<Path>& path_ptr,
+                                    double cost) {
+  Label label{path_ptr, path_ptr->child_cost_base(), false};
+  auto& charger_labels = charger_labels_[path_ptr->current_charger()];
+  for (int id : charger_labels) {
+    if (dominates(labels_[id].base, label.base)) {
+      return;
+    }
+  }
+
+  // Queued paths that the new path dominates are skipped when settled
+  auto kept_end = std::remove_if(charger_labels.begin(), charger_labels.end(),
+    [this, &label](int id) {
+      labels_[id].dominated = dominates(label.base, labels_[id].base);
+      return labels_[id].dominated;
+    });
+  charger_labels.erase(kept_end, charger_labels.end());
+
+  charger_labels.push_back(labels_.size());
+  labels_.push_back(label);
+  label_queue_.emplace(-cost, labels_.size() - 1);
+}
+
+std::vector<ReachableCharger> ReachabilitySolver::solve() {
+  std::vector<ReachableCharger> reachable;
+  this->solve([&reachable](const ReachableCharger& reached) {
+    reachable.push_back(reached);
+  });
+
+  return reachable;
+}
+
+std::vector<ReachableCharger> ReachabilitySolver::solve_targets(
+    const std::vector<std::string>& targets) {
+  std::unordered_set<std::string> targets_left(targets.begin(), targets.end());
+  for (auto& target : targets) {
+    // Validate the targets before searching
+    database::get_charger_record(target);
+  }
+
+  std::vector<ReachableCharger> reached_targets;
+  if (targets_left.empty()) {
+    return reached_targets;
+  }
+  this->search([&](const ReachableCharger& reached) {
+    if (targets_left.erase(reached.name) > 0) {
+      reached_targets.push_back(reached);
+    }
+    return !targets_left.empty();
+  });
+
+  return reached_targets;
+}
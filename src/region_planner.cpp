@@ -0,0 +1,539 @@
+/* region_planner.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "alloc_tracker.h"
+#include "reachability_solver.h"
+#include "region_planner.h"
+
+/**
+ * @Brief  Read one line from a pipe without the new line
+ */
+static std::string read_line(FILE* input) {
+  std::string line;
+  int c;
+  while ((c = std::fgetc(input)) != EOF && c != '\n') {
+    line.push_back(static_cast<char>(c));
+  }
+
+  return line;
+}
+
+/**
+ * @Brief  Write a segment as "cost n name1 ... nameN"
+ */
+static void write_segment(FILE* output, const RouteSegment& segment) {
+  std::fprintf(output, "%.17g %zu", segment.cost, segment.chargers.size());
+  for (auto& charger : segment.chargers) {
+    std::fprintf(output, " %s", charger.c_str());
+  }
+  std::fprintf(output, "\n");
+}
+
+/**
+ * @Brief  Read a segment written by write_segment
+ *
+ *         A segment without stations has no route
+ */
+static RouteSegment read_segment(FILE* input) {
+  std::stringstream line_stream(read_line(input));
+  RouteSegment segment;
+  std::string cost;
+  size_t num_of_chargers = 0;
+  line_stream >> cost >> num_of_chargers;
+  segment.cost = (num_of_chargers > 0) ? std::stod(cost) :
+    std::numeric_limits<double>::infinity();
+
+  std::string charger;
+  for (size_t i=0; i < num_of_chargers && line_stream >> charger; ++i) {
+    segment.chargers.push_back(charger);
+  }
+
+  return segment;
+}
+
+/**
+ * @Brief  Write the stations of a region as network lines
+ *         for database::load_network
+ */
+static std::string write_shard(const Region& region) {
+  std::string shard;
+  char line[256];
+  for (auto& name : region.chargers) {
+    auto charger = database::get_charger_record(name);
+    std::snprintf(line, sizeof(line), "%s %.17g %.17g %.17g\n",
+                  charger.name.c_str(), charger.lat, charger.lon, charger.rate);
+    shard += line;
+  }
+
+  return shard;
+}
+
+/**
+ * @Brief  Distance from a station to a meridian
+ */
+static double distance_to_lon(const row& charger, double lon) {
+  return utility::calc_great_distance(
+    charger.lat, charger.lat, charger.lon, lon);
+}
+
+std::vector<Region> partition_regions(int num_of_regions) {
+  if (num_of_regions <= 0) {
+    throw std::invalid_argument("Number of regions has to be positive");
+  }
+
+  std::vector<int> ids(database::num_of_chargers());
+  for (int i=0; i < ids.size(); ++i) {
+    ids[i] = i;
+  }
+  std::sort(ids.begin(), ids.end(), [](int a, int b) {
+    return database::get_charger_record(a).lon <
+           database::get_charger_record(b).lon;
+  });
+
+  std::vector<Region> regions(num_of_regions);
+  for (int r=0; r < num_of_regions; ++r) {
+    size_t first = ids.size() * r / num_of_regions;
+    size_t last = ids.size() * (r + 1) / num_of_regions;
+    auto& region = regions[r];
+    for (size_t i=first; i < last; ++i) {
+      region.chargers.push_back(database::get_charger_record(ids[i]).name);
+    }
+
+    region.min_lon = (r == 0) ? -180.0 :
+      database::get_charger_record(ids[first]).lon;
+    region.max_lon = (r + 1 == num_of_regions) ? 180.0 :
+      database::get_charger_record(ids[last]).lon;
+  }
+
+  // Boundary stations are picked evenly in latitude
+  // among the stations close to each inner edge
+  for (int r=0; r < num_of_regions; ++r) {
+    auto& region = regions[r];
+    std::unordered_set<std::string> boundary_set;
+    for (int side=0; side < 2; ++side) {
+      bool has_neighbor = (side == 0) ? r > 0 : r + 1 < num_of_regions;
+      if (!has_neighbor) {
+        continue;
+      }
+
+      double edge_lon = (side == 0) ? region.min_lon : region.max_lon;
+      std::vector<const row*> close_chargers;
+      for (auto& name : region.chargers) {
+        auto& charger = database::get_charger_record(
+          database::get_charger_id(name));
+        if (distance_to_lon(charger, edge_lon) <=
+            regionParam::BOUNDARY_WIDTH) {
+          close_chargers.push_back(&charger);
+        }
+      }
+      std::sort(close_chargers.begin(), close_chargers.end(),
+        [](const row* a, const row* b) {
+          return a->lat < b->lat;
+        });
+
+      int count = std::min<int>(close_chargers.size(),
+                                regionParam::MAX_BOUNDARY_STATIONS);
+      for (int i=0; i < count; ++i) {
+        auto& name = close_chargers[i * close_chargers.size() / count]->name;
+        if (boundary_set.insert(name).second) {
+          region.boundary_chargers.push_back(name);
+        }
+      }
+    }
+  }
+
+  return regions;
+}
+
+RegionPlanner::RegionPlanner(int num_of_regions,
+                             const VehicleProfile& vehicle):
+  regions_(partition_regions(num_of_regions)),
+  vehicle_(vehicle) {
+  for (int r=0; r < regions_.size(); ++r) {
+    for (auto& name : regions_[r].chargers) {
+      region_ids_[name] = r;
+    }
+  }
+
+  for (auto& region : regions_) {
+    std::string shard = write_shard(region);
+
+    int request_pipe[2];
+    int reply_pipe[2];
+    if (pipe(request_pipe) != 0) {
+      this->stop_workers();
+      throw std::runtime_error("Cannot create worker pipes");
+    }
+    if (pipe(reply_pipe) != 0) {
+      close(request_pipe[0]);
+      close(request_pipe[1]);
+      this->stop_workers();
+      throw std::runtime_error("Cannot create worker pipes");
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      for (int fd : {request_pipe[0], request_pipe[1],
+                     reply_pipe[0], reply_pipe[1]}) {
+        close(fd);
+      }
+      this->stop_workers();
+      throw std::runtime_error("Cannot start worker process");
+    }
+
+    if (pid == 0) {
+      // The worker only keeps its own pipes
+      for (auto& worker : workers_) {
+        close(fileno(worker.request));
+        close(fileno(worker.reply));
+      }
+      close(request_pipe[1]);
+      close(reply_pipe[0]);
+      try {
+        this->run_worker(region, shard, fdopen(request_pipe[0], "r"),
+                         fdopen(reply_pipe[1], "w"));
+      } catch (...) {
+        _exit(1);
+      }
+      _exit(0);
+    }
+
+    close(request_pipe[0]);
+    close(reply_pipe[1]);
+    workers_.push_back(
+      Worker{pid, fdopen(request_pipe[1], "w"), fdopen(reply_pipe[0], "r")});
+  }
+
+  // Every worker computes its boundary routes at the same time
+  for (auto& worker : workers_) {
+    std::fprintf(worker.request, "boundary\n");
+    std::fflush(worker.request);
+  }
+  for (auto& worker : workers_) {
+    // A worker that failed to start closes its replies
+    std::string line = read_line(worker.reply);
+    if (line.empty()) {
+      this->stop_workers();
+      throw std::runtime_error("Worker process failed to start");
+    }
+
+    int num_of_segments = std::stoi(line);
+    for (int i=0; i < num_of_segments; ++i) {
+      auto segment = read_segment(worker.reply);
+      if (!segment.chargers.empty()) {
+        boundary_routes_[segment.chargers.front()].push_back(segment);
+      }
+    }
+  }
+
+  // A direct leg between boundary stations of neighboring regions
+  // charges exactly the leg at the first station
+  for (int r=0; r + 1 < regions_.size(); ++r) {
+    for (auto& west : regions_[r].boundary_chargers) {
+      for (auto& east : regions_[r + 1].boundary_chargers) {
+        auto west_charger = database::get_charger_record(west);
+        auto east_charger = database::get_charger_record(east);
+        double dist = utility::calc_great_distance(west_charger, east_charger);
+        if (dist > vehicle_.full_charge) {
+          continue;
+        }
+
+        boundary_routes_[west].push_back(RouteSegment{{west, east},
+          dist / west_charger.rate + dist / vehicle_.speed});
+        boundary_routes_[east].push_back(RouteSegment{{east, west},
+          dist / east_charger.rate + dist / vehicle_.speed});
+      }
+    }
+  }
+}
+
+RegionPlanner::~RegionPlanner() {
+  this->stop_workers();
+}
+
+void RegionPlanner::stop_workers() {
+  // A closed request pipe ends the worker like a quit request,
+  // and also reaches a worker that already exited
+  for (auto& worker : workers_) {
+    std::fclose(worker.request);
+    std::fclose(worker.reply);
+    waitpid(worker.pid, nullptr, 0);
+  }
+  workers_.clear();
+}
+
+void RegionPlanner::run_worker(const Region& region, const std::string& shard,
+                               FILE* request, FILE* reply) {
+  // The state of the stations is kept across loading the shard
+  struct ChargerState {
+    bool available;
+    std::unique_ptr<StationTimeProfile> time_profile;
+    std::shared_ptr<const ChargingCurve> charging_curve;
+  };
+  std::vector<ChargerState> charger_states;
+  for (auto& name : region.chargers) {
+    auto time_profile = database::get_time_profile(name);
+    charger_states.push_back(ChargerState{
+      database::charger_available(name),
+      time_profile ? make_unique<StationTimeProfile>(*time_profile) :
+                     nullptr,
+      database::get_charging_curve(name)});
+  }
+
+  // Only the stations of the region are kept
+  std::stringstream shard_stream(shard);
+  database::load_network(shard_stream);
+  for (int i=0; i < region.chargers.size(); ++i) {
+    auto& name = region.chargers[i];
+    auto& state = charger_states[i];
+    if (!state.available) {
+      database::set_charger_available(name, false);
+    }
+    if (state.time_profile) {
+      database::set_time_profile(name, *state.time_profile);
+    }
+    if (state.charging_curve) {
+      database::set_charging_curve(name, *state.charging_curve);
+    }
+  }
+
+  // Searches from the same station with the same charge reach every
+  // station of the region at once, so the last one is kept
+  std::string last_start;
+  double last_init_charge = -1;
+  std::unordered_map<std::string, RouteSegment> last_segments;
+
+  auto solve_segment = [&](const std::string& start,
+                           const std::string& goal,
+                           double init_charge) {
+    if (start != last_start || init_charge != last_init_charge) {
+      last_start = start;
+      last_init_charge = init_charge;
+      last_segments.clear();
+
+      VehicleProfile vehicle(vehicle_.full_charge, vehicle_.speed,
+                             init_charge);
+      ReachabilitySolver reach_solver(
+        start, std::numeric_limits<double>::infinity(), vehicle);
+      reach_solver.solve([&last_segments](const ReachableCharger& reached) {
+        last_segments[reached.name] =
+          RouteSegment{reached.chargers, reached.arrival_time};
+      });
+    }
+
+    auto segment = last_segments.find(goal);
+    if (segment == last_segments.end() || start == goal) {
+      return RouteSegment{{}, std::numeric_limits<double>::infinity()};
+    }
+    return segment->second;
+  };
+
+  std::string line;
+  while (!(line = read_line(request)).empty()) {
+    std::stringstream line_stream(line);
+    std::string command;
+    line_stream >> command;
+
+    if (command == "route") {
+      std::string start;
+      std::string goal;
+      double init_charge;
+      line_stream >> start >> goal >> init_charge;
+      write_segment(reply, solve_segment(start, goal, init_charge));
+
+    } else if (command == "boundary") {
+      // Leaving a boundary station the car has no charge left
+      std::vector<RouteSegment> segments;
+      for (auto& start : region.boundary_chargers) {
+        for (auto& goal : region.boundary_chargers) {
+          if (start != goal) {
+            segments.push_back(solve_segment(start, goal, 0.0));
+          }
+        }
+      }
+
+      std::fprintf(reply, "%zu\n", segments.size());
+      for (auto& segment : segments) {
+        write_segment(reply, segment);
+      }
+
+    } else if (command == "stats") {
+      std::fprintf(reply, "%d %zu\n", database::num_of_chargers(),
+                   alloc_tracker::private_memory());
+
+    } else {
+      break;
+    }
+    std::fflush(reply);
+  }
+}
+
+void RegionPlanner::send_route_request(int region_id,
+                                       const std::string& start_charger,
+                                       const std::string& goal_charger,
+                                       double init_charge) {
+  std::fprintf(workers_[region_id].request, "route %s %s %.17g\n",
+               start_charger.c_str(), goal_charger.c_str(), init_charge);
+  std::fflush(workers_[region_id].request);
+}
+
+RouteResult RegionPlanner::solve_route(const std::string& start_charger,
+                                       const std::string& goal_charger) {
+  int start_region = this->region_id(start_charger);
+  int goal_region = this->region_id(goal_charger);
+  auto& start_boundary = regions_[start_region].boundary_chargers;
+  auto& goal_boundary = regions_[goal_region].boundary_chargers;
+
+  // The start and goal are connected to the boundary stations of
+  // their regions, and directly when they share a region
+  for (auto& boundary : start_boundary) {
+    this->send_route_request(start_region, start_charger, boundary,
+                             vehicle_.init_charge);
+  }
+  for (auto& boundary : goal_boundary) {
+    this->send_route_request(goal_region, boundary, goal_charger, 0.0);
+  }
+  if (start_region == goal_region) {
+    this->send_route_request(start_region, start_charger, goal_charger,
+                             vehicle_.init_charge);
+  }
+
+  std::unordered_map<std::string, std::vector<RouteSegment>> query_routes;
+  for (int i=0; i < start_boundary.size(); ++i) {
+    auto segment = read_segment(workers_[start_region].reply);
+    if (!segment.chargers.empty()) {
+      query_routes[start_charger].push_back(segment);
+    }
+  }
+  for (int i=0; i < goal_boundary.size(); ++i) {
+    auto segment = read_segment(workers_[goal_region].reply);
+    if (!segment.chargers.empty()) {
+      query_routes[segment.chargers.front()].push_back(segment);
+    }
+  }
+  if (start_region == goal_region) {
+    auto segment = read_segment(workers_[start_region].reply);
+    if (!segment.chargers.empty()) {
+      query_routes[start_charger].push_back(segment);
+    }
+  }
+
+  // Dijkstra over the segments between boundary stations
+  typedef std::pair<double, std::string> CostAndCharger;
+  std::priority_queue<CostAndCharger, std::vector<CostAndCharger>,
+                      std::greater<CostAndCharger>> charger_queue;
+  std::unordered_map<std::string, double> best_costs;
+  std::unordered_map<std::string, const RouteSegment*> best_segments;
+  charger_queue.emplace(0.0, start_charger);
+  best_costs[start_charger] = 0.0;
+
+  while (!charger_queue.empty()) {
+    auto curr = charger_queue.top();
+    charger_queue.pop();
+    if (curr.first > best_costs[curr.second]) {
+      continue;
+    }
+    if (curr.second == goal_charger) {
+      break;
+    }
+
+    for (auto routes : {&boundary_routes_, &query_routes}) {
+      auto segments = routes->find(curr.second);
+      if (segments == routes->end()) {
+        continue;
+      }
+
+      for (auto& segment : segments->second) {
+        auto& next = segment.chargers.back();
+        double cost = curr.first + segment.cost;
+        auto best_cost = best_costs.find(next);
+        if (best_cost == best_costs.end() || cost < best_cost->second) {
+          best_costs[next] = cost;
+          best_segments[next] = &segment;
+          charger_queue.emplace(cost, next);
+        }
+      }
+    }
+  }
+
+  if (best_segments.count(goal_charger) == 0) {
+    return RouteResult();
+  }
+
+  // Join the segments from the goal back to the start
+  std::vector<const RouteSegment*> segments;
+  for (auto charger = goal_charger; charger != start_charger;
+       charger = best_segments[charger]->chargers.front()) {
+    segments.push_back(best_segments[charger]);
+  }
+  std::reverse(segments.begin(), segments.end());
+
+  std::vector<std::string> chargers = {start_charger};
+  for (auto segment : segments) {
+    for (int i=1; i < segment->chargers.size(); ++i) {
+      // Cut the loop when a station is visited again
+      auto visited = std::find(chargers.begin(), chargers.end(),
+                               segment->chargers[i]);
+      chargers.erase(visited, chargers.end());
+      chargers.push_back(segment->chargers[i]);
+    }
+  }
+
+  // The charging plan of the whole route is optimized again
+  Path route(start_charger, goal_charger, vehicle_);
+  for (int i=1; i < chargers.size(); ++i) {
+    route.add_charger(chargers[i]);
+  }
+
+  return route.to_route_result();
+}
+
+std::string RegionPlanner::solve(const std::string& start_charger,
+                                 const std::string& goal_charger) {
+  return route::to_string(this->solve_route(start_charger, goal_charger));
+}
+
+const std::vector<Region>& RegionPlanner::regions() const {
+  return regions_;
+}
+
+std::vector<RegionWorkerStats> RegionPlanner::worker_stats() {
+  for (auto& worker : workers_) {
+    std::fprintf(worker.request, "stats\n");
+    std::fflush(worker.request);
+  }
+
+  std::vector<RegionWorkerStats> stats;
+  for (auto& worker : workers_) {
+    std::stringstream line_stream(read_line(worker.reply));
+    RegionWorkerStats worker_stats{0, 0};
+    line_stream >> worker_stats.num_of_chargers >> worker_stats.private_memory;
+    stats.push_back(worker_stats);
+  }
+
+  return stats;
+}
+
+int RegionPlanner::region_id(const std::string& name) const {
+  auto region_id = region_ids_.find(name);
+  if (region_id == region_ids_.end()) {
+    throw std::invalid_argument("Charger not in database");
+  }
+
+  return region_id->second;
+}
@@ -0,0 +1,89 @@
+/* route_evaluator.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "utility.h"
+#include "route_evaluator.h"
+
+RouteEvaluation evaluator::evaluate_route(
+    const std::string& solution, const VehicleProfile& vehicle) {
+  RouteEvaluation evaluation;
+
+  // Split the answer string into names and charge times
+  std::vector<std::string> elements;
+  std::stringstream solution_stream(solution);
+  std::string element;
+  while (std::getline(solution_stream, element, ',')) {
+    auto first = element.find_first_not_of(" \t\n");
+    auto last = element.find_last_not_of(" \t\n");
+    if (first != std::string::npos) {
+      elements.push_back(element.substr(first, last - first + 1));
+    }
+  }
+
+  // A charge time follows every charger except the goal,
+  // and the start when the car starts with enough charge
+  std::vector<row> records;
+  std::vector<double> charge_times;
+  for (auto& curr_element : elements) {
+    std::stringstream time_stream(curr_element);
+    double charge_time = 0.0;
+    if (time_stream >> charge_time && time_stream.eof() &&
+        !records.empty()) {
+      charge_times.back() += charge_time;
+      continue;
+    }
+
+    try {
+      records.push_back(database::get_charger_record(curr_element));
+    } catch (std::invalid_argument& e) {
+      evaluation.error = "Unknown charger " + curr_element;
+      return evaluation;
+    }
+    charge_times.push_back(0.0);
+    evaluation.chargers.push_back(curr_element);
+  }
+
+  double charge = vehicle.init_charge;
+  for (int i=0; i < records.size(); ++i) {
+    // A charging curve slows down charging as the battery fills up
+    auto curve = database::get_charging_curve(records[i].name);
+    if (curve != nullptr) {
+      charge = curve->charge_after(charge, charge_times[i],
+                                   vehicle.full_charge, records[i].rate);
+    } else {
+      charge += charge_times[i] * records[i].rate;
+    }
+    evaluation.cost += charge_times[i];
+
+    // Charge over full charge is lost, as in the checker program
+    charge = std::min(charge, vehicle.full_charge);
+
+    if (i + 1 == records.size()) {
+      break;
+    }
+
+    double dist = utility::calc_great_distance(records[i], records[i + 1]);
+    charge -= dist;
+    evaluation.cost += dist / vehicle.speed;
+
+    if (charge < -evaluatorParam::CHARGE_TOLERANCE) {
+      evaluation.error = "Out of charge before " + records[i + 1].name;
+      return evaluation;
+    }
+  }
+
+  if (evaluation.chargers.size() < 2) {
+    evaluation.error = "Route requires start and goal chargers";
+    return evaluation;
+  }
+
+  evaluation.valid = true;
+  return evaluation;
+}
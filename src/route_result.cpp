@@ -0,0 +1,70 @@
+/* route_result.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include "utility.h"
+#include "route_result.h"
+
+/**
+ * @Brief  Append formatted text at an offset of the buffer,
+ *         keeping count of the full length when the buffer is full
+ */
+template <typename... Args>
+static void append(char* buffer, size_t size, size_t& length,
+                   const char* format, Args... args) {
+  char* position = (length < size) ? buffer + length : nullptr;
+  size_t space = (length < size) ? size - length : 0;
+  int written = std::snprintf(position, space, format, args...);
+  if (written > 0) {
+    length += written;
+  }
+}
+
+size_t route::format(const RouteResult& result, char* buffer, size_t size) {
+  size_t length = 0;
+  if (size > 0) {
+    buffer[0] = '\0';
+  }
+  if (result.status == RouteStatus::NO_ROUTE) {
+    return length;
+  }
+
+  int last = static_cast<int>(result.charger_ids.size()) - 1;
+  for (int i=0; i <= last; ++i) {
+    auto& name = database::get_charger_record(result.charger_ids[i]).name;
+    append(buffer, size, length, "%s", name.c_str());
+    if (i == last) {
+      break;
+    }
+    append(buffer, size, length, ", ");
+
+    // The start charger only has a charge time
+    // when the car does not start with enough charge
+    if (i > 0 || result.charge_times[i] > 0) {
+      // Round up so that the charge is never short of the plan
+      double charge_time = std::ceil(result.charge_times[i] * 1e5) / 1e5;
+      append(buffer, size, length, "%.5f, ", charge_time);
+    }
+  }
+
+  return length;
+}
+
+std::string route::to_string(const RouteResult& result) {
+  char buffer[1024];
+  size_t length = format(result, buffer, sizeof(buffer));
+  if (length < sizeof(buffer)) {
+    return std::string(buffer, length);
+  }
+
+  // Only very long routes need a buffer on heap
+  std::string solution(length + 1, '\0');
+  format(result, &solution[0], solution.size());
+  solution.resize(length);
+  return solution;
+}
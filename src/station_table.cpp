@@ -0,0 +1,50 @@
+/* station_table.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <cstring>
+#include <stdexcept>
+
+#include "station_table.h"
+#include "station_table_data.h"
+
+int station_table::find(const char* name, size_t length) {
+  using namespace station_table_data;
+  uint64_t value = hash(name, length);
+  uint32_t bucket = (value >> 32) % NUM_OF_BUCKETS;
+  uint32_t slot = displace(value, SEEDS[bucket]) % NUM_OF_STATIONS;
+
+  // A name outside the table still lands in some slot,
+  // so the name in the slot has to be compared
+  int id = IDS[slot];
+  if (LENGTHS[id] != length || std::memcmp(NAMES[id], name, length) != 0) {
+    return -1;
+  }
+  return id;
+}
+
+int station_table::find(const std::string& name) {
+  return find(name.data(), name.size());
+}
+
+const char* station_table::name(int id) {
+  using namespace station_table_data;
+  if (id < 0 || id >= NUM_OF_STATIONS) {
+    return nullptr;
+  }
+  return NAMES[id];
+}
+
+station_table::Station station_table::station(int id) {
+  using namespace station_table_data;
+  if (id < 0 || id >= NUM_OF_STATIONS) {
+    throw std::invalid_argument("No built-in station " + std::to_string(id));
+  }
+  return Station{NAMES[id], LATS[id], LONS[id], RATES[id]};
+}
+
+int station_table::size() {
+  return station_table_data::NUM_OF_STATIONS;
+}
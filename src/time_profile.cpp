@@ -0,0 +1,54 @@
+/* time_profile.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "utility.h"
+#include "time_profile.h"
+
+TimeProfile::TimeProfile(const std::vector<double>& values):
+  values_(values.begin(), values.end()),
+  step_{constant::DAY_LENGTH / std::max<size_t>(1, values.size())} {
+  if (values_.empty()) {
+    throw std::invalid_argument("Time profile requires at least one value");
+  }
+}
+
+double TimeProfile::value(double time) const {
+  // Wrap the time into a day
+  double day_time = std::fmod(time, constant::DAY_LENGTH);
+  if (day_time < 0) {
+    day_time += constant::DAY_LENGTH;
+  }
+
+  double position = day_time / step_;
+  int i = static_cast<int>(position) % values_.size();
+  int next = (i + 1) % values_.size();
+  double fraction = position - std::floor(position);
+
+  return values_[i] + fraction * (values_[next] - values_[i]);
+}
+
+bool TimeProfile::is_fifo() const {
+  for (int i=0; i < values_.size(); ++i) {
+    int next = (i + 1) % values_.size();
+    if ((values_[next] - values_[i]) / step_ < -1.0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+double TimeProfile::min_value() const {
+  return *std::min_element(values_.begin(), values_.end());
+}
+
+double TimeProfile::max_value() const {
+  return *std::max_element(values_.begin(), values_.end());
+}
@@ -0,0 +1,140 @@
+/* trace.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include "utility.h"
+#include "trace.h"
+
+/**
+ * @Brief  Ring buffer of the events of one thread
+ */
+struct TraceRing {
+  std::vector<TraceEvent> events;
+  size_t next = 0;
+  size_t count = 0;
+  bool enabled = false;
+  std::chrono::steady_clock::time_point start_time;
+};
+
+static TraceRing& trace_ring() {
+  thread_local TraceRing ring;
+  return ring;
+}
+
+static const char* kind_name(TraceKind kind) {
+  switch (kind) {
+    case TraceKind::EXPAND:
+      return "expand";
+    case TraceKind::RESET:
+      return "reset";
+    case TraceKind::CANDIDATE:
+      return "candidate";
+  }
+  return "unknown";
+}
+
+void trace::start(size_t capacity) {
+  auto& ring = trace_ring();
+  ring.events.assign(std::max<size_t>(1, capacity), TraceEvent());
+  ring.next = 0;
+  ring.count = 0;
+  ring.enabled = true;
+  ring.start_time = std::chrono::steady_clock::now();
+}
+
+void trace::stop() {
+  trace_ring().enabled = false;
+}
+
+bool trace::enabled() {
+  return trace_ring().enabled;
+}
+
+void trace::record(TraceKind kind, int charger_id,
+                   double goal_weight, size_t queue_size) {
+  auto& ring = trace_ring();
+  if (!ring.enabled) {
+    return;
+  }
+
+  auto& event = ring.events[ring.next];
+  event.timestamp = std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now() - ring.start_time).count();
+  event.charger_id = charger_id;
+  event.kind = kind;
+  event.goal_weight = goal_weight;
+  event.queue_size = queue_size;
+
+  ring.next = (ring.next + 1) % ring.events.size();
+  ring.count = std::min(ring.count + 1, ring.events.size());
+}
+
+std::vector<TraceEvent> trace::events() {
+  auto& ring = trace_ring();
+  std::vector<TraceEvent> events;
+  size_t capacity = ring.events.size();
+  for (size_t i=0; i < ring.count; ++i) {
+    events.push_back(ring.events[(ring.next + capacity - ring.count + i) %
+                                 capacity]);
+  }
+
+  return events;
+}
+
+std::string trace::to_chrome_json(const std::vector<TraceEvent>& events) {
+  std::stringstream json;
+  json << std::fixed << std::setprecision(3);
+  json << "{\"traceEvents\":[";
+
+  bool first = true;
+  for (auto& event : events) {
+    auto& name = database::get_charger_record(event.charger_id).name;
+    json << (first ? "" : ",") << "\n" <<
+      "{\"name\":\"" << kind_name(event.kind) << "\",\"ph\":\"i\"," <<
+      "\"s\":\"t\",\"pid\":1,\"tid\":1,\"ts\":" << event.timestamp <<
+      ",\"args\":{\"charger\":\"" << name << "\"}},\n" <<
+      "{\"name\":\"search\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" <<
+      event.timestamp << ",\"args\":{\"goal_weight\":" <<
+      event.goal_weight << ",\"queue_size\":" << event.queue_size << "}}";
+    first = false;
+  }
+
+  json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return json.str();
+}
+
+std::string trace::to_geojson(const std::vector<TraceEvent>& events) {
+  std::map<int, int> expansion_counts;
+  for (auto& event : events) {
+    if (event.kind == TraceKind::EXPAND) {
+      expansion_counts[event.charger_id]++;
+    }
+  }
+
+  std::stringstream geojson;
+  geojson << std::setprecision(8);
+  geojson << "{\"type\":\"FeatureCollection\",\"features\":[";
+
+  bool first = true;
+  for (auto& expansion_count : expansion_counts) {
+    auto& charger = database::get_charger_record(expansion_count.first);
+    // GeoJSON puts longitude before latitude
+    geojson << (first ? "" : ",") << "\n" <<
+      "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\"," <<
+      "\"coordinates\":[" << charger.lon << "," << charger.lat << "]}," <<
+      "\"properties\":{\"name\":\"" << charger.name << "\"," <<
+      "\"expansions\":" << expansion_count.second << "}}";
+    first = false;
+  }
+
+  geojson << "\n]}\n";
+  return geojson.str();
+}
@@ -0,0 +1,258 @@
+/* trip_planner.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "reachability_solver.h"
+#include "trip_planner.h"
+
+TripPlanner::TripPlanner(const std::string& start_charger,
+                         const std::vector<std::string>& waypoints,
+                         const std::string& goal_charger,
+                         const VehicleProfile& vehicle,
+                         int num_of_threads):
+  vehicle_(vehicle),
+  num_of_threads_{num_of_threads} {
+  if (num_of_threads_ <= 0) {
+    num_of_threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  stops_.push_back(start_charger);
+  stops_.insert(stops_.end(), waypoints.begin(), waypoints.end());
+  stops_.push_back(goal_charger);
+
+  // Validate every stop before searching on other threads
+  for (auto& stop : stops_) {
+    database::get_charger_record(stop);
+  }
+}
+
+void TripPlanner::search_legs() {
+  int num_of_stops = stops_.size();
+  leg_times_.assign(num_of_stops, std::vector<double>(
+    num_of_stops, std::numeric_limits<double>::infinity()));
+  leg_chargers_.assign(num_of_stops,
+    std::vector<std::vector<std::string>>(num_of_stops));
+
+  // Every thread takes the next stop without legs,
+  // and no leg leaves the goal
+  std::atomic<int> next_stop{0};
+  auto worker = [this, &next_stop, num_of_stops]() {
+    int from;
+    while ((from = next_stop++) < num_of_stops - 1) {
+      this->search_legs_from(from);
+    }
+  };
+
+  int num_of_threads = std::min(num_of_threads_, num_of_stops - 1);
+  std::vector<std::thread> threads;
+  for (int i=1; i < num_of_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void TripPlanner::search_legs_from(int from) {
+  // The car leaves a waypoint with the charge it arrived with, which
+  // is unknown before the order is chosen, so every leg after the start
+  // leaves empty. Joining the legs can only make the trip faster.
+  VehicleProfile vehicle = vehicle_;
+  if (from > 0) {
+    vehicle.init_charge = 0.0;
+  }
+
+  std::vector<std::string> targets(stops_.begin() + 1, stops_.end());
+  ReachabilitySolver reach_solver(stops_[from],
+                                  std::numeric_limits<double>::infinity(),
+                                  vehicle);
+  std::unordered_map<std::string, ReachableCharger> reached_targets;
+  for (auto& reached : reach_solver.solve_targets(targets)) {
+    reached_targets.emplace(reached.name, reached);
+  }
+
+  // Each thread writes only the row of its own stop
+  for (int to=1; to < stops_.size(); ++to) {
+    auto reached = reached_targets.find(stops_[to]);
+    if (to == from || reached == reached_targets.end()) {
+      continue;
+    }
+    leg_times_[from][to] = reached->second.arrival_time;
+    leg_chargers_[from][to] = reached->second.chargers;
+  }
+}
+
+double TripPlanner::order_time(const std::vector<int>& order) const {
+  double total_time = 0.0;
+  int from = 0;
+  for (int to : order) {
+    total_time += leg_times_[from][to];
+    from = to;
+  }
+
+  return total_time + leg_times_[from][stops_.size() - 1];
+}
+
+std::vector<int> TripPlanner::exact_order() const {
+  const double inf = std::numeric_limits<double>::infinity();
+  int num_of_waypoints = stops_.size() - 2;
+  int goal = num_of_waypoints + 1;
+  int num_of_sets = 1 << num_of_waypoints;
+
+  // times[set][last] is the fastest time from the start through
+  // the waypoints of the set, ending at waypoint last + 1
+  std::vector<std::vector<double>> times(num_of_sets,
+    std::vector<double>(num_of_waypoints, inf));
+  std::vector<std::vector<int>> parents(num_of_sets,
+    std::vector<int>(num_of_waypoints, -1));
+  for (int last=0; last < num_of_waypoints; ++last) {
+    times[1 << last][last] = leg_times_[0][last + 1];
+  }
+
+  for (int set=1; set < num_of_sets; ++set) {
+    for (int last=0; last < num_of_waypoints; ++last) {
+      if (!(set & (1 << last)) || times[set][last] == inf) {
+        continue;
+      }
+      for (int next=0; next < num_of_waypoints; ++next) {
+        if (set & (1 << next)) {
+          continue;
+        }
+        int next_set = set | (1 << next);
+        double time = times[set][last] + leg_times_[last + 1][next + 1];
+        if (time < times[next_set][next]) {
+          times[next_set][next] = time;
+          parents[next_set][next] = last;
+        }
+      }
+    }
+  }
+
+  // The fastest last waypoint before the goal
+  int full_set = num_of_sets - 1;
+  int best_last = 0;
+  double best_time = inf;
+  for (int last=0; last < num_of_waypoints; ++last) {
+    double time = times[full_set][last] + leg_times_[last + 1][goal];
+    if (time < best_time) {
+      best_time = time;
+      best_last = last;
+    }
+  }
+
+  std::vector<int> order;
+  for (int set=full_set, last=best_last; set != 0 && last >= 0;) {
+    order.push_back(last + 1);
+    int parent = parents[set][last];
+    set &= ~(1 << last);
+    last = parent;
+  }
+  std::reverse(order.begin(), order.end());
+
+  return order;
+}
+
+std::vector<int> TripPlanner::heuristic_order() const {
+  int num_of_waypoints = stops_.size() - 2;
+
+  // Nearest neighbor from the start
+  std::vector<int> order;
+  std::vector<bool> visited(num_of_waypoints + 1, false);
+  int from = 0;
+  for (int i=0; i < num_of_waypoints; ++i) {
+    int nearest = -1;
+    for (int to=1; to <= num_of_waypoints; ++to) {
+      if (!visited[to] && (nearest < 0 ||
+          leg_times_[from][to] < leg_times_[from][nearest])) {
+        nearest = to;
+      }
+    }
+    visited[nearest] = true;
+    order.push_back(nearest);
+    from = nearest;
+  }
+
+  // Reverse parts of the order until no reversal is faster. Legs are
+  // not the same time both ways, so the whole order is timed again.
+  double best_time = this->order_time(order);
+  bool improved = true;
+  while (improved) {
+    improved = false;
+    for (int i=0; i < num_of_waypoints; ++i) {
+      for (int j=i + 1; j < num_of_waypoints; ++j) {
+        std::reverse(order.begin() + i, order.begin() + j + 1);
+        double time = this->order_time(order);
+        if (time < best_time - 1e-9) {
+          best_time = time;
+          improved = true;
+        } else {
+          std::reverse(order.begin() + i, order.begin() + j + 1);
+        }
+      }
+    }
+  }
+
+  return order;
+}
+
+RouteResult TripPlanner::solve_route() {
+  this->search_legs();
+
+  int num_of_waypoints = stops_.size() - 2;
+  auto order = (num_of_waypoints <= tripParam::MAX_EXACT_WAYPOINTS) ?
+    this->exact_order() : this->heuristic_order();
+
+  visit_order_.clear();
+  for (int stop : order) {
+    visit_order_.push_back(stops_[stop]);
+  }
+
+  if (this->order_time(order) == std::numeric_limits<double>::infinity()) {
+    return RouteResult();
+  }
+
+  // The trip has no goal, so the car charges just enough to arrive,
+  // and a station passed on an earlier leg can be visited again
+  order.push_back(stops_.size() - 1);
+  Path route(stops_.front(), "", vehicle_);
+  int from = 0;
+  for (int to : order) {
+    auto& chargers = leg_chargers_[from][to];
+    for (int i=1; i < chargers.size(); ++i) {
+      route.add_stop(chargers[i], utility::calc_great_distance(
+        chargers[i - 1], chargers[i]));
+    }
+    from = to;
+  }
+
+  return route.to_route_result();
+}
+
+std::string TripPlanner::solve() {
+  return route::to_string(this->solve_route());
+}
+
+const std::vector<std::string>& TripPlanner::visit_order() const {
+  return visit_order_;
+}
+
+double TripPlanner::leg_time(int from, int to) {
+  if (from < 0 || to < 0 || from >= stops_.size() || to >= stops_.size()) {
+    throw std::invalid_argument("No such stop");
+  }
+  if (leg_times_.empty()) {
+    this->search_legs();
+  }
+
+  return leg_times_[from][to];
+}
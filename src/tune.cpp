@@ -0,0 +1,270 @@
+/* tune.cpp
+ *
+ * Author: Chang-Hong Chen
+ * Email: longhongc@gmail.com
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "path_solver.h"
+#include "route_evaluator.h"
+
+/**
+ * @Brief  Latency and cost of one setting over the workload
+ */
+struct TuneResult {
+  PathSolverConfig config;
+  std::vector<double> latencies;  // ms
+  std::vector<double> costs;  // hr, infinity if the route is invalid
+  double p95_latency = 0.0;  // ms
+  double mean_gap = 0.0;
+  double p99_gap = 0.0;
+  double max_gap = 0.0;
+  int valid_count = 0;
+};
+
+/**
+ * @Brief  Split a comma separated list of numbers
+ */
+std::vector<double> parse_list(const std::string& list) {
+  std::vector<double> values;
+  std::stringstream list_stream(list);
+  std::string value;
+  while (std::getline(list_stream, value, ',')) {
+    values.push_back(std::stod(value));
+  }
+
+  return values;
+}
+
+/**
+ * @Brief  Solve the workload with one setting and time every query
+ */
+TuneResult run_config(
+    const std::vector<std::pair<std::string, std::string>>& workload,
+    const PathSolverConfig& config) {
+  TuneResult result;
+  result.config = config;
+  for (auto& query : workload) {
+    auto start_time = std::chrono::steady_clock::now();
+    PathSolver my_solver(query.first, query.second);
+    my_solver.set_config(config);
+    auto solution = my_solver.solve();
+    auto end_time = std::chrono::steady_clock::now();
+
+    result.latencies.push_back(std::chrono::duration<double, std::milli>(
+      end_time - start_time).count());
+
+    auto evaluation = evaluator::evaluate_route(solution);
+    result.costs.push_back(evaluation.valid ? evaluation.cost :
+      std::numeric_limits<double>::infinity());
+  }
+
+  return result;
+}
+
+/**
+ * @Brief  Whether a setting is at least as good as another in both
+ *         latency and cost gap, and better in one of them
+ */
+bool dominates(const TuneResult& a, const TuneResult& b) {
+  if (a.valid_count < b.valid_count) {
+    return false;
+  }
+  bool no_worse = a.p95_latency <= b.p95_latency && a.mean_gap <= b.mean_gap;
+  bool better = a.p95_latency < b.p95_latency || a.mean_gap < b.mean_gap ||
+    a.valid_count > b.valid_count;
+  return no_worse && better;
+}
+
+int main(int argc, char** argv) {
+  int number_of_pairs = 50;
+  int stride = 0;
+  unsigned int seed = 0;
+  std::string query_file_name;
+  std::vector<double> candidates = {1, 5, 20};
+  std::vector<double> goal_weights = {1.0, 1.5, 2.0};
+  std::vector<double> goal_weight_steps = {0.2, 0.5};
+  std::vector<double> queue_sizes = {2000, 10000};
+  std::vector<double> max_resets = {pathSolverParam::MAX_RESET};
+
+  for (int i=1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--network") {
+      database::load_network(argv[i + 1]);
+    } else if (arg == "--queries") {
+      query_file_name = argv[i + 1];
+    } else if (arg == "--pairs") {
+      number_of_pairs = std::stoi(argv[i + 1]);
+    } else if (arg == "--seed") {
+      seed = std::stoul(argv[i + 1]);
+    } else if (arg == "--stride") {
+      stride = std::max(1, std::stoi(argv[i + 1]));
+    } else if (arg == "--candidates") {
+      candidates = parse_list(argv[i + 1]);
+    } else if (arg == "--goal-weights") {
+      goal_weights = parse_list(argv[i + 1]);
+    } else if (arg == "--goal-weight-steps") {
+      goal_weight_steps = parse_list(argv[i + 1]);
+    } else if (arg == "--queue-sizes") {
+      queue_sizes = parse_list(argv[i + 1]);
+    } else if (arg == "--max-resets") {
+      max_resets = parse_list(argv[i + 1]);
+    } else {
+      std::cout << "Usage: tune [--pairs N] [--seed S] [--stride K] "
+        "[--candidates N1,...] [--goal-weights W1,...]" << std::endl;
+      std::cout << "            [--goal-weight-steps S1,...] "
+        "[--queue-sizes Q1,...] [--max-resets R1,...]" << std::endl;
+      std::cout << "            [--network network_file] "
+        "[--queries query_file]" << std::endl;
+      return -1;
+    }
+  }
+
+  // The same seed always gives the same workload,
+  // unless the queries are given as "start goal" lines
+  std::vector<std::pair<std::string, std::string>> workload;
+  if (!query_file_name.empty()) {
+    std::ifstream query_file(query_file_name);
+    std::string start;
+    std::string goal;
+    while (query_file >> start >> goal &&
+           workload.size() < number_of_pairs) {
+      workload.emplace_back(start, goal);
+    }
+  }
+
+  // Every stride-th ordered pair of stations covers the short and
+  // the long queries as often as they occur in the network
+  int num_of_chargers = database::num_of_chargers();
+  long long pair_index = 0;
+  for (int goal=0; stride > 0 && goal < num_of_chargers; ++goal) {
+    for (int start=0; start < num_of_chargers; ++start) {
+      if (start != goal && pair_index++ % stride == 0) {
+        workload.emplace_back(database::get_charger_record(start).name,
+                              database::get_charger_record(goal).name);
+      }
+    }
+  }
+
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> charger_dist(
+    0, database::num_of_chargers() - 1);
+  while (query_file_name.empty() && stride == 0 &&
+         workload.size() < number_of_pairs) {
+    int start = charger_dist(gen);
+    int goal = charger_dist(gen);
+    if (start != goal) {
+      workload.emplace_back(database::get_charger_record(start).name,
+                            database::get_charger_record(goal).name);
+    }
+  }
+
+  // Sweep the full grid of settings
+  std::vector<TuneResult> results;
+  for (double num_of_candidate : candidates) {
+    for (double goal_weight : goal_weights) {
+      for (double goal_weight_step : goal_weight_steps) {
+        for (double queue_size : queue_sizes) {
+          for (double max_reset : max_resets) {
+            PathSolverConfig config;
+            config.num_of_candidate = static_cast<int>(num_of_candidate);
+            config.default_goal_weight = goal_weight;
+            config.goal_weight_step = goal_weight_step;
+            config.max_queue_size = static_cast<int>(queue_size);
+            config.max_reset = static_cast<int>(max_reset);
+            results.push_back(run_config(workload, config));
+          }
+        }
+      }
+    }
+  }
+
+  // The cost gap of a query is measured against the best setting
+  std::vector<double> best_costs(workload.size(),
+    std::numeric_limits<double>::infinity());
+  for (auto& result : results) {
+    for (int i=0; i < workload.size(); ++i) {
+      best_costs[i] = std::min(best_costs[i], result.costs[i]);
+    }
+  }
+
+  for (auto& result : results) {
+    double total_gap = 0.0;
+    std::vector<double> gaps;
+    for (int i=0; i < workload.size(); ++i) {
+      if (result.costs[i] == std::numeric_limits<double>::infinity()) {
+        continue;
+      }
+      double gap = result.costs[i] / best_costs[i] - 1.0;
+      total_gap += gap;
+      gaps.push_back(gap);
+      result.valid_count++;
+    }
+    result.mean_gap = total_gap / std::max(1, result.valid_count);
+
+    // A small mean can hide a few much slower routes
+    std::sort(gaps.begin(), gaps.end());
+    result.p99_gap = utility::percentile(gaps, 0.99);
+    result.max_gap = gaps.empty() ? 0.0 : gaps.back();
+
+    std::sort(result.latencies.begin(), result.latencies.end());
+    result.p95_latency = utility::percentile(result.latencies, 0.95);
+  }
+
+  std::vector<TuneResult> pareto_front;
+  for (auto& result : results) {
+    bool dominated = std::any_of(results.begin(), results.end(),
+      [&result](const TuneResult& other) {
+        return dominates(other, result);
+      });
+    if (!dominated) {
+      pareto_front.push_back(result);
+    }
+  }
+  std::sort(pareto_front.begin(), pareto_front.end(),
+    [](const TuneResult& a, const TuneResult& b) {
+      return a.p95_latency < b.p95_latency;
+    });
+
+  std::cout << "Pareto front of " << results.size() << " settings over " <<
+    workload.size() << " queries" << std::endl;
+  std::cout << std::right <<
+    std::setw(6) << "cand" << std::setw(8) << "weight" <<
+    std::setw(8) << "step" << std::setw(8) << "queue" <<
+    std::setw(8) << "reset" << std::setw(10) << "p50 ms" <<
+    std::setw(10) << "p95 ms" << std::setw(10) << "max ms" <<
+    std::setw(12) << "valid" << std::setw(10) << "gap %" <<
+    std::setw(10) << "p99 gap %" << std::setw(10) << "max gap %" <<
+    std::endl;
+  for (auto& result : pareto_front) {
+    auto& config = result.config;
+    std::cout << std::fixed <<
+      std::setw(6) << config.num_of_candidate <<
+      std::setprecision(2) <<
+      std::setw(8) << config.default_goal_weight <<
+      std::setw(8) << config.goal_weight_step <<
+      std::setw(8) << config.max_queue_size <<
+      std::setw(8) << config.max_reset <<
+      std::setprecision(3) <<
+      std::setw(10) << utility::percentile(result.latencies, 0.5) <<
+      std::setw(10) << result.p95_latency <<
+      std::setw(10) << result.latencies.back() <<
+      std::setw(8) << result.valid_count << "/" << workload.size() <<
+      std::setprecision(2) <<
+      std::setw(10) << 100.0 * result.mean_gap <<
+      std::setw(10) << 100.0 * result.p99_gap <<
+      std::setw(10) << 100.0 * result.max_gap << std::endl;
+  }
+
+  return 0;
+}
@@ -5,52 +5,316 @@
  */
 
 #include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
-#include "network.h"
+#include "heuristic_cache.h"
+#include "station_table.h"
 #include "utility.h"
 
-row database::get_charger_record(std::string& name) {
-  static std::unordered_map<std::string, row> chargers_record;
-  if (chargers_record.empty()) {
-    for (auto& charger : network) {
-      chargers_record[charger.name] = charger;
+/**
+ * @Brief  The charging station records with their current charge rate
+ *
+ *         The id of a charging station is its index in records.
+ *         The built-in network finds ids in the generated station
+ *         table, and only a loaded network fills the map of ids.
+ */
+struct ChargerDatabase {
+  std::vector<row> records;
+  std::unordered_map<std::string, int> ids;
+  bool builtin = false;
+};
+
+/**
+ * @Brief  Build the database of the built-in network
+ */
+static ChargerDatabase builtin_database() {
+  // The rows come from the literals of the station table, so the
+  // std::string rows of the network array are never built
+  ChargerDatabase charger_database;
+  for (int id=0; id < station_table::size(); ++id) {
+    auto station = station_table::station(id);
+    charger_database.records.push_back(
+      row{station.name, station.lat, station.lon, station.rate});
+  }
+  charger_database.builtin = true;
+
+  return charger_database;
+}
+
+static ChargerDatabase& chargers_database() {
+  // Initialized once even when the first searches run in parallel
+  static ChargerDatabase charger_database = builtin_database();
+  return charger_database;
+}
+
+/**
+ * @Brief  The cached neighbor tables, one table for every range threshold
+ */
+static std::map<double, std::unordered_map<int, NeighborTable>>&
+neighbor_tables() {
+  static std::map<double, std::unordered_map<int, NeighborTable>> tables;
+  return tables;
+}
+
+/**
+ * @Brief  Guards the neighbor tables, which are filled lazily
+ *         by searches running in parallel
+ */
+static std::mutex& neighbor_tables_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+/**
+ * @Brief  Charging stations that are out of service
+ */
+static std::unordered_set<std::string>& unavailable_chargers() {
+  static std::unordered_set<std::string> chargers;
+  return chargers;
+}
+
+/**
+ * @Brief  Every changed charging station in order of change
+ *
+ *         The state version is the number of changes
+ */
+static std::vector<std::string>& change_log() {
+  static std::vector<std::string> log;
+  return log;
+}
+
+/**
+ * @Brief  Time-dependent settings of charging stations
+ */
+static std::unordered_map<std::string, StationTimeProfile>& time_profiles() {
+  static std::unordered_map<std::string, StationTimeProfile> profiles;
+  return profiles;
+}
+
+/**
+ * @Brief  Charging curves of charging stations
+ *
+ *         Paths keep the curves of their stations,
+ *         so a changed curve never changes a curve in use
+ */
+static std::unordered_map<std::string, std::shared_ptr<const ChargingCurve>>&
+charging_curves() {
+  static std::unordered_map<std::string,
+                            std::shared_ptr<const ChargingCurve>> curves;
+  return curves;
+}
+
+/**
+ * @Brief  Drop every cached table and runtime change
+ *         of the charging stations
+ */
+static void clear_charger_state() {
+  {
+    std::lock_guard<std::mutex> lock(neighbor_tables_mutex());
+    neighbor_tables().clear();
+  }
+  unavailable_chargers().clear();
+  change_log().clear();
+  time_profiles().clear();
+  charging_curves().clear();
+
+  // The state version starts over, so cached goal tables could match
+  heuristic::clear();
+}
+
+row database::get_charger_record(const std::string& name) {
+  return chargers_database().records[get_charger_id(name)];
+}
+
+const row& database::get_charger_record(int id) {
+  return chargers_database().records.at(id);
+}
+
+int database::get_charger_id(const std::string& name) {
+  auto& charger_database = chargers_database();
+  if (charger_database.builtin) {
+    int id = station_table::find(name);
+    if (id < 0) {
+      throw std::invalid_argument("Charger not in database");
     }
+    return id;
   }
 
-  if (chargers_record.find(name) != chargers_record.end()) {
-    return chargers_record[name];
+  auto& ids = charger_database.ids;
+  auto charger = ids.find(name);
+  if (charger != ids.end()) {
+    return charger->second;
 
   } else {
     throw std::invalid_argument("Charger not in database");
   }
 }
 
-std::vector<std::string> database::get_neighbors(std::string& name) {
-  static std::unordered_map<std::string,
-    std::vector<std::string>> neighbors_record;
+int database::num_of_chargers() {
+  return chargers_database().records.size();
+}
 
-  if (neighbors_record.find(name) != neighbors_record.end()) {
-    return neighbors_record[name];
+void database::load_network(const std::string& file_name) {
+  std::ifstream network_file(file_name);
+  if (!network_file.is_open()) {
+    throw std::invalid_argument("Cannot open network file");
   }
 
-  std::vector<std::string> neighbors;
-  for (auto charger : network) {
-    double dist = utility::calc_great_distance(
-      name, charger.name);
+  load_network(network_file);
+}
+
+void database::load_network(std::istream& network_stream) {
+  ChargerDatabase loaded_database;
+  std::string line;
+  while (std::getline(network_stream, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::stringstream line_stream(line);
+    row charger;
+    if (!(line_stream >> charger.name >> charger.lat >>
+          charger.lon >> charger.rate)) {
+      throw std::invalid_argument("Bad network line " + line);
+    }
+    if (charger.rate <= 0) {
+      throw std::invalid_argument("Charge rate has to be positive");
+    }
+    if (loaded_database.ids.count(charger.name) > 0) {
+      throw std::invalid_argument("Duplicated charger " + charger.name);
+    }
+
+    loaded_database.ids[charger.name] = loaded_database.records.size();
+    loaded_database.records.push_back(charger);
+  }
+
+  if (loaded_database.records.empty()) {
+    throw std::invalid_argument("Network file has no charger");
+  }
+
+  chargers_database() = std::move(loaded_database);
+  clear_charger_state();
+}
+
+void database::reset_network() {
+  chargers_database() = builtin_database();
+  clear_charger_state();
+}
+
+const NeighborTable& database::get_neighbor_table(int id, double range) {
+  // Tables are never erased during a search, and elements of
+  // the maps keep their address, so the reference stays valid
+  std::lock_guard<std::mutex> lock(neighbor_tables_mutex());
+  auto& neighbor_table = neighbor_tables()[range];
+
+  auto cached_table = neighbor_table.find(id);
+  if (cached_table != neighbor_table.end()) {
+    return cached_table->second;
+  }
+
+  auto& records = chargers_database().records;
+  auto& unavailable = unavailable_chargers();
+  NeighborTable neighbors;
+  for (int i=0; i < records.size(); ++i) {
+    if (unavailable.count(records[i].name) > 0) {
+      continue;
+    }
+
+    double dist = utility::calc_great_distance(records[id], records[i]);
 
     // Find neighbors within the maximum charging value
-    if (dist <= constant::FULL_CHARGE) {
-      neighbors.push_back(charger.name);
+    if (dist <= range) {
+      neighbors.ids.push_back(i);
+      neighbors.dists.push_back(dist);
     }
   }
-  neighbors_record[name] = neighbors;
+
+  return neighbor_table[id] = neighbors;
+}
+
+std::vector<std::string> database::get_neighbors(
+    std::string& name, double range) {
+  auto& neighbor_table = get_neighbor_table(get_charger_id(name), range);
+
+  std::vector<std::string> neighbors;
+  for (int id : neighbor_table.ids) {
+    neighbors.push_back(get_charger_record(id).name);
+  }
 
   return neighbors;
 }
 
+void database::set_charger_available(
+    const std::string& name, bool available) {
+  auto charger = get_charger_record(name);
+
+  auto& unavailable = unavailable_chargers();
+  if (available == (unavailable.count(name) == 0)) {
+    return;
+  }
+
+  if (available) {
+    unavailable.erase(name);
+  } else {
+    unavailable.insert(name);
+  }
+
+  // Only the neighbor tables within range of the charger are affected
+  std::lock_guard<std::mutex> lock(neighbor_tables_mutex());
+  for (auto& range_tables : neighbor_tables()) {
+    double range = range_tables.first;
+    auto& tables = range_tables.second;
+
+    for (auto it = tables.begin(); it != tables.end();) {
+      auto& neighbor = get_charger_record(it->first);
+      if (utility::calc_great_distance(charger, neighbor) <= range) {
+        it = tables.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  change_log().push_back(name);
+}
+
+bool database::charger_available(const std::string& name) {
+  return unavailable_chargers().count(name) == 0;
+}
+
+void database::set_charge_rate(const std::string& name, double rate) {
+  if (rate <= 0) {
+    throw std::invalid_argument("Charge rate has to be positive");
+  }
+
+  // Neighbor tables only depend on distance, so nothing is invalidated
+  chargers_database().records[get_charger_id(name)].rate = rate;
+  change_log().push_back(name);
+}
+
+unsigned long database::state_version() {
+  return change_log().size();
+}
+
+std::set<std::string> database::changed_chargers(
+    unsigned long since_version) {
+  auto& log = change_log();
+  std::set<std::string> changed;
+  for (auto i=since_version; i < log.size(); ++i) {
+    changed.insert(log[i]);
+  }
+
+  return changed;
+}
+
 double utility::degree_to_radians(double deg) {
   return deg * M_PI / 180;
 }
@@ -82,3 +346,145 @@ double utility::calc_great_distance(
     std::string&& charger1, std::string&& charger2) {
   return calc_great_distance(charger1, charger2);
 }
+
+void database::set_time_profile(const std::string& name,
+                                const StationTimeProfile& profile) {
+  get_charger_record(name);
+  if (profile.rate.min_value() <= 0) {
+    throw std::invalid_argument("Charge rate must be positive");
+  }
+  if (profile.wait.min_value() < 0) {
+    throw std::invalid_argument("Wait time cannot be negative");
+  }
+  if (!profile.wait.is_fifo()) {
+    throw std::invalid_argument("Wait time profile breaks FIFO order");
+  }
+
+  auto& profiles = time_profiles();
+  auto it = profiles.find(name);
+  if (it != profiles.end()) {
+    it->second = profile;
+  } else {
+    profiles.emplace(name, profile);
+  }
+  change_log().push_back(name);
+}
+
+const StationTimeProfile* database::get_time_profile(const std::string& name) {
+  auto& profiles = time_profiles();
+  auto it = profiles.find(name);
+  if (it == profiles.end()) {
+    return nullptr;
+  }
+
+  return &it->second;
+}
+
+void database::clear_time_profile(const std::string& name) {
+  if (time_profiles().erase(name) > 0) {
+    change_log().push_back(name);
+  }
+}
+
+void database::load_time_profiles(const std::string& file_name) {
+  std::ifstream profile_file(file_name);
+  if (!profile_file.is_open()) {
+    throw std::invalid_argument("Cannot open time profile file");
+  }
+
+  std::string line;
+  while (std::getline(profile_file, line)) {
+    std::stringstream line_stream(line);
+    std::string name;
+    std::string kind;
+    if (!(line_stream >> name >> kind)) {
+      continue;
+    }
+
+    std::vector<double> values;
+    double value;
+    while (line_stream >> value) {
+      values.push_back(value);
+    }
+
+    // Keep the other kind of the current setting
+    auto current = get_time_profile(name);
+    StationTimeProfile profile = (current != nullptr) ? *current :
+      StationTimeProfile{TimeProfile({get_charger_record(name).rate}),
+                         TimeProfile({0.0})};
+
+    if (kind == "rate") {
+      profile.rate = TimeProfile(values);
+    } else if (kind == "wait") {
+      profile.wait = TimeProfile(values);
+    } else {
+      throw std::invalid_argument("Unknown time profile kind " + kind);
+    }
+    set_time_profile(name, profile);
+  }
+}
+
+void database::set_charging_curve(const std::string& name,
+                                  const ChargingCurve& curve) {
+  if (name != "*") {
+    get_charger_id(name);
+  }
+
+  charging_curves()[name] = std::make_shared<const ChargingCurve>(curve);
+  change_log().push_back(name);
+}
+
+std::shared_ptr<const ChargingCurve> database::get_charging_curve(
+    const std::string& name) {
+  auto& curves = charging_curves();
+  if (curves.empty()) {
+    return nullptr;
+  }
+
+  auto it = curves.find(name);
+  if (it == curves.end()) {
+    it = curves.find("*");
+  }
+  return (it != curves.end()) ? it->second : nullptr;
+}
+
+void database::clear_charging_curve(const std::string& name) {
+  if (charging_curves().erase(name) > 0) {
+    change_log().push_back(name);
+  }
+}
+
+void database::load_charging_curves(const std::string& file_name) {
+  std::ifstream curve_file(file_name);
+  if (!curve_file.is_open()) {
+    throw std::invalid_argument("Cannot open charging curve file");
+  }
+
+  std::string line;
+  while (std::getline(curve_file, line)) {
+    std::stringstream line_stream(line);
+    std::string name;
+    if (!(line_stream >> name) || name[0] == '#') {
+      continue;
+    }
+
+    std::vector<double> socs;
+    std::vector<double> powers;
+    double soc;
+    double power;
+    while (line_stream >> soc >> power) {
+      socs.push_back(soc);
+      powers.push_back(power);
+    }
+    set_charging_curve(name, ChargingCurve(socs, powers));
+  }
+}
+
+double utility::percentile(
+    const std::vector<double>& sorted_values, double p) {
+  if (sorted_values.empty()) {
+    return 0.0;
+  }
+  int index = static_cast<int>(p * (sorted_values.size() - 1) + 0.5);
+  return sorted_values[index];
+}
@@ -7,14 +7,29 @@
 #include <iostream>
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
 #include <stdexcept>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 
 #include "utility.h"
+#include "alloc_tracker.h"
 #include "path.h"
+#include "parallel_solver.h"
 #include "path_solver.h"
+#include "reachability_solver.h"
+#include "region_planner.h"
+#include "batch_pipeline.h"
+#include "beam_solver.h"
+#include "heuristic_cache.h"
+#include "route_evaluator.h"
+#include "station_table.h"
+#include "trace.h"
+#include "trip_planner.h"
 
 #include <gtest/gtest.h>
 
@@ -64,6 +79,16 @@ TEST(Utility, calc_great_distance) {
   EXPECT_NEAR(dist3, 268.425, epsilon);
 }
 
+TEST(Utility, percentile) {
+  std::vector<double> values{1.0, 2.0, 3.0, 4.0, 5.0};
+  EXPECT_DOUBLE_EQ(utility::percentile(values, 0.0), 1.0);
+  EXPECT_DOUBLE_EQ(utility::percentile(values, 0.5), 3.0);
+  EXPECT_DOUBLE_EQ(utility::percentile(values, 0.6), 3.0);
+  EXPECT_DOUBLE_EQ(utility::percentile(values, 0.95), 5.0);
+  EXPECT_DOUBLE_EQ(utility::percentile(values, 1.0), 5.0);
+  EXPECT_DOUBLE_EQ(utility::percentile({}, 0.5), 0.0);
+}
+
 class TestPath : public ::testing::Test {
  public:
   TestPath() {}
@@ -331,3 +356,1102 @@ TEST_F(TestPath, heuristic2) {
   EXPECT_NEAR(cost, path_ptr_->heuristic_cost(), epsilon);
 }
 
+
+
+/**
+ * @Brief Chargers reachable within a small time budget
+ *
+ */
+TEST(Reachability, time_budget) {
+  ReachabilitySolver reach_solver("Council_Bluffs_IA", 3.0);
+  auto reachable = reach_solver.solve();
+
+  ASSERT_FALSE(reachable.empty());
+  EXPECT_EQ("Council_Bluffs_IA", reachable.front().name);
+  EXPECT_DOUBLE_EQ(0.0, reachable.front().arrival_time);
+  EXPECT_DOUBLE_EQ(constant::INIT_CHARGE, reachable.front().arrival_charge);
+
+  bool found_worthington = false;
+  for (int i=0; i < reachable.size(); ++i) {
+    EXPECT_LE(reachable[i].arrival_time, 3.0);
+    if (i > 0) {
+      EXPECT_LE(reachable[i-1].arrival_time, reachable[i].arrival_time);
+    }
+
+    if (reachable[i].name == "Worthington_MN") {
+      found_worthington = true;
+      EXPECT_NEAR(268.425 / constant::SPEED,
+                  reachable[i].arrival_time, epsilon);
+      EXPECT_NEAR(constant::INIT_CHARGE - 268.425,
+                  reachable[i].arrival_charge, epsilon);
+    }
+  }
+  EXPECT_TRUE(found_worthington);
+}
+
+/**
+ * @Brief Reachable chargers are never slower than the path solver
+ *
+ */
+TEST(Reachability, earliest_arrival) {
+  ReachabilitySolver reach_solver("Council_Bluffs_IA", 10.0);
+  auto reachable = reach_solver.solve();
+
+  for (auto& reached : reachable) {
+    if (reached.name == "Onalaska_WI") {
+      // Council_Bluffs_IA, Worthington_MN, Albert_Lea_MN, Onalaska_WI
+      double time_cost =
+        268.425 / 108 +
+        34.783 / 92 +
+        (268.425 + 179.713 + 175.07) / constant::SPEED;
+      EXPECT_LE(reached.arrival_time, time_cost + epsilon);
+      return;
+    }
+  }
+  FAIL();
+}
+
+/**
+ * @Brief A slower path to a station that passes faster chargers
+ *        is kept for the stations after it
+ *
+ */
+TEST(Reachability, dominated_paths) {
+  ReachabilitySolver reach_solver("Tifton_GA",
+                                  std::numeric_limits<double>::infinity());
+  auto reached = reach_solver.solve_targets({"Lovelock_NV"});
+  ASSERT_EQ(1, reached.size());
+
+  PathSolver path_solver("Tifton_GA", "Lovelock_NV");
+  auto result = path_solver.solve_route();
+  ASSERT_EQ(RouteStatus::SUCCESS, result.status);
+  EXPECT_LE(reached.front().arrival_time, result.cost + epsilon);
+}
+
+TEST(Database, get_neighbors_range) {
+  std::string name = "Council_Bluffs_IA";
+  auto neighbors = database::get_neighbors(name);
+  auto long_range_neighbors = database::get_neighbors(name, 400);
+  EXPECT_LT(neighbors.size(), long_range_neighbors.size());
+
+  for (auto& neighbor : neighbors) {
+    EXPECT_NE(long_range_neighbors.end(),
+      std::find(long_range_neighbors.begin(), long_range_neighbors.end(),
+                neighbor));
+  }
+}
+
+/**
+ * @Brief Path with a vehicle that has a larger battery and higher speed
+ *
+ */
+TEST(VehicleProfile, long_range_path) {
+  std::string start = "Council_Bluffs_IA";
+  std::string goal = "Albert_Lea_MN";
+  // Council_Bluffs_IA to Albert_Lea_MN is out of the default range
+  double dist = utility::calc_great_distance(start, goal);
+  ASSERT_GT(dist, constant::FULL_CHARGE);
+
+  Path default_path(start, goal);
+  EXPECT_THROW(default_path.add_charger(goal), std::invalid_argument);
+
+  VehicleProfile vehicle(400, 120);
+  Path long_range_path(start, goal, vehicle);
+  long_range_path.add_charger(goal);
+  EXPECT_TRUE(long_range_path.reached_goal);
+  EXPECT_NEAR(dist / 120, long_range_path.time_cost(), epsilon);
+  EXPECT_NEAR(400 - dist, long_range_path.current_charge(), epsilon);
+}
+
+TEST(Path, shared_ratio) {
+  std::vector<std::string> long_chargers = {
+    "Worthington_MN", "Albert_Lea_MN", "Onalaska_WI"};
+  std::vector<std::string> short_chargers = {
+    "Worthington_MN", "Onalaska_WI"};
+  VehicleProfile vehicle(600, constant::SPEED);
+  Path long_path("Council_Bluffs_IA", "Onalaska_WI", vehicle);
+  for (auto& charger : long_chargers) {
+    long_path.add_charger(charger);
+  }
+  Path short_path("Council_Bluffs_IA", "Onalaska_WI", vehicle);
+  for (auto& charger : short_chargers) {
+    short_path.add_charger(charger);
+  }
+
+  // Worthington_MN is the only intermediate charger of the shorter path
+  EXPECT_DOUBLE_EQ(1.0, long_path.shared_ratio(short_path));
+  EXPECT_DOUBLE_EQ(1.0, short_path.shared_ratio(long_path));
+}
+
+TEST(PathSolver, alternatives) {
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  auto alternatives = my_solver.solve_alternatives(3, 0.5);
+
+  ASSERT_EQ(3, alternatives.size());
+  for (int i=0; i < alternatives.size(); ++i) {
+    EXPECT_TRUE(alternatives[i].reached_goal);
+    EXPECT_EQ("Council_Bluffs_IA", alternatives[i].chargers().front());
+    EXPECT_EQ("Cadillac_MI", alternatives[i].chargers().back());
+
+    for (int j=0; j < i; ++j) {
+      EXPECT_LE(alternatives[j].time_cost(), alternatives[i].time_cost());
+      EXPECT_LE(alternatives[i].shared_ratio(alternatives[j]), 0.5);
+      EXPECT_DOUBLE_EQ(alternatives[i].shared_ratio(alternatives[j]),
+                       alternatives[j].shared_ratio(alternatives[i]));
+    }
+  }
+
+  // The best alternative is the single path solution
+  EXPECT_NEAR(16.8438, alternatives.front().time_cost(), 1e-3);
+}
+
+TEST(Database, charger_available) {
+  std::string name = "Council_Bluffs_IA";
+  auto neighbors = database::get_neighbors(name);
+  ASSERT_NE(neighbors.end(),
+    std::find(neighbors.begin(), neighbors.end(), "Worthington_MN"));
+
+  auto version = database::state_version();
+  database::set_charger_available("Worthington_MN", false);
+  EXPECT_FALSE(database::charger_available("Worthington_MN"));
+  EXPECT_EQ(version + 1, database::state_version());
+  EXPECT_EQ(1, database::changed_chargers(version).count("Worthington_MN"));
+
+  neighbors = database::get_neighbors(name);
+  EXPECT_EQ(neighbors.end(),
+    std::find(neighbors.begin(), neighbors.end(), "Worthington_MN"));
+
+  database::set_charger_available("Worthington_MN", true);
+  neighbors = database::get_neighbors(name);
+  EXPECT_NE(neighbors.end(),
+    std::find(neighbors.begin(), neighbors.end(), "Worthington_MN"));
+}
+
+TEST(PathSolver, replan) {
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  auto solution = my_solver.solve();
+  ASSERT_NE(std::string::npos, solution.find("Albert_Lea_MN"));
+
+  // Out of service charger in the previous solution
+  database::set_charger_available("Albert_Lea_MN", false);
+  solution = my_solver.replan();
+  database::set_charger_available("Albert_Lea_MN", true);
+
+  EXPECT_EQ(std::string::npos, solution.find("Albert_Lea_MN"));
+  EXPECT_EQ(0, solution.find("Council_Bluffs_IA, "));
+  EXPECT_EQ(solution.size() - std::string("Cadillac_MI").size(),
+            solution.rfind("Cadillac_MI"));
+
+  // Slower charger in the repaired solution
+  auto rate = database::get_charger_record("Mauston_WI").rate;
+  database::set_charge_rate("Mauston_WI", 10);
+  solution = my_solver.replan();
+  database::set_charge_rate("Mauston_WI", rate);
+
+  EXPECT_EQ(std::string::npos, solution.find("Mauston_WI"));
+}
+
+TEST(PathSolver, replan_restored_charger) {
+  PathSolver fresh_solver("Council_Bluffs_IA", "Cadillac_MI");
+  auto fresh_cost = evaluator::evaluate_route(fresh_solver.solve()).cost;
+
+  // Albert_Lea_MN is out of service while the search expands
+  // the paths that lead to it
+  database::set_charger_available("Albert_Lea_MN", false);
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  auto solution = my_solver.solve();
+  EXPECT_EQ(std::string::npos, solution.find("Albert_Lea_MN"));
+
+  database::set_charger_available("Albert_Lea_MN", true);
+  solution = my_solver.replan();
+  EXPECT_NE(std::string::npos, solution.find("Albert_Lea_MN"));
+  EXPECT_NEAR(fresh_cost, evaluator::evaluate_route(solution).cost, 1e-3);
+}
+
+/**
+ * @Brief Path that starts without enough charge to the next charger
+ *
+ */
+TEST(VehicleProfile, partial_init_charge) {
+  std::string start = "Council_Bluffs_IA";
+  std::string goal = "Worthington_MN";
+  VehicleProfile vehicle(constant::FULL_CHARGE, constant::SPEED, 100);
+  Path path(start, goal, vehicle);
+  path.add_charger(goal);
+
+  // Charge the missing distance at the start charger
+  auto time_cost = (268.425 - 100) / 165 + 268.425 / constant::SPEED;
+  EXPECT_NEAR(time_cost, path.time_cost(), epsilon);
+
+  auto path_str = path.to_string();
+  path_str.erase(
+    std::remove(path_str.begin(), path_str.end(), ' '), path_str.end());
+  std::stringstream ss(path_str);
+  std::string element;
+  std::getline(ss, element, ',');
+  EXPECT_EQ(element, "Council_Bluffs_IA");
+
+  std::getline(ss, element, ',');
+  EXPECT_NEAR(std::stod(element), (268.425 - 100) / 165, epsilon);
+
+  std::getline(ss, element, ',');
+  EXPECT_EQ(element, "Worthington_MN");
+}
+
+TEST(PathSolver, replan_from) {
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  auto solution = my_solver.solve();
+  ASSERT_NE(std::string::npos, solution.find("Onalaska_WI"));
+
+  solution = my_solver.replan_from("Onalaska_WI", 50);
+  EXPECT_EQ(0, solution.find("Onalaska_WI, "));
+  EXPECT_EQ(std::string::npos, solution.find("Council_Bluffs_IA"));
+  EXPECT_EQ(solution.size() - std::string("Cadillac_MI").size(),
+            solution.rfind("Cadillac_MI"));
+
+  EXPECT_THROW(my_solver.replan_from("Onalaska_WI", 400),
+               std::invalid_argument);
+}
+
+TEST(PathSolver, warm_start) {
+  PathSolver my_solver("Worthington_MN", "Cadillac_MI");
+  std::vector<std::string> route = {
+    "Council_Bluffs_IA", "Worthington_MN", "Albert_Lea_MN", "Onalaska_WI",
+    "Mauston_WI", "Sheboygan_WI", "Cadillac_MI"};
+  EXPECT_TRUE(my_solver.warm_start(route));
+
+  std::vector<std::string> wrong_route = {
+    "Council_Bluffs_IA", "Worthington_MN", "Cadillac_MI"};
+  EXPECT_FALSE(my_solver.warm_start(wrong_route));
+
+  auto solution = my_solver.solve();
+  EXPECT_EQ(0, solution.find("Worthington_MN, "));
+}
+
+TEST(TimeProfile, value) {
+  TimeProfile profile({100, 200, 100, 50});
+  EXPECT_DOUBLE_EQ(100, profile.value(0));
+  EXPECT_DOUBLE_EQ(150, profile.value(3));
+  EXPECT_DOUBLE_EQ(200, profile.value(6));
+  EXPECT_DOUBLE_EQ(75, profile.value(21));
+  EXPECT_DOUBLE_EQ(150, profile.value(27));
+  EXPECT_DOUBLE_EQ(75, profile.value(-3));
+
+  TimeProfile constant_profile({120});
+  EXPECT_DOUBLE_EQ(120, constant_profile.value(13.5));
+
+  EXPECT_TRUE(TimeProfile({0, 2, 0}).is_fifo());
+  EXPECT_FALSE(TimeProfile({0, 10, 0}).is_fifo());
+  EXPECT_THROW(database::set_time_profile("Worthington_MN",
+    StationTimeProfile{TimeProfile({108}), TimeProfile({0, 10, 0})}),
+    std::invalid_argument);
+
+  // Charge rates are divided by, so they have to stay positive
+  EXPECT_DOUBLE_EQ(50, profile.min_value());
+  EXPECT_DOUBLE_EQ(200, profile.max_value());
+  EXPECT_THROW(database::set_time_profile("Worthington_MN",
+    StationTimeProfile{TimeProfile({108, 0}), TimeProfile({0})}),
+    std::invalid_argument);
+  EXPECT_THROW(database::set_time_profile("Worthington_MN",
+    StationTimeProfile{TimeProfile({108}), TimeProfile({-1})}),
+    std::invalid_argument);
+  EXPECT_EQ(nullptr, database::get_time_profile("Worthington_MN"));
+}
+
+/**
+ * @Brief Time-dependent charging at the intermediate charger
+ *
+ */
+TEST(TimeProfile, time_dependent_path) {
+  std::string start = "Council_Bluffs_IA";
+  std::string goal = "Albert_Lea_MN";
+  std::string charger = "Worthington_MN";
+
+  // Half charge rate and one hour queue in the afternoon
+  database::set_time_profile(charger, StationTimeProfile{
+    TimeProfile({108, 108, 108, 108, 54, 54, 108, 108}),
+    TimeProfile({0, 0, 0, 0, 1, 1, 0, 0})});
+
+  Path path(start, goal);
+  path.set_departure_time(12 - 268.425 / constant::SPEED);
+  path.add_charger(charger);
+  path.add_charger(goal);
+  auto afternoon_cost = path.time_cost();
+
+  // The profile rates are only used for the cost
+  Path copy(path);
+  auto result = copy.to_route_result();
+  EXPECT_NEAR(afternoon_cost, result.cost, epsilon);
+  EXPECT_NEAR(128.138 / 108, result.charge_times[1], epsilon);
+
+  path.set_departure_time(0);
+  auto night_cost = path.time_cost();
+  database::clear_time_profile(charger);
+
+  auto time_cost =
+    128.138 / 54 + 1.0 +
+    (268.425 + 179.713) / constant::SPEED;
+  EXPECT_NEAR(time_cost, afternoon_cost, epsilon);
+
+  time_cost =
+    128.138 / 108 +
+    (268.425 + 179.713) / constant::SPEED;
+  EXPECT_NEAR(time_cost, night_cost, epsilon);
+  EXPECT_NEAR(time_cost, path.time_cost(), epsilon);
+}
+
+TEST(ChargingCurve, table_lookup) {
+  // Full power up to half charge, then down to a quarter at full charge
+  ChargingCurve curve({0.0, 0.5, 1.0}, {1.0, 1.0, 0.25});
+  EXPECT_DOUBLE_EQ(0.625, curve.power(0.75));
+  EXPECT_NEAR(1.6, curve.charge_time(0, 160, 320, 100), 1e-9);
+  EXPECT_NEAR(0.5 * std::log(4.0) / 0.75 * 320 / 100,
+              curve.charge_time(160, 320, 320, 100), 1e-6);
+
+  for (double from : {0.0, 50.0, 170.0}) {
+    for (double to : {200.0, 290.0, 319.0}) {
+      double time = curve.charge_time(from, to, 320, 100);
+      EXPECT_NEAR(to, curve.charge_after(from, time, 320, 100), 1e-9);
+    }
+  }
+  EXPECT_DOUBLE_EQ(320, curve.charge_after(0, 100, 320, 100));
+
+  EXPECT_THROW(ChargingCurve({0.5, 0.2}, {1.0, 1.0}), std::invalid_argument);
+  EXPECT_THROW(ChargingCurve({0.0}, {0.0}), std::invalid_argument);
+  EXPECT_THROW(ChargingCurve({0.0, 1.0}, {1.0}), std::invalid_argument);
+}
+
+/**
+ * @Brief Charging along a curve at the intermediate charger
+ *
+ */
+TEST(ChargingCurve, tapered_path) {
+  std::string start = "Council_Bluffs_IA";
+  std::string goal = "Albert_Lea_MN";
+  std::string charger = "Worthington_MN";
+
+  ChargingCurve curve({0.0, 0.5, 1.0}, {1.0, 1.0, 0.25});
+  database::set_charging_curve(charger, curve);
+  Path path(start, goal);
+  path.add_charger(charger);
+  path.add_charger(goal);
+  auto tapered_cost = path.time_cost();
+  database::clear_charging_curve(charger);
+
+  // Arrive with 320 - 268.425 km and leave with just enough for 179.713 km
+  auto time_cost =
+    curve.charge_time(320 - 268.425, 179.713, 320, 108) +
+    (268.425 + 179.713) / constant::SPEED;
+  EXPECT_NEAR(time_cost, tapered_cost, epsilon);
+  EXPECT_GT(tapered_cost, 128.138 / 108 +
+            (268.425 + 179.713) / constant::SPEED);
+}
+
+TEST(ChargingCurve, solve) {
+  std::string start = "Council_Bluffs_IA";
+  std::string goal = "Cadillac_MI";
+  PathSolver linear_solver(start, goal);
+  auto linear_solution = linear_solver.solve();
+
+  // A flat curve charges at the charge rate, so the plan is the same
+  database::set_charging_curve("*", ChargingCurve({0.0}, {1.0}));
+  PathSolver flat_solver(start, goal);
+  EXPECT_EQ(linear_solution, flat_solver.solve());
+
+  // Tapering charges are valid when charged along the curve
+  database::set_charging_curve("*",
+    ChargingCurve({0.0, 0.5, 0.8, 1.0}, {1.0, 1.0, 0.5, 0.2}));
+  PathSolver tapered_solver(start, goal);
+  auto evaluation = evaluator::evaluate_route(tapered_solver.solve());
+  database::clear_charging_curve("*");
+
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_GT(evaluation.cost, 16.8438);
+}
+
+/**
+ * @Brief The shared child cost follows the charging curves
+ *
+ */
+TEST(ChargingCurve, child_cost_base) {
+  database::set_charging_curve("*",
+    ChargingCurve({0.0, 0.5, 0.8, 1.0}, {1.0, 1.0, 0.5, 0.2}));
+  std::string curr_charger = "Albert_Lea_MN";
+  Path path("Council_Bluffs_IA", "Cadillac_MI");
+  path.add_charger("Worthington_MN", 268.425);
+  path.add_charger(curr_charger, 179.713);
+
+  // The child can also stop at levels made for it,
+  // so the shared cost is an upper bound close to its cost
+  auto base = path.child_cost_base();
+  for (auto& neighbor : database::get_neighbors(curr_charger)) {
+    if (path.charger_visited(neighbor)) {
+      continue;
+    }
+
+    Path child(path);
+    child.add_charger(neighbor);
+    double dist = utility::calc_great_distance(curr_charger, neighbor);
+    EXPECT_LE(child.time_cost(), base.child_time(dist) + 1e-9);
+    EXPECT_NEAR(child.time_cost(), base.child_time(dist), 0.05);
+  }
+  database::clear_charging_curve("*");
+}
+
+TEST(PathSolver, departure_time) {
+  // Long queue at noon
+  database::set_time_profile("Albert_Lea_MN", StationTimeProfile{
+    TimeProfile({92}), TimeProfile({0, 0, 0, 3, 3, 3, 0, 0})});
+
+  PathSolver noon_solver("Council_Bluffs_IA", "Cadillac_MI");
+  noon_solver.set_departure_time(7);
+  auto noon_solution = noon_solver.solve();
+
+  PathSolver night_solver("Council_Bluffs_IA", "Cadillac_MI");
+  night_solver.set_departure_time(20);
+  auto night_solution = night_solver.solve();
+  database::clear_time_profile("Albert_Lea_MN");
+
+  EXPECT_EQ(std::string::npos, noon_solution.find("Albert_Lea_MN"));
+  EXPECT_NE(std::string::npos, night_solution.find("Albert_Lea_MN"));
+}
+
+TEST(RouteEvaluator, evaluate_route) {
+  auto evaluation = evaluator::evaluate_route(
+    "Council_Bluffs_IA, Worthington_MN, 1.18647, Albert_Lea_MN");
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_NEAR(1.18647 + (268.425 + 179.713) / constant::SPEED,
+              evaluation.cost, epsilon);
+  ASSERT_EQ(3, evaluation.chargers.size());
+  EXPECT_EQ("Worthington_MN", evaluation.chargers[1]);
+
+  // Not enough charge to reach Albert_Lea_MN
+  evaluation = evaluator::evaluate_route(
+    "Council_Bluffs_IA, Worthington_MN, 1.0, Albert_Lea_MN");
+  EXPECT_FALSE(evaluation.valid);
+
+  evaluation = evaluator::evaluate_route(
+    "Council_Bluffs_IA, Wrong_name, 1.0, Albert_Lea_MN");
+  EXPECT_FALSE(evaluation.valid);
+
+  evaluation = evaluator::evaluate_route("");
+  EXPECT_FALSE(evaluation.valid);
+}
+
+TEST(BeamSolver, solve) {
+  BeamSolver beam_solver("Council_Bluffs_IA", "Cadillac_MI");
+  auto evaluation = evaluator::evaluate_route(beam_solver.solve());
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_EQ("Council_Bluffs_IA", evaluation.chargers.front());
+  EXPECT_EQ("Cadillac_MI", evaluation.chargers.back());
+  EXPECT_LT(evaluation.cost, 16.8438 * 1.05);
+}
+
+TEST(BeamSolver, memory_limit) {
+  size_t memory_limit = 64 * 1024;
+  BeamSolver beam_solver("Glen_Allen_VA", "Lone_Pine_CA",
+                         VehicleProfile(), 1000, memory_limit);
+  auto evaluation = evaluator::evaluate_route(beam_solver.solve());
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_LE(beam_solver.peak_memory(), memory_limit);
+}
+
+/**
+ * @Brief The shared child cost gives the time cost of every child
+ *
+ */
+TEST_F(TestPath, child_cost_base) {
+  std::string start = "Council_Bluffs_IA";
+  std::string goal = "Cadillac_MI";
+  SetUp(start, goal);
+
+  std::vector<std::string> chargers = {
+    "Worthington_MN", "Albert_Lea_MN", "Onalaska_WI", "Mauston_WI"};
+  for (auto& charger : chargers) {
+    auto base = path_ptr_->child_cost_base();
+    auto curr_charger = path_ptr_->current_charger();
+    auto neighbors = database::get_neighbors(curr_charger);
+
+    for (auto& neighbor : neighbors) {
+      if (path_ptr_->charger_visited(neighbor)) {
+        continue;
+      }
+
+      Path child(*path_ptr_);
+      child.add_charger(neighbor);
+      double dist = utility::calc_great_distance(curr_charger, neighbor);
+      EXPECT_NEAR(child.time_cost(), base.child_time(dist), 1e-9);
+      EXPECT_NEAR(child.greedy_time_cost(), base.greedy_child_time(dist),
+                  1e-9);
+      EXPECT_LE(child.time_cost(), child.greedy_time_cost() + 1e-9);
+    }
+
+    path_ptr_->add_charger(charger);
+  }
+}
+
+TEST(PathSolver, config) {
+  for (auto& preset : {"default", "balanced", "fast"}) {
+    PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+    my_solver.set_config(PathSolverConfig::preset(preset));
+    auto evaluation = evaluator::evaluate_route(my_solver.solve());
+    EXPECT_TRUE(evaluation.valid);
+    EXPECT_LT(evaluation.cost, 16.8438 * 1.1);
+  }
+
+  // A single candidate stops at the first path reaching the goal
+  PathSolverConfig config;
+  config.num_of_candidate = 1;
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  my_solver.set_config(config);
+  EXPECT_TRUE(evaluator::evaluate_route(my_solver.solve()).valid);
+
+  EXPECT_THROW(PathSolverConfig::preset("unknown"), std::invalid_argument);
+}
+
+TEST(PathSolver, nodes_expanded) {
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  EXPECT_EQ(0, my_solver.nodes_expanded());
+  my_solver.solve();
+  EXPECT_GT(my_solver.nodes_expanded(), 0);
+
+  // The search is deterministic
+  PathSolver same_solver("Council_Bluffs_IA", "Cadillac_MI");
+  same_solver.solve();
+  EXPECT_EQ(my_solver.nodes_expanded(), same_solver.nodes_expanded());
+
+  // Stopping at the first candidate expands fewer paths
+  PathSolverConfig config;
+  config.num_of_candidate = 1;
+  PathSolver first_solver("Council_Bluffs_IA", "Cadillac_MI");
+  first_solver.set_config(config);
+  first_solver.solve();
+  EXPECT_LT(first_solver.nodes_expanded(), my_solver.nodes_expanded());
+}
+
+TEST(PathSolver, peak_memory) {
+  EXPECT_LE(sizeof(SearchNode), 32);
+  EXPECT_LE(sizeof(QueueEntry), 16);
+
+  // A long search guided by the distance to goal queues thousands of nodes
+  PathSolverConfig config;
+  config.use_goal_table = false;
+  PathSolver my_solver("Lincoln_City_OR", "Auburn_AL");
+  my_solver.set_config(config);
+  auto evaluation = evaluator::evaluate_route(my_solver.solve());
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_GT(my_solver.nodes_expanded(), 1000);
+  EXPECT_LT(my_solver.peak_memory(), 1024 * 1024);
+}
+
+TEST(HeuristicCache, goal_table) {
+  heuristic::clear();
+  int goal_id = database::get_charger_id("Cadillac_MI");
+  auto table = heuristic::goal_table(goal_id, VehicleProfile());
+  ASSERT_EQ(database::num_of_chargers(), table->goal_dists.size());
+  EXPECT_EQ(0.0, table->goal_dists[goal_id]);
+  EXPECT_EQ(0.0, table->remaining_time(goal_id, 0.0));
+
+  // A neighbor of the goal drives there directly,
+  // and charges no faster than the fastest rate
+  auto& goal_table = database::get_neighbor_table(goal_id);
+  for (int i=0; i < goal_table.ids.size(); ++i) {
+    int id = goal_table.ids[i];
+    double dist = goal_table.dists[i];
+    EXPECT_LE(table->goal_dists[id], dist + 1e-9);
+    EXPECT_LE(database::get_charger_record(id).rate, table->max_rate);
+
+    double direct_time = dist / constant::SPEED +
+      dist / database::get_charger_record(id).rate;
+    EXPECT_LE(table->remaining_time(id, 0.0), direct_time + 1e-9);
+    EXPECT_LE(table->remaining_time(id, dist),
+              dist / constant::SPEED + 1e-9);
+  }
+
+  // The remaining time is a lower bound of the best route
+  PathSolverConfig distance_config;
+  distance_config.use_goal_table = false;
+  PathSolver route_solver("Lone_Pine_CA", "Cadillac_MI");
+  route_solver.set_config(distance_config);
+  auto route_evaluation = evaluator::evaluate_route(route_solver.solve());
+  EXPECT_TRUE(route_evaluation.valid);
+  EXPECT_LE(table->remaining_time(database::get_charger_id("Lone_Pine_CA"),
+                                  VehicleProfile().init_charge),
+            route_evaluation.cost);
+
+  // The same goal is served from the cache
+  EXPECT_EQ(table, heuristic::goal_table(goal_id, VehicleProfile()));
+  EXPECT_EQ(1, heuristic::stats().hits);
+  EXPECT_EQ(1, heuristic::stats().misses);
+  EXPECT_NEAR(0.5, heuristic::stats().hit_rate(), 1e-9);
+
+  // A changed charging station makes a new table
+  double mauston_rate = database::get_charger_record("Mauston_WI").rate;
+  database::set_charge_rate("Mauston_WI", 200);
+  EXPECT_NE(table, heuristic::goal_table(goal_id, VehicleProfile()));
+  EXPECT_EQ(2, heuristic::stats().misses);
+
+  // The least recently used goal is dropped
+  heuristic::set_capacity(1);
+  heuristic::goal_table(database::get_charger_id("Lone_Pine_CA"),
+                        VehicleProfile());
+  heuristic::goal_table(goal_id, VehicleProfile());
+  EXPECT_EQ(4, heuristic::stats().misses);
+  EXPECT_EQ(1, heuristic::stats().size);
+
+  // A search with the goal table finds a route as good
+  // as the search guided by the distance to goal
+  PathSolver distance_solver("Glen_Allen_VA", "Lone_Pine_CA");
+  distance_solver.set_config(distance_config);
+  auto distance_evaluation =
+    evaluator::evaluate_route(distance_solver.solve());
+
+  // A search looks the goal table up once, however it was set up
+  heuristic::clear();
+  PathSolverConfig table_config;
+  table_config.use_goal_table = true;
+  PathSolver table_solver("Glen_Allen_VA", "Lone_Pine_CA");
+  table_solver.set_config(table_config);
+  auto table_evaluation = evaluator::evaluate_route(table_solver.solve());
+  EXPECT_EQ(0, heuristic::stats().hits);
+  EXPECT_EQ(1, heuristic::stats().misses);
+  EXPECT_TRUE(table_evaluation.valid);
+  EXPECT_LE(table_evaluation.cost, distance_evaluation.cost * 1.01);
+
+  database::set_charge_rate("Mauston_WI", mauston_rate);
+  heuristic::set_capacity(heuristicParam::DEFAULT_CAPACITY);
+}
+
+TEST(BoundedQueue, producers_and_consumers) {
+  BoundedQueue<int> queue(8);
+  EXPECT_EQ(8, queue.capacity());
+
+  // Every item is taken exactly once by one of the consumers
+  std::vector<std::thread> producers;
+  for (int p=0; p < 3; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (int i=0; i < 1000; ++i) {
+        queue.push(p * 1000 + i);
+      }
+    });
+  }
+
+  std::vector<long> sums(2, 0);
+  std::vector<std::thread> consumers;
+  for (int c=0; c < 2; ++c) {
+    consumers.emplace_back([&queue, &sums, c]() {
+      int item;
+      while (queue.pop(item)) {
+        sums[c] += item;
+      }
+    });
+  }
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  queue.close();
+  for (auto& consumer : consumers) {
+    consumer.join();
+  }
+
+  EXPECT_EQ(2999L * 3000 / 2, sums[0] + sums[1]);
+  EXPECT_LE(queue.max_depth(), queue.capacity());
+  EXPECT_EQ(0, queue.size());
+}
+
+TEST(BatchPipeline, ordered_output) {
+  std::vector<std::pair<std::string, std::string>> queries = {
+    {"Council_Bluffs_IA", "Cadillac_MI"},
+    {"Glen_Allen_VA", "Lone_Pine_CA"},
+    {"Gilroy_CA", "Palo_Alto_CA"},
+    {"Victoria_TX", "South_Salt_Lake_City_UT"}};
+
+  std::stringstream input;
+  for (int i=0; i < 5; ++i) {
+    for (auto& query : queries) {
+      input << query.first << " " << query.second << "\n";
+    }
+  }
+  input << "# comment\n" << "Unknown_Charger Cadillac_MI\n" << "Cadillac_MI\n";
+
+  BatchConfig config;
+  config.num_of_workers = 3;
+  config.queue_capacity = 2;
+  config.max_in_flight = 4;
+  config.validate = true;
+  BatchPipeline pipeline(config);
+  std::stringstream output;
+  pipeline.run(input, output);
+
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(output, line)) {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(22, lines.size());
+
+  // Answers keep the input order
+  for (int i=0; i < 20; ++i) {
+    auto& query = queries[i % queries.size()];
+    PathSolver my_solver(query.first, query.second);
+    EXPECT_EQ(my_solver.solve(), lines[i]);
+  }
+  EXPECT_EQ("Error: Charger not in database", lines[20]);
+  EXPECT_EQ(0, lines[21].find("Error: Bad query line"));
+
+  auto stats = pipeline.stats();
+  EXPECT_EQ(0, stats.invalid_routes);
+  for (auto& stage : stats.stages) {
+    EXPECT_EQ(22, stage.items);
+  }
+  for (auto& queue : stats.queues) {
+    EXPECT_LE(queue.max_depth, queue.capacity);
+  }
+}
+
+TEST(PathSolver, solve_route) {
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  auto result = my_solver.solve_route();
+  EXPECT_EQ(RouteStatus::SUCCESS, result.status);
+  ASSERT_GE(result.charger_ids.size(), 2);
+  EXPECT_EQ(database::get_charger_id("Council_Bluffs_IA"),
+            result.charger_ids.front());
+  EXPECT_EQ(database::get_charger_id("Cadillac_MI"),
+            result.charger_ids.back());
+  EXPECT_EQ(result.charger_ids.size(), result.charge_times.size());
+  EXPECT_EQ(result.charger_ids.size() - 1, result.leg_dists.size());
+
+  // The formatted route follows the checker rules with the same cost
+  auto solution = route::to_string(result);
+  auto evaluation = evaluator::evaluate_route(solution);
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_NEAR(result.cost, evaluation.cost, 1e-3);
+
+  PathSolver string_solver("Council_Bluffs_IA", "Cadillac_MI");
+  EXPECT_EQ(string_solver.solve(), solution);
+
+  // A small buffer is cut but still reports the full length
+  char buffer[16];
+  EXPECT_EQ(solution.size(), route::format(result, buffer, sizeof(buffer)));
+  EXPECT_EQ(solution.substr(0, sizeof(buffer) - 1), std::string(buffer));
+
+  EXPECT_EQ("", route::to_string(RouteResult()));
+}
+
+TEST(Trace, ring_buffer) {
+  // Nothing is recorded before tracing starts
+  trace::record(TraceKind::EXPAND, 0, 1.0, 1);
+  trace::start(4);
+  for (int i=0; i < 6; ++i) {
+    trace::record(TraceKind::EXPAND, i, 1.0, i);
+  }
+  trace::record(TraceKind::RESET, 6, 1.2, 0);
+  trace::stop();
+  trace::record(TraceKind::EXPAND, 7, 1.2, 0);
+
+  // Only the latest events are kept, from the oldest to the latest
+  auto events = trace::events();
+  ASSERT_EQ(4, events.size());
+  EXPECT_EQ(3, events.front().charger_id);
+  EXPECT_EQ(TraceKind::RESET, events.back().kind);
+  for (int i=1; i < events.size(); ++i) {
+    EXPECT_LE(events[i-1].timestamp, events[i].timestamp);
+  }
+
+  auto json = trace::to_chrome_json(events);
+  EXPECT_NE(std::string::npos, json.find("\"traceEvents\""));
+  EXPECT_NE(std::string::npos, json.find("\"reset\""));
+
+  // Three chargers were expanded once each
+  auto geojson = trace::to_geojson(events);
+  EXPECT_NE(std::string::npos, geojson.find(
+    "\"name\":\"" + database::get_charger_record(3).name + "\""));
+  int num_of_points = 0;
+  for (auto pos = geojson.find("\"Point\""); pos != std::string::npos;
+       pos = geojson.find("\"Point\"", pos + 1)) {
+    num_of_points++;
+  }
+  EXPECT_EQ(3, num_of_points);
+
+#ifdef SEARCH_TRACE
+  trace::start();
+  PathSolver my_solver("Council_Bluffs_IA", "Cadillac_MI");
+  my_solver.solve();
+  trace::stop();
+  EXPECT_GT(trace::events().size(), 0);
+#endif
+}
+
+TEST(Database, load_network) {
+  std::string file_name = "test_network.txt";
+  std::ofstream network_file(file_name);
+  network_file << "# name lat lon rate\n" <<
+    "West 40.0 -100.0 100\n" <<
+    "Middle 40.0 -98.0 150\n" <<
+    "East 40.0 -96.0 120\n";
+  network_file.close();
+
+  database::load_network(file_name);
+  EXPECT_EQ(3, database::num_of_chargers());
+  EXPECT_EQ(1, database::get_charger_id("Middle"));
+  EXPECT_THROW(database::get_charger_id("Council_Bluffs_IA"),
+               std::invalid_argument);
+
+  // West and East are about 340 km apart, so Middle is needed
+  PathSolver my_solver("West", "East");
+  auto result = my_solver.solve_route();
+  EXPECT_EQ(3, result.charger_ids.size());
+  EXPECT_TRUE(evaluator::evaluate_route(route::to_string(result)).valid);
+
+  database::reset_network();
+  EXPECT_EQ(network.size(), database::num_of_chargers());
+  EXPECT_EQ(0, database::get_charger_id(network[0].name));
+  std::remove(file_name.c_str());
+}
+
+TEST(PathSolver, queue_exhausted) {
+  std::string file_name = "test_small_network.txt";
+  std::ofstream network_file(file_name);
+  network_file << "# name lat lon rate\n" <<
+    "West 40.0 -100.0 100\n" <<
+    "North 41.0 -98.0 150\n" <<
+    "South 39.0 -98.0 120\n" <<
+    "East 40.0 -96.0 120\n" <<
+    "Island 20.0 -160.0 120\n";
+  network_file.close();
+  database::load_network(file_name);
+
+  // Only two routes lead to East, so the queue runs out
+  // long before the candidates of the setting are compared
+  PathSolver my_solver("West", "East");
+  auto result = my_solver.solve_route();
+  EXPECT_EQ(RouteStatus::SUCCESS, result.status);
+  EXPECT_EQ(3, result.charger_ids.size());
+  EXPECT_EQ(database::get_charger_id("North"), result.charger_ids[1]);
+
+  // No route at all is still no route
+  PathSolver island_solver("West", "Island");
+  EXPECT_EQ(RouteStatus::NO_ROUTE, island_solver.solve_route().status);
+
+  // Stations that cannot reach the goal have an infinite remaining time
+  // in the goal table, and are not queued by the time-dependent search
+  PathSolverConfig table_config;
+  table_config.use_goal_table = true;
+  PathSolver table_solver("West", "Island");
+  table_solver.set_config(table_config);
+  table_solver.set_departure_time(8.0);
+  EXPECT_EQ(RouteStatus::NO_ROUTE, table_solver.solve_route().status);
+  EXPECT_EQ(1, table_solver.nodes_expanded());
+
+  database::reset_network();
+  std::remove(file_name.c_str());
+}
+
+TEST(ParallelSolver, matches_sequential) {
+  // Long queries across the country, where a parallel search pays off
+  std::vector<std::pair<std::string, std::string>> queries = {
+    {"Glen_Allen_VA", "Lone_Pine_CA"},
+    {"Centralia_WA", "Plymouth_NC"},
+    {"Okeechobee_FL", "Centralia_WA"}};
+
+  for (auto& query : queries) {
+    PathSolver my_solver(query.first, query.second);
+    auto expected = my_solver.solve_route();
+
+    for (int num_of_threads : {1, 4}) {
+      ParallelSolver parallel_solver(query.first, query.second,
+                                     VehicleProfile(), num_of_threads);
+      auto result = parallel_solver.solve_route();
+      EXPECT_EQ(RouteStatus::SUCCESS, result.status);
+      EXPECT_TRUE(evaluator::evaluate_route(route::to_string(result)).valid);
+      EXPECT_LE(result.cost, expected.cost * (1.0 + epsilon));
+      EXPECT_GT(parallel_solver.nodes_expanded(), 0);
+    }
+  }
+
+  // A wider window lets the threads drift further from the sequential
+  // order, the route stays valid
+  ParallelSolver wide_solver("Glen_Allen_VA", "Lone_Pine_CA",
+                             VehicleProfile(), 4);
+  EXPECT_THROW(wide_solver.set_cost_window(-0.1), std::invalid_argument);
+  wide_solver.set_cost_window(0.05);
+  auto wide_result = wide_solver.solve_route();
+  EXPECT_EQ(RouteStatus::SUCCESS, wide_result.status);
+  EXPECT_TRUE(evaluator::evaluate_route(route::to_string(wide_result)).valid);
+}
+
+TEST(StationTable, round_trip) {
+  // The table is generated from the network source, so every station
+  // has to come back with its own id and the same numbers
+  ASSERT_EQ(network.size(), station_table::size());
+  for (int i=0; i < network.size(); ++i) {
+    EXPECT_EQ(i, station_table::find(network[i].name));
+    EXPECT_EQ(network[i].name, station_table::name(i));
+    EXPECT_EQ(i, database::get_charger_id(network[i].name));
+
+    auto station = station_table::station(i);
+    EXPECT_EQ(network[i].lat, station.lat);
+    EXPECT_EQ(network[i].lon, station.lon);
+    EXPECT_EQ(network[i].rate, station.rate);
+    EXPECT_EQ(network[i].lat, database::get_charger_record(i).lat);
+  }
+  EXPECT_THROW(station_table::station(network.size()), std::invalid_argument);
+
+  EXPECT_EQ(-1, station_table::find(""));
+  EXPECT_EQ(-1, station_table::find("Albany_N"));
+  EXPECT_EQ(-1, station_table::find("Albany_NYC"));
+  EXPECT_EQ(-1, station_table::find("Wrong_name"));
+  EXPECT_EQ(nullptr, station_table::name(-1));
+  EXPECT_EQ(nullptr, station_table::name(network.size()));
+}
+
+TEST(AllocTracker, nested_scopes) {
+  EXPECT_GT(alloc_tracker::peak_rss(), 0);
+
+  alloc_tracker::AllocScope outer_scope;
+  std::vector<char> outer_buffer(1 << 16);
+  {
+    alloc_tracker::AllocScope inner_scope;
+    std::vector<char> inner_buffer(1 << 10);
+    auto inner_stats = inner_scope.stats();
+    if (alloc_tracker::enabled()) {
+      EXPECT_EQ(1, inner_stats.allocations);
+      EXPECT_GE(inner_stats.bytes_allocated, 1 << 10);
+      EXPECT_LT(inner_stats.peak_live_bytes, 1 << 16);
+    } else {
+      EXPECT_EQ(0, inner_stats.allocations);
+      EXPECT_EQ(0, inner_stats.peak_live_bytes);
+    }
+  }
+
+  // The inner scope keeps the peak of the outer scope
+  auto outer_stats = outer_scope.stats();
+  if (alloc_tracker::enabled()) {
+    EXPECT_EQ(2, outer_stats.allocations);
+    EXPECT_GE(outer_stats.bytes_allocated, (1 << 16) + (1 << 10));
+    EXPECT_GE(outer_stats.peak_live_bytes, (1 << 16) + (1 << 10));
+    EXPECT_GE(outer_stats.alloc_time, 0.0);
+  } else {
+    EXPECT_EQ(0, outer_stats.bytes_allocated);
+  }
+
+  // A block freed on another thread lowers the live bytes of this thread
+  alloc_tracker::AllocScope handoff_scope;
+  char* handoff_buffer = new char[1 << 16];
+  std::thread([handoff_buffer]() { delete[] handoff_buffer; }).join();
+  std::vector<char> next_buffer(1 << 16);
+  if (alloc_tracker::enabled()) {
+    EXPECT_GE(handoff_scope.stats().peak_live_bytes, 1 << 16);
+    EXPECT_LT(handoff_scope.stats().peak_live_bytes, 1 << 17);
+  }
+}
+
+TEST(RegionPlanner, cross_region) {
+  RegionPlanner region_planner(3);
+  auto& regions = region_planner.regions();
+  ASSERT_EQ(3, regions.size());
+
+  int num_of_chargers = 0;
+  for (auto& region : regions) {
+    num_of_chargers += region.chargers.size();
+    EXPECT_GT(region.boundary_chargers.size(), 0);
+  }
+  EXPECT_EQ(database::num_of_chargers(), num_of_chargers);
+
+  // From the east coast to the west coast crosses every region
+  auto solution = region_planner.solve("Glen_Allen_VA", "Lone_Pine_CA");
+  auto evaluation = evaluator::evaluate_route(solution);
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_EQ("Glen_Allen_VA", evaluation.chargers.front());
+  EXPECT_EQ("Lone_Pine_CA", evaluation.chargers.back());
+  EXPECT_LT(evaluation.cost, 59.4442 * 1.1);
+
+  // A query inside one region is still answered
+  auto& west = regions.front().chargers;
+  auto result = region_planner.solve_route(west[0], west[1]);
+  EXPECT_NE(RouteStatus::NO_ROUTE, result.status);
+
+  // Every worker loads only the stations of its region
+  auto worker_stats = region_planner.worker_stats();
+  ASSERT_EQ(regions.size(), worker_stats.size());
+  for (int r=0; r < regions.size(); ++r) {
+    EXPECT_EQ(regions[r].chargers.size(), worker_stats[r].num_of_chargers);
+  }
+
+  EXPECT_THROW(region_planner.solve("Glen_Allen_VA", "Nowhere"),
+               std::invalid_argument);
+}
+
+TEST(TripPlanner, visit_order) {
+  std::vector<std::string> waypoints = {
+    "Milford_CT", "Newark_DE", "Brattleboro_VT"};
+  TripPlanner trip_planner("Albany_NY", waypoints, "Edison_NJ");
+  auto result = trip_planner.solve_route();
+  ASSERT_EQ(RouteStatus::SUCCESS, result.status);
+
+  // The exact order is the fastest of every order
+  std::vector<int> order = {1, 2, 3};
+  double best_time = std::numeric_limits<double>::infinity();
+  do {
+    double time = trip_planner.leg_time(0, order.front()) +
+      trip_planner.leg_time(order.back(), 4);
+    for (int i=0; i + 1 < order.size(); ++i) {
+      time += trip_planner.leg_time(order[i], order[i + 1]);
+    }
+    best_time = std::min(best_time, time);
+  } while (std::next_permutation(order.begin(), order.end()));
+
+  auto& visit_order = trip_planner.visit_order();
+  ASSERT_EQ(3, visit_order.size());
+  double order_time = 0.0;
+  int from = 0;
+  for (auto& waypoint : visit_order) {
+    int to = std::find(waypoints.begin(), waypoints.end(), waypoint) -
+      waypoints.begin() + 1;
+    order_time += trip_planner.leg_time(from, to);
+    from = to;
+  }
+  order_time += trip_planner.leg_time(from, 4);
+  EXPECT_NEAR(best_time, order_time, epsilon);
+
+  // Charge carried across the legs never makes the trip slower
+  EXPECT_LE(result.cost, order_time + epsilon);
+
+  // The route visits the waypoints in order and stays valid
+  auto solution = route::to_string(result);
+  auto evaluation = evaluator::evaluate_route(solution);
+  EXPECT_TRUE(evaluation.valid);
+  EXPECT_EQ("Albany_NY", evaluation.chargers.front());
+  EXPECT_EQ("Edison_NJ", evaluation.chargers.back());
+  auto next_stop = evaluation.chargers.begin();
+  for (auto& waypoint : visit_order) {
+    next_stop = std::find(next_stop, evaluation.chargers.end(), waypoint);
+    EXPECT_NE(evaluation.chargers.end(), next_stop);
+  }
+}
+
+TEST(TripPlanner, many_waypoints) {
+  // More waypoints than the exact order takes
+  std::vector<std::string> waypoints = {
+    "Milford_CT", "Newark_DE", "Brattleboro_VT", "Liverpool_NY",
+    "West_Lebanon_NH", "Glen_Allen_VA", "Dayton_OH", "Lumberton_NC",
+    "Pleasant_Prairie_WI", "Independence_MO", "Salina_KS",
+    "Huntsville_TX", "Amarillo_TX", "Albuquerque_NM"};
+  ASSERT_GT(waypoints.size(), tripParam::MAX_EXACT_WAYPOINTS);
+
+  TripPlanner trip_planner("Albany_NY", waypoints, "Edison_NJ",
+                           VehicleProfile(), 2);
+  auto solution = trip_planner.solve();
+  auto evaluation = evaluator::evaluate_route(solution);
+  EXPECT_TRUE(evaluation.valid);
+
+  auto visit_order = trip_planner.visit_order();
+  std::sort(visit_order.begin(), visit_order.end());
+  std::sort(waypoints.begin(), waypoints.end());
+  EXPECT_EQ(waypoints, visit_order);
+  for (auto& waypoint : waypoints) {
+    EXPECT_NE(evaluation.chargers.end(), std::find(
+      evaluation.chargers.begin(), evaluation.chargers.end(), waypoint));
+  }
+}